@@ -3,19 +3,23 @@
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <set>
 
 using namespace std;
 using namespace llvm;
 
-map<const llvm::Value *, MemReg *> MemReg::valueToRegMap;
+map<const llvm::Value *, vector<MemReg *>> MemReg::valueToRegMap;
 
 set<MemReg *> MemReg::sharedCudaRegions;
 map<const Function *, set<MemReg *>> MemReg::func2SharedOmpRegs;
+map<const void *, vector<MemReg *>> MemReg::ptsSetToRegsMap;
+map<const void *, vector<MemReg *>> MemReg::ptsSetToAllFieldRegsMap;
 
 unsigned MemReg::count = 0;
 
-MemReg::MemReg(const llvm::Value *value) : value(value), isCudaShared(false) {
+MemReg::MemReg(const llvm::Value *value, unsigned field)
+    : value(value), field(field), isCudaShared(false) {
   id = count++;
 
   // Cuda shared region
@@ -36,45 +40,129 @@ MemReg::MemReg(const llvm::Value *value) : value(value), isCudaShared(false) {
   const llvm::Instruction *inst = llvm::dyn_cast<llvm::Instruction>(value);
   if (inst)
     name.append(inst->getParent()->getParent()->getName());
+  if (field > 0)
+    name.append("." + std::to_string(field));
 }
 
-void MemReg::createRegion(const llvm::Value *v) {
-  valueToRegMap[v] = new MemReg(v);
+void MemReg::createRegion(const llvm::Value *v, unsigned nbFields) {
+  ptsSetToRegsMap.clear();
+  ptsSetToAllFieldRegsMap.clear();
+
+  vector<MemReg *> &regs = valueToRegMap[v];
+  for (unsigned i = 0; i < nbFields; ++i)
+    regs.push_back(new MemReg(v, i));
 }
 
-void MemReg::setOmpSharedRegions(const Function *F, vector<MemReg *> &regs) {
+void MemReg::setOmpSharedRegions(const Function *F,
+                                 const vector<MemReg *> &regs) {
   func2SharedOmpRegs[F].insert(regs.begin(), regs.end());
 }
 
 void MemReg::dumpRegions() {
-  llvm::errs() << valueToRegMap.size() << " regions :\n";
+  llvm::errs() << count << " regions :\n";
   for (auto I : valueToRegMap) {
-    llvm::errs() << *I.second->value
-                 << (I.second->isCudaShared ? " (shared)\n" : "\n");
+    for (MemReg *r : I.second) {
+      llvm::errs() << *r->value;
+      if (r->field > 0)
+        llvm::errs() << " field " << r->field;
+      llvm::errs() << (r->isCudaShared ? " (shared)\n" : "\n");
+    }
   }
 }
 
-MemReg *MemReg::getValueRegion(const llvm::Value *v) {
+MemReg *MemReg::getValueRegion(const llvm::Value *v, unsigned field) {
   auto I = valueToRegMap.find(v);
   if (I == valueToRegMap.end())
     return NULL;
 
-  return I->second;
+  if (field >= I->second.size())
+    return I->second.back();
+  return I->second[field];
+}
+
+void MemReg::getValueRegions(const llvm::Value *v,
+                             std::vector<MemReg *> &regs) {
+  auto I = valueToRegMap.find(v);
+  if (I == valueToRegMap.end())
+    return;
+
+  regs.insert(regs.end(), I->second.begin(), I->second.end());
 }
 
 void MemReg::getValuesRegion(std::vector<const Value *> &ptsSet,
                              std::vector<MemReg *> &regs) {
+  // Without the field offsets, every field of the objects may be accessed.
   std::set<MemReg *> regions;
   for (const Value *v : ptsSet) {
-    MemReg *r = getValueRegion(v);
+    auto I = valueToRegMap.find(v);
+    if (I != valueToRegMap.end())
+      regions.insert(I->second.begin(), I->second.end());
+  }
+
+  regs.insert(regs.begin(), regions.begin(), regions.end());
+}
+
+void MemReg::getValuesRegion(
+    std::vector<std::pair<const Value *, unsigned>> &ptsSet,
+    std::vector<MemReg *> &regs) {
+  std::set<MemReg *> regions;
+  for (auto &p : ptsSet) {
+    auto I = valueToRegMap.find(p.first);
+    if (I == valueToRegMap.end())
+      continue;
 
-    if (r)
-      regions.insert(r);
+    const vector<MemReg *> &fieldRegs = I->second;
+    regions.insert(fieldRegs[std::min<size_t>(p.second, fieldRegs.size() - 1)]);
   }
 
   regs.insert(regs.begin(), regions.begin(), regions.end());
 }
 
+const std::vector<MemReg *> &
+MemReg::getPointeeRegions(const AndersPtsView &ptsView) {
+  auto ins = ptsSetToRegsMap.insert(
+      make_pair(ptsView.getId(), vector<MemReg *>()));
+  if (!ins.second)
+    return ins.first->second;
+
+  std::set<MemReg *> regions;
+  for (auto p : ptsView) {
+    auto I = valueToRegMap.find(p.first);
+    if (I == valueToRegMap.end())
+      continue;
+
+    const vector<MemReg *> &fieldRegs = I->second;
+    regions.insert(fieldRegs[std::min<size_t>(p.second, fieldRegs.size() - 1)]);
+  }
+
+  ins.first->second.assign(regions.begin(), regions.end());
+  return ins.first->second;
+}
+
+const std::vector<MemReg *> &
+MemReg::getPointeeAllFieldRegions(const AndersPtsView &ptsView) {
+  auto ins = ptsSetToAllFieldRegsMap.insert(
+      make_pair(ptsView.getId(), vector<MemReg *>()));
+  if (!ins.second)
+    return ins.first->second;
+
+  // The fields of an object are adjacent in the set.
+  std::set<MemReg *> regions;
+  const Value *last = nullptr;
+  for (auto p : ptsView) {
+    if (p.first == last)
+      continue;
+    last = p.first;
+
+    auto I = valueToRegMap.find(p.first);
+    if (I != valueToRegMap.end())
+      regions.insert(I->second.begin(), I->second.end());
+  }
+
+  ins.first->second.assign(regions.begin(), regions.end());
+  return ins.first->second;
+}
+
 const std::set<MemReg *> &MemReg::getCudaSharedRegions() {
   return sharedCudaRegions;
 }
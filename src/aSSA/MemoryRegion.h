@@ -2,6 +2,7 @@
 #define MEMORYREGION_H
 
 #include "Utils.h"
+#include "andersen/PtsView.h"
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Value.h"
@@ -16,25 +17,45 @@ class MemReg {
   unsigned id;
 
 protected:
-  MemReg(const llvm::Value *value);
+  MemReg(const llvm::Value *value, unsigned field = 0);
   ~MemReg() {}
-  static std::map<const llvm::Value *, MemReg *> valueToRegMap;
+  // One region per field distinguished by the pointer analysis.
+  static std::map<const llvm::Value *, std::vector<MemReg *>> valueToRegMap;
   static std::set<MemReg *> sharedCudaRegions;
   static std::map<const llvm::Function *, std::set<MemReg *>>
       func2SharedOmpRegs;
+  // The regions of the pointees of each distinct pts-to set, by the id of
+  // the set, with one region per field or with all the fields.
+  static std::map<const void *, std::vector<MemReg *>> ptsSetToRegsMap;
+  static std::map<const void *, std::vector<MemReg *>> ptsSetToAllFieldRegsMap;
   const llvm::Value *value;
+  unsigned field;
   bool isCudaShared;
 
 public:
   std::string getName() const;
 
-  static void createRegion(const llvm::Value *v);
+  static void createRegion(const llvm::Value *v, unsigned nbFields = 1);
   static void setOmpSharedRegions(const llvm::Function *F,
-                                  std::vector<MemReg *> &regs);
+                                  const std::vector<MemReg *> &regs);
   static void dumpRegions();
-  static MemReg *getValueRegion(const llvm::Value *v);
+  // The region of one field of an allocation site. The fields past the last
+  // region share it, as they share its node in the Andersen analysis.
+  static MemReg *getValueRegion(const llvm::Value *v, unsigned field);
+  static void getValueRegions(const llvm::Value *v,
+                              std::vector<MemReg *> &regs);
   static void getValuesRegion(std::vector<const llvm::Value *> &ptsSet,
                               std::vector<MemReg *> &regs);
+  static void
+  getValuesRegion(std::vector<std::pair<const llvm::Value *, unsigned>> &ptsSet,
+                  std::vector<MemReg *> &regs);
+  // Same as getValuesRegion() on the pointees of a pts-to view, with or
+  // without their field. The regions are computed once per distinct pts-to
+  // set, and the vector stays valid until regions are created again.
+  static const std::vector<MemReg *> &
+  getPointeeRegions(const AndersPtsView &ptsView);
+  static const std::vector<MemReg *> &
+  getPointeeAllFieldRegions(const AndersPtsView &ptsView);
   static const std::set<MemReg *> &getCudaSharedRegions();
   static const std::set<MemReg *> &getOmpSharedRegions(const llvm::Function *F);
 };
@@ -97,10 +97,9 @@ void MemorySSA::computeMuChi(const Function *F) {
      */
     if (isa<LoadInst>(inst)) {
       const LoadInst *LI = cast<LoadInst>(inst);
-      vector<const Value *> ptsSet;
-      assert(PTA->getPointsToSet(LI->getPointerOperand(), ptsSet));
-      vector<MemReg *> regs;
-      MemReg::getValuesRegion(ptsSet, regs);
+      AndersPtsView ptsView = PTA->getPointsToView(LI->getPointerOperand());
+      assert(ptsView.isKnown());
+      const vector<MemReg *> &regs = MemReg::getPointeeRegions(ptsView);
 
       for (MemReg *r : regs) {
         if (MRA->globalKillSet.find(r) != MRA->globalKillSet.end())
@@ -119,10 +118,9 @@ void MemorySSA::computeMuChi(const Function *F) {
      */
     if (isa<StoreInst>(inst)) {
       const StoreInst *SI = cast<StoreInst>(inst);
-      vector<const Value *> ptsSet;
-      assert(PTA->getPointsToSet(SI->getPointerOperand(), ptsSet));
-      vector<MemReg *> regs;
-      MemReg::getValuesRegion(ptsSet, regs);
+      AndersPtsView ptsView = PTA->getPointsToView(SI->getPointerOperand());
+      assert(ptsView.isKnown());
+      const vector<MemReg *> &regs = MemReg::getPointeeRegions(ptsView);
 
       for (MemReg *r : regs) {
         if (MRA->globalKillSet.find(r) != MRA->globalKillSet.end())
@@ -211,13 +209,9 @@ void MemorySSA::computeMuChiForCalledFunction(const Instruction *inst,
         delete inst;
       }
 
-      vector<const Value *> ptsSet;
-      vector<const Value *> argPtsSet;
-      assert(PTA->getPointsToSet(arg, argPtsSet));
-      ptsSet.insert(ptsSet.end(), argPtsSet.begin(), argPtsSet.end());
-
-      vector<MemReg *> regs;
-      MemReg::getValuesRegion(ptsSet, regs);
+      AndersPtsView ptsView = PTA->getPointsToView(arg);
+      assert(ptsView.isKnown());
+      const vector<MemReg *> &regs = MemReg::getPointeeAllFieldRegions(ptsView);
 
       // Mus
       for (MemReg *r : regs) {
@@ -255,10 +249,9 @@ void MemorySSA::computeMuChiForCalledFunction(const Instruction *inst,
 
     // Chi for return value if it is a pointer
     if (CI->getType()->isPointerTy() && info->retIsMod) {
-      vector<const Value *> ptsSet;
-      assert(PTA->getPointsToSet(CI, ptsSet));
-      vector<MemReg *> regs;
-      MemReg::getValuesRegion(ptsSet, regs);
+      AndersPtsView ptsView = PTA->getPointsToView(CI);
+      assert(ptsView.isKnown());
+      const vector<MemReg *> &regs = MemReg::getPointeeAllFieldRegions(ptsView);
 
       for (MemReg *r : regs) {
         if (MRA->globalKillSet.find(r) != MRA->globalKillSet.end())
@@ -15,16 +15,16 @@ ModRefAnalysis::ModRefAnalysis(PTACallGraph &CG, Andersen *PTA,
 ModRefAnalysis::~ModRefAnalysis() {}
 
 void ModRefAnalysis::visitAllocaInst(AllocaInst &I) {
-  MemReg *r = MemReg::getValueRegion(&I);
-  assert(r);
-  funcLocalMap[curFunc].insert(r);
+  vector<MemReg *> regs;
+  MemReg::getValueRegions(&I, regs);
+  assert(!regs.empty());
+  funcLocalMap[curFunc].insert(regs.begin(), regs.end());
 }
 
 void ModRefAnalysis::visitLoadInst(LoadInst &I) {
-  vector<const Value *> ptsSet;
-  assert(PTA->getPointsToSet(I.getPointerOperand(), ptsSet));
-  vector<MemReg *> regs;
-  MemReg::getValuesRegion(ptsSet, regs);
+  AndersPtsView ptsView = PTA->getPointsToView(I.getPointerOperand());
+  assert(ptsView.isKnown());
+  const vector<MemReg *> &regs = MemReg::getPointeeRegions(ptsView);
 
   for (MemReg *r : regs) {
     if (globalKillSet.find(r) != globalKillSet.end())
@@ -34,10 +34,9 @@ void ModRefAnalysis::visitLoadInst(LoadInst &I) {
 }
 
 void ModRefAnalysis::visitStoreInst(StoreInst &I) {
-  vector<const Value *> ptsSet;
-  assert(PTA->getPointsToSet(I.getPointerOperand(), ptsSet));
-  vector<MemReg *> regs;
-  MemReg::getValuesRegion(ptsSet, regs);
+  AndersPtsView ptsView = PTA->getPointsToView(I.getPointerOperand());
+  assert(ptsView.isKnown());
+  const vector<MemReg *> &regs = MemReg::getPointeeRegions(ptsView);
 
   for (MemReg *r : regs) {
     if (globalKillSet.find(r) != globalKillSet.end())
@@ -118,11 +117,10 @@ void ModRefAnalysis::visitCallSite(CallSite CS) {
       delete inst;
     }
 
-    vector<const Value *> argPtsSet;
-
-    assert(PTA->getPointsToSet(arg, argPtsSet));
-    vector<MemReg *> regs;
-    MemReg::getValuesRegion(argPtsSet, regs);
+    AndersPtsView argPtsView = PTA->getPointsToView(arg);
+    assert(argPtsView.isKnown());
+    const vector<MemReg *> &regs =
+        MemReg::getPointeeAllFieldRegions(argPtsView);
 
     for (MemReg *r : regs) {
       if (globalKillSet.find(r) != globalKillSet.end())
@@ -204,10 +202,10 @@ void ModRefAnalysis::visitCallSite(CallSite CS) {
     assert(info);
 
     if (callee->getReturnType()->isPointerTy()) {
-      vector<const Value *> retPtsSet;
-      assert(PTA->getPointsToSet(CI, retPtsSet));
-      vector<MemReg *> regs;
-      MemReg::getValuesRegion(retPtsSet, regs);
+      AndersPtsView retPtsView = PTA->getPointsToView(CI);
+      assert(retPtsView.isKnown());
+      const vector<MemReg *> &regs =
+          MemReg::getPointeeAllFieldRegions(retPtsView);
       for (MemReg *r : regs) {
         if (globalKillSet.find(r) != globalKillSet.end())
           continue;
@@ -233,10 +231,10 @@ void ModRefAnalysis::visitCallSite(CallSite CS) {
       assert(info);
 
       if (mayCallee->getReturnType()->isPointerTy()) {
-        vector<const Value *> retPtsSet;
-        assert(PTA->getPointsToSet(CI, retPtsSet));
-        vector<MemReg *> regs;
-        MemReg::getValuesRegion(retPtsSet, regs);
+        AndersPtsView retPtsView = PTA->getPointsToView(CI);
+        assert(retPtsView.isKnown());
+        const vector<MemReg *> &regs =
+            MemReg::getPointeeAllFieldRegions(retPtsView);
         for (MemReg *r : regs) {
           if (globalKillSet.find(r) != globalKillSet.end())
             continue;
@@ -269,7 +267,9 @@ void ModRefAnalysis::analyze() {
       continue;
     if (CG.isReachableFromEntry(inst->getParent()->getParent()))
       continue;
-    globalKillSet.insert(MemReg::getValueRegion(v));
+    vector<MemReg *> regs;
+    MemReg::getValueRegions(v, regs);
+    globalKillSet.insert(regs.begin(), regs.end());
   }
 
   // First compute the mod/ref sets of each function from its load/store
@@ -98,16 +98,22 @@ void PTACallGraph::addToCallGraph(Function *F) {
           const Value *calledValue = CI.getCalledValue();
           assert(calledValue);
 
-          std::vector<const Value *> ptsSet;
-          if (!AA->getPointsToSet(calledValue, ptsSet)) {
+          AndersPtsView ptsView = AA->getPointsToView(calledValue);
+          if (!ptsView.isKnown()) {
             errs() << "coult not compute points to set for call inst : " << I
                    << "\n";
             continue;
           }
 
           bool found = false;
-          for (const Value *v : ptsSet) {
-            Callee = dyn_cast<Function>(v);
+          const Value *last = nullptr;
+          for (auto pointee : ptsView) {
+            // The fields of an object are adjacent in the set.
+            if (pointee.first == last)
+              continue;
+            last = pointee.first;
+
+            Callee = dyn_cast<Function>(pointee.first);
             if (!Callee)
               continue;
 
@@ -392,7 +392,7 @@ bool ParcoachInstr::runOnModule(Module &M) {
              << ((float)regCounter) / regions.size() * 100 << "%)\n";
     }
     regCounter++;
-    MemReg::createRegion(r);
+    MemReg::createRegion(r, AA.getNumFields(r));
   }
   tend_regcreation = gettime();
 
@@ -407,12 +407,10 @@ bool ParcoachInstr::runOnModule(Module &M) {
       const Function *F = I.first;
 
       for (const Value *v : I.second) {
-        vector<const Value *> ptsSet;
-        if (AA.getPointsToSet(v, ptsSet)) {
-          vector<MemReg *> regs;
-          MemReg::getValuesRegion(ptsSet, regs);
-          MemReg::setOmpSharedRegions(F, regs);
-        }
+        AndersPtsView ptsView = AA.getPointsToView(v);
+        if (ptsView.isKnown())
+          MemReg::setOmpSharedRegions(
+              F, MemReg::getPointeeAllFieldRegions(ptsView));
       }
     }
   }
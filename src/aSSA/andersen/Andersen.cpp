@@ -4,64 +4,243 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+
+#include <chrono>
+#include <cmath>
 
 using namespace llvm;
 
 cl::opt<bool> DumpDebugInfo("dump-debug", cl::desc("Dump debug info into stderr"), cl::init(false), cl::Hidden);
 cl::opt<bool> DumpResultInfo("dump-result", cl::desc("Dump result info into stderr"), cl::init(false), cl::Hidden);
 cl::opt<bool> DumpConstraintInfo("dump-cons", cl::desc("Dump constraint info into stderr"), cl::init(false), cl::Hidden);
+cl::opt<bool> DemandDriven("anders-demand", cl::desc("Only solve the constraints that the pts-to queries depend on, when they are asked. Only the functions reachable from main are collected, as with -anders-reachable-only"), cl::init(false));
+cl::opt<bool> ReportUnmodeledCalls("anders-report-unmodeled", cl::desc("List the external functions the Andersen analysis has no model of, by the number of pointers their calls make point to anything"), cl::init(false));
+cl::opt<unsigned> DemandBudget("anders-demand-budget", cl::desc("Number of steps a demand-driven query may take before the whole program gets solved instead"), cl::init(1000000));
+cl::opt<bool> FreezeResults("anders-freeze", cl::desc("Once the constraints are solved, keep the pts-to sets in a compact table and release the memory of the solver"), cl::init(true));
+
+extern cl::opt<std::string> ExportConstraintsFile;
+extern cl::opt<bool> ExportOptimizedConstraints;
+extern cl::opt<bool> CompareSolvers;
+extern cl::opt<bool> AutoOptimize;
+extern cl::opt<bool> AutoOptimizeBaseline;
+
+namespace {
 
-Andersen::Andersen(const Module& module)
+// The number of analyses that hold pts-to sets. The sets are hash-consed into a pool that all the analyses share, so the pool can only be released once none of them holds any
+unsigned numPtsSetHolders = 0;
+
+}	// end of anonymous namespace
+
+Andersen::Andersen(): reachableOnly(false), numDiscoveredConstraints(0), holdsPtsSets(true), numNodeVisits(0), optimized(false)
 {
+	++numPtsSetHolders;
+}
+
+Andersen::Andersen(const Module& module): reachableOnly(false), numDiscoveredConstraints(0), holdsPtsSets(true), numNodeVisits(0), optimized(false)
+{
+	++numPtsSetHolders;
 	runOnModule(module);
 }
 
+Andersen::~Andersen()
+{
+	releasePtsSets();
+}
+
+void Andersen::releasePtsSets()
+{
+	if (!holdsPtsSets)
+		return;
+	holdsPtsSets = false;
+	if (--numPtsSetHolders == 0)
+		AndersPtsSet::releasePool();
+}
+
 void Andersen::getAllAllocationSites(std::vector<const llvm::Value*>& allocSites) const
 {
-	nodeFactory.getAllocSites(allocSites);
+	if (frozenGraph)
+		allocSites = frozenGraph->getAllocSites();
+	else
+		nodeFactory.getAllocSites(allocSites);
+}
+
+AndersPtsSet Andersen::getPtsSetFor(NodeIndex n) const
+{
+	if (demandSolver)
+	{
+		AndersPtsSet ptsSet;
+		if (demandSolver->query(n, ptsSet))
+			return ptsSet;
+
+		// This query is as costly as the whole program. Solving it changes how the solution is computed, not what it is, which is why the queries are const
+		errs() << "Demand-driven pts-to query out of budget, solving the whole program\n";
+		const_cast<Andersen*>(this)->solveAfterDemand();
+	}
+	return ptsGraph[nodeFactory.getMergeTarget(n)];
+}
+
+// The demand-driven solver gives up: solve the constraints it has kept as usual
+void Andersen::solveAfterDemand()
+{
+	demandSolver.reset();
+	optimizeConstraints();
+	solveConstraints();
 }
 
 bool Andersen::getPointsToSet(const llvm::Value* v, std::vector<const llvm::Value*>& ptsSet) const
 {
-	NodeIndex ptrIndex = nodeFactory.getValueNodeFor(v);
+	AndersPtsView ptsView = getPointsToView(v);
 	// We have no idea what v is...
-	if (ptrIndex == AndersNodeFactory::InvalidIndex || ptrIndex == nodeFactory.getUniversalPtrNode())
+	if (!ptsView.isKnown())
 		return false;
 
-	NodeIndex ptrTgt = nodeFactory.getMergeTarget(ptrIndex);
+	// If v points to nothing, the reason might be that it is an undefined pointer. Dereferencing it is undefined behavior anyway, so we might just want to treat it as a nullptr pointer
 	ptsSet.clear();
-
-	auto ptsItr = ptsGraph.find(ptrTgt);
-	if (ptsItr == ptsGraph.end())
+	for (auto const& pointee: ptsView)
 	{
-		// Can't find ptrTgt. The reason might be that ptrTgt is an undefined pointer. Dereferencing it is undefined behavior anyway, so we might just want to treat it as a nullptr pointer
-		return true;
+		// The fields of an object are adjacent, so they only need to be checked against the last value
+		if (ptsSet.empty() || ptsSet.back() != pointee.first)
+			ptsSet.push_back(pointee.first);
 	}
-	for (auto v: ptsItr->second)
-	{
-		if (v == nodeFactory.getNullObjectNode())
-			continue;
+	return true;
+}
 
-		const llvm::Value* val = nodeFactory.getValueForNode(v);
-		if (val != nullptr)
-			ptsSet.push_back(val);
-	}
+bool Andersen::getPointsToSet(const llvm::Value* v, std::vector<std::pair<const llvm::Value*, unsigned>>& ptsSet) const
+{
+	AndersPtsView ptsView = getPointsToView(v);
+	// We have no idea what v is...
+	if (!ptsView.isKnown())
+		return false;
+
+	ptsSet.assign(ptsView.begin(), ptsView.end());
 	return true;
 }
 
+AndersPtsView Andersen::getPointsToView(const llvm::Value* v) const
+{
+	if (frozenGraph)
+		return frozenGraph->getPointsToView(v);
+
+	NodeIndex ptrIndex = nodeFactory.getValueNodeFor(v);
+	if (ptrIndex == AndersNodeFactory::InvalidIndex || ptrIndex == nodeFactory.getUniversalPtrNode())
+		return AndersPtsView();
+
+	// Moving the vectors when the map grows keeps their elements in place, so the views handed out so far stay valid
+	AndersPtsSet ptsSet = getPtsSetFor(ptrIndex);
+	auto ins = translatedSets.insert(std::make_pair(ptsSet.getId(), std::vector<AndersPointee>()));
+	std::vector<AndersPointee>& pointees = ins.first->second;
+	if (ins.second)
+		AndersFrozenPtsGraph::appendPointees(nodeFactory, ptsSet, pointees);
+	return AndersPtsView(pointees.data(), pointees.data() + pointees.size());
+}
+
+unsigned Andersen::getNumFields(const llvm::Value* allocSite) const
+{
+	if (frozenGraph)
+		return frozenGraph->getNumFields(allocSite);
+
+	NodeIndex objIndex = nodeFactory.getObjectNodeFor(allocSite);
+	if (objIndex == AndersNodeFactory::InvalidIndex)
+		return 1;
+	return nodeFactory.getObjectSize(objIndex);
+}
+
+const AndersReverseIndex& Andersen::getReverseIndex()
+{
+	if (!reverseIndex)
+	{
+		freeze();
+		reverseIndex.reset(new AndersReverseIndex());
+		reverseIndex->build(*frozenGraph);
+	}
+	return *reverseIndex;
+}
+
+AndersReverseIndex::PointerRange Andersen::getPointersTo(const llvm::Value* allocSite, unsigned field)
+{
+	const AndersReverseIndex& index = getReverseIndex();
+	return index.getPointersTo(frozenGraph->getObjectSlot(allocSite, field));
+}
+
+void Andersen::freeze()
+{
+	if (frozenGraph)
+		return;
+
+	// All the pts-to sets are needed now
+	if (demandSolver)
+		solveAfterDemand();
+
+	frozenGraph.reset(new AndersFrozenPtsGraph());
+	frozenGraph->build(nodeFactory, ptsGraph);
+
+	// Swap the containers with empty ones, as clear() keeps their storage
+	AndersPtsGraph().swap(ptsGraph);
+	AndersPtsGraph().swap(seedPtsGraph);
+	std::vector<AndersConstraint>().swap(newConstraints);
+	std::vector<AndersConstraint>().swap(constraints);
+	std::vector<AndersConstraint>().swap(collectedConstraints);
+	std::vector<AndersIndirectCall>().swap(indirectCalls);
+	std::vector<AndersCallTarget>().swap(indirectCallTargets);
+	std::vector<std::string>().swap(nodeKeys);
+	std::vector<const llvm::Function*>().swap(pendingFunctions);
+	reachableFunctions = DenseSet<const llvm::Function*>();
+	pointerTypes = DenseMap<llvm::Type*, bool>();
+	translatedSets = DenseMap<const void*, std::vector<AndersPointee>>();
+	unmodeledCalls.clear();
+	nodeFactory = AndersNodeFactory();
+	releasePtsSets();
+}
+
 bool Andersen::runOnModule(const Module &M)
 {
 	collectConstraints(M);
 
+	if (ReportUnmodeledCalls)
+		reportUnmodeledCalls();
+
 	if (DumpDebugInfo)
 		dumpConstraintsPlainVanilla();
 
-	optimizeConstraints();
+	if (!ExportConstraintsFile.empty() && !ExportOptimizedConstraints)
+		exportConstraints(ExportConstraintsFile, false);
 
-	if (DumpConstraintInfo)
-		dumpConstraints();
+	// The cache stores the solved graph. The constraints still have to be collected to map the values to their nodes
+	if (!loadCachedResults(M))
+	{
+		if (DemandDriven)
+		{
+			// Keep the constraints: they are still needed if a query runs out of budget
+			demandSolver.reset(new AndersDemandSolver(constraints, nodeFactory, DemandBudget));
+			ptsGraph.resize(nodeFactory.getNumNodes());
+		}
+		else
+		{
+			// The baseline runs first, on a copy of the constraints
+			double baselineTime = AutoOptimize && AutoOptimizeBaseline && !CompareSolvers ? timeBaselineSolve() : -1;
+			auto optimizeStart = std::chrono::steady_clock::now();
+			optimizeConstraints();
+			double optimizeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - optimizeStart).count();
 
-	solveConstraints();
+			if (DumpConstraintInfo)
+				dumpConstraints();
+			if (!ExportConstraintsFile.empty() && ExportOptimizedConstraints)
+				exportConstraints(ExportConstraintsFile, true);
+
+			if (CompareSolvers)
+				solveAndCompareConstraints();
+			else
+			{
+				auto solveStart = std::chrono::steady_clock::now();
+				solveConstraints();
+				double time = optimizeTime + std::chrono::duration<double>(std::chrono::steady_clock::now() - solveStart).count();
+				if (baselineTime >= 0)
+					errs() << format("Andersen automatic optimizations: %.3f s, against %.3f s without them (%.3f s %s)\n", time, baselineTime, std::abs(baselineTime - time), time <= baselineTime ? "saved" : "lost");
+			}
+			saveCachedResults(M);
+		}
+	}
 
 	if (DumpDebugInfo)
 	{
@@ -75,7 +254,9 @@ bool Andersen::runOnModule(const Module &M)
 		errs() << "\n";
 		dumpPtsGraphPlainVanilla();	
 	}
-	
+
+	if (FreezeResults && !demandSolver)
+		freeze();
 
 	return false;
 }
@@ -114,6 +295,17 @@ void Andersen::dumpConstraint(const AndersConstraint& item) const
 			nodeFactory.dumpNode(dest);
 			errs() << " = &";
 			nodeFactory.dumpNode(src);
+			break;
+		}
+		case AndersConstraint::GEP:
+		{
+			nodeFactory.dumpNode(dest);
+			errs() << " = ";
+			nodeFactory.dumpNode(src);
+			if (item.getOffset() == AndersNodeFactory::UnknownOffset)
+				errs() << " + ?";
+			else
+				errs() << " + " << item.getOffset();
 		}
 	}
 
@@ -132,7 +324,23 @@ void Andersen::dumpConstraintsPlainVanilla() const
 {
 	for (auto const& item: constraints)
 	{
-		errs() << item.getType() << " " << item.getDest() << " " << item.getSrc() << " 0\n";
+		errs() << item.getType() << " " << item.getDest() << " " << item.getSrc() << " " << item.getOffset() << "\n";
+	}
+}
+
+void Andersen::printPtsGraph(raw_ostream& os) const
+{
+	assert(!frozenGraph && "The node indices are gone once frozen");
+	for (NodeIndex i = 0, e = nodeFactory.getNumNodes(); i < e; ++i)
+	{
+		os << i << ":";
+		NodeIndex rep = nodeFactory.getMergeTarget(i);
+		if (rep < ptsGraph.size())
+		{
+			for (auto v: ptsGraph[rep])
+				os << " " << v;
+		}
+		os << "\n";
 	}
 }
 
@@ -141,11 +349,11 @@ void Andersen::dumpPtsGraphPlainVanilla() const
 	for (unsigned i = 0, e = nodeFactory.getNumNodes(); i < e; ++i)
 	{
 		NodeIndex rep = nodeFactory.getMergeTarget(i);
-		auto ptsItr = ptsGraph.find(rep);
-		if (ptsItr != ptsGraph.end())
+		const AndersPtsSet& ptsSet = ptsGraph[rep];
+		if (!ptsSet.isEmpty())
 		{
 			errs() << i << " ";
-			for (auto v: ptsItr->second)
+			for (auto v: ptsSet)
 				errs() << v << " ";
 			errs() << "\n";
 		}
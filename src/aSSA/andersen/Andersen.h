@@ -45,16 +45,30 @@
 #ifndef TCFS_ANDERSEN_H
 #define TCFS_ANDERSEN_H
 
+#include "CollectBuffer.h"
 #include "Constraint.h"
+#include "DemandSolver.h"
+#include "FrozenPtsGraph.h"
 #include "NodeFactory.h"
 #include "PtsSet.h"
+#include "PtsView.h"
+#include "ReverseIndex.h"
 
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/raw_ostream.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
+// The points-to graph, indexed by NodeIndex. Only the entries of representative nodes are meaningful
+typedef std::vector<AndersPtsSet> AndersPtsGraph;
+
 class Andersen
 {
 private:
@@ -63,22 +77,104 @@ private:
 
 	// Constraints - This vector contains a list of all of the constraints identified by the program.
 	std::vector<AndersConstraint> constraints;
+	// The indirect calls whose targets are resolved during the solving (-anders-otf-calls). Their argument and return constraints are added as the called pointers get new pointees
+	std::vector<AndersIndirectCall> indirectCalls;
+	// The functions they may call: the addr-taken functions that have a body
+	std::vector<AndersCallTarget> indirectCallTargets;
+
+	// With -anders-reachable-only, the functions whose constraints have been or are to be collected, and those of them still waiting for it
+	bool reachableOnly;
+	llvm::DenseSet<const llvm::Function*> reachableFunctions;
+	std::vector<const llvm::Function*> pendingFunctions;
+	// The number of constraints the solution of the last discovery round satisfies (see discoverIndirectCallTargets())
+	size_t numDiscoveredConstraints;
+
+	// With -anders-summarize-globals, what the initializers of the globals have added so far: the aggregates and the pointees, each with the field node it went to. And whether each type holds a pointer
+	llvm::DenseSet<std::pair<NodeIndex, const llvm::Constant*>> summarizedInits;
+	llvm::DenseSet<std::pair<NodeIndex, NodeIndex>> summarizedPointees;
+	llvm::DenseMap<llvm::Type*, bool> pointerTypes;
+
+	// The external functions without model, with the number of pointers their calls make point to anything (see ExternalLibrary.cpp)
+	llvm::StringMap<unsigned> unmodeledCalls;
 
 	// This is the points-to graph generated by the analysis
-	std::map<NodeIndex, AndersPtsSet> ptsGraph;
+	AndersPtsGraph ptsGraph;
+
+	// The solution once frozen (see freeze()). The solver state is gone then, and the queries only look here
+	std::unique_ptr<AndersFrozenPtsGraph> frozenGraph;
+	// Until then, the pointees of the pts-to sets getPointsToView() has been asked for, by the id of the set
+	mutable llvm::DenseMap<const void*, std::vector<AndersPointee>> translatedSets;
+	// Whether this analysis still holds pts-to sets from the pool all the analyses share (see releasePtsSets())
+	bool holdsPtsSets;
+
+	// The inverse of the frozen solution, built by the first getReverseIndex()
+	std::unique_ptr<AndersReverseIndex> reverseIndex;
 
-	// Three main phases
+	// MD5 digest of the solver input (see writeSolverInput()), used as the key of the on-disk result cache (-anders-cache)
+	std::string inputDigest;
+	// Incremental solving (-anders-incremental): the constraints as collected and the index-independent name of every node, both saved along with the results
+	std::vector<AndersConstraint> collectedConstraints;
+	std::vector<std::string> nodeKeys;
+	// A solution of all the constraints but newConstraints, which the solver starts from. It only propagates what newConstraints add to it (see seedSolution() in ConstraintSolving.cpp)
+	AndersPtsGraph seedPtsGraph;
+	std::vector<AndersConstraint> newConstraints;
+
+	// With -anders-demand, the constraints are not solved up front: this solver answers the queries instead, until one of them runs out of budget
+	std::unique_ptr<AndersDemandSolver> demandSolver;
+
+	// Number of node visits of the solver so far
+	uint64_t numNodeVisits;
+	// Whether optimizeConstraints() has run on the constraints, here or before they were dumped. It must not run twice
+	bool optimized;
+
+	// An analysis without module, for importConstraints()
+	Andersen();
+
+	// The first main phase. The other two are public for the replay of constraint dumps
 	void collectConstraints(const llvm::Module&);
-	void optimizeConstraints();
-	void solveConstraints();
 
 	// Helper functions for constraint collection
 	void collectConstraintsForGlobals(const llvm::Module&);
-	void collectConstraintsForInstruction(const llvm::Instruction*);
+	void collectConstraintsForFunctions(const std::vector<const llvm::Function*>& functions);
+	void collectConstraintsForFunction(const llvm::Function&, AndersCollectBuffer&);
+	// Create the nodes buf has reserved, with provisionalMap taking their provisional indices (from firstIndex on) to the real ones, and move its constraints over
+	void mergeCollectBuffer(AndersCollectBuffer& buf, NodeIndex firstIndex, std::vector<NodeIndex>& provisionalMap);
+	// Queue f for collection if the constraints are only collected for the reachable functions, and f has a body that is not queued yet. Return true if f was queued
+	bool addReachableFunction(const llvm::Function* f);
+	// Solve the constraints collected so far and queue the functions the indirect calls turn out to reach. Return true if there is any
+	bool discoverIndirectCallTargets();
+	void collectConstraintsForInstruction(const llvm::Instruction*, AndersCollectBuffer&);
+	void collectConstraintsForConstantGEPs(const llvm::User*);
 	void addGlobalInitializerConstraints(NodeIndex, const llvm::Constant*);
-	void addConstraintForCall(llvm::ImmutableCallSite cs);
-	bool addConstraintForExternalLibrary(llvm::ImmutableCallSite cs, const llvm::Function* f);
-	void addArgumentConstraintForCall(llvm::ImmutableCallSite cs, const llvm::Function* f);
+	bool containsPointer(llvm::Type* ty);
+	void addConstraintForCall(llvm::ImmutableCallSite cs, AndersCollectBuffer&);
+	bool addConstraintForExternalLibrary(llvm::ImmutableCallSite cs, const llvm::Function* f, AndersCollectBuffer&);
+	void addArgumentConstraintForCall(llvm::ImmutableCallSite cs, const llvm::Function* f, AndersCollectBuffer&);
+	void recordUnmodeledCall(const llvm::Function* f, unsigned numPollutedPointers);
+	void reportUnmodeledCalls() const;
+
+	// On-disk result cache (see ResultCache.cpp). loadCachedResults() returns false if the cache is disabled, missing or stale. In the latter case, it may still fill seedPtsGraph and newConstraints for an incremental solve
+	void computeInputDigest();
+	bool loadCachedResults(const llvm::Module&);
+	void saveCachedResults(const llvm::Module&) const;
+
+	// Binary constraint dumps (see ConstraintDump.cpp)
+	void exportConstraints(const std::string& path, bool isOptimized) const;
+	void writeSolverInput(llvm::raw_ostream& os) const;
+
+	// Return the pts-to set of n, solving the constraints it depends on first in demand-driven mode
+	AndersPtsSet getPtsSetFor(NodeIndex n) const;
+	void solveAfterDemand();
+	// Stop holding pts-to sets, and release their pool if no other analysis holds any
+	void releasePtsSets();
+
+	// With -anders-compare-solvers: solve the constraints with both kinds of solvers and report how their results compare (see ConstraintSolving.cpp)
+	void solveAndCompareConstraints();
+	void countRegionsPerPointer(std::vector<unsigned>& counts) const;
+
+	// With -anders-auto-opt: turn on the optimizations the statistics of the constraints call for, and time the solving without them (see ConstraintOptimize.cpp)
+	void selectOptimizations();
+	double timeBaselineSolve();
 
 	// Helper functions for constraint optimization
 	NodeIndex getRefNodeIndex(NodeIndex n) const;
@@ -93,15 +189,42 @@ public:
   //	static char ID;
 
 	Andersen(const llvm::Module&);
+	~Andersen();
 	bool runOnModule(const llvm::Module& M);
 
+	// Turn the solution into a compact table of the distinct pts-to sets, then release everything only the solver needs: the constraints, the node factory and the pts-to sets themselves. runOnModule() does it unless -anders-freeze=false or in demand-driven mode, where the whole program gets solved first. Only the queries below still work afterwards
+	void freeze();
+	bool isFrozen() const { return frozenGraph != nullptr; }
+
+	// Replay of the constraints written with -anders-export-cons, without the module they come from: only the solver can run on the result. Return nullptr if the file cannot be read
+	static std::unique_ptr<Andersen> importConstraints(const std::string& path);
+	bool hasOptimizedConstraints() const { return optimized; }
+	void optimizeConstraints();
+	void solveConstraints();
+	uint64_t getNumNodeVisits() const { return numNodeVisits; }
+	// Print the solution before freeze(), one "node: pointees" line per node, to compare solvers on the same dump
+	void printPtsGraph(llvm::raw_ostream& os) const;
+
 	// Given a llvm pointer v,
 	// - Return false if the analysis doesn't know where v points to. In other words, the client must conservatively assume v can points to everything.
 	// - Return true otherwise, and the points-to set of v is put into the second argument.
+	// In demand-driven mode (-anders-demand), the query solves what it needs. The answer is the same as if the whole program had been solved up front, so these are still const
 	bool getPointsToSet(const llvm::Value* v, std::vector<const llvm::Value*>& ptsSet) const;
+	// Same as above, but every pointee comes with the index of the field v points to. The index is always 0 unless the analysis is field-sensitive (-anders-field-sensitive)
+	bool getPointsToSet(const llvm::Value* v, std::vector<std::pair<const llvm::Value*, unsigned>>& ptsSet) const;
+	// The same pointees as the second getPointsToSet(), as a view over the solved pts-to set of v rather than a vector to fill. The view is not known if the analysis doesn't know where v points to
+	AndersPtsView getPointsToView(const llvm::Value* v) const;
+	// Return the number of fields the analysis distinguishes in the object allocated at allocSite
+	unsigned getNumFields(const llvm::Value* allocSite) const;
 	// Put all allocation sites (i.e. all memory objects identified by the analysis) into the first arugment
 	void getAllAllocationSites(std::vector<const llvm::Value*>& allocSites) const;
 
+	// The inverse of getPointsToSet(): the pointers that may point to each memory object. It is built from the frozen solution on the first call, which freezes the analysis if it is not yet, and stays the same afterwards
+	// The pointers getPointsToSet() returns false for are not in it: they may point to any object
+	const AndersReverseIndex& getReverseIndex();
+	// The pointers whose pts-to set, as given with field indices by getPointsToSet(), has the field of the object allocated at allocSite. Empty if allocSite is no allocation site
+	AndersReverseIndex::PointerRange getPointersTo(const llvm::Value* allocSite, unsigned field = 0);
+
   //	friend class AndersenAAResult;
 };
 
@@ -0,0 +1,534 @@
+#include "BitSet.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ANDERS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace llvm;
+
+namespace {
+
+// The word-parallel operations on dense sets. The arrays have the same length n and may overlap only if they are the same array
+struct WordKernels
+{
+	const char* name;
+	// out = a | b
+	void (*orWords)(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n);
+	// out = a & ~b
+	void (*andNotWords)(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n);
+	// Return true if a is a subset of b
+	bool (*isSubset)(const uint64_t* a, const uint64_t* b, size_t n);
+	bool (*intersects)(const uint64_t* a, const uint64_t* b, size_t n);
+	bool (*equals)(const uint64_t* a, const uint64_t* b, size_t n);
+	unsigned (*countBits)(const uint64_t* a, size_t n);
+};
+
+void orWordsScalar(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		out[i] = a[i] | b[i];
+}
+void andNotWordsScalar(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		out[i] = a[i] & ~b[i];
+}
+bool isSubsetScalar(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		if ((a[i] & ~b[i]) != 0)
+			return false;
+	}
+	return true;
+}
+bool intersectsScalar(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		if ((a[i] & b[i]) != 0)
+			return true;
+	}
+	return false;
+}
+bool equalsScalar(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (a[i] != b[i])
+			return false;
+	}
+	return true;
+}
+unsigned countBitsScalar(const uint64_t* a, size_t n)
+{
+	unsigned count = 0;
+	for (size_t i = 0; i < n; ++i)
+		count += __builtin_popcountll(a[i]);
+	return count;
+}
+
+#ifdef ANDERS_X86_KERNELS
+
+// The SSE2 and AVX2 kernels process 2 and 4 words at a time, and finish the tail with the scalar ones. The loads and stores are unaligned since the ranges of two sets rarely start at the same word alignment
+
+__attribute__((target("sse2")))
+void orWordsSSE2(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(va, vb));
+	}
+	orWordsScalar(out + i, a + i, b + i, n - i);
+}
+__attribute__((target("sse2")))
+void andNotWordsSSE2(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		// _mm_andnot_si128 complements its first operand
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_andnot_si128(vb, va));
+	}
+	andNotWordsScalar(out + i, a + i, b + i, n - i);
+}
+__attribute__((target("sse2")))
+bool isZeroSSE2(__m128i v)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+}
+__attribute__((target("sse2")))
+bool isSubsetSSE2(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		if (!isZeroSSE2(_mm_andnot_si128(vb, va)))
+			return false;
+	}
+	return isSubsetScalar(a + i, b + i, n - i);
+}
+__attribute__((target("sse2")))
+bool intersectsSSE2(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		if (!isZeroSSE2(_mm_and_si128(va, vb)))
+			return true;
+	}
+	return intersectsScalar(a + i, b + i, n - i);
+}
+__attribute__((target("sse2")))
+bool equalsSSE2(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF)
+			return false;
+	}
+	return equalsScalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void orWordsAVX2(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_or_si256(va, vb));
+	}
+	orWordsScalar(out + i, a + i, b + i, n - i);
+}
+__attribute__((target("avx2")))
+void andNotWordsAVX2(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_andnot_si256(vb, va));
+	}
+	andNotWordsScalar(out + i, a + i, b + i, n - i);
+}
+__attribute__((target("avx2")))
+bool isSubsetAVX2(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		// testc sets its result iff (~vb & va) is zero
+		if (!_mm256_testc_si256(vb, va))
+			return false;
+	}
+	return isSubsetScalar(a + i, b + i, n - i);
+}
+__attribute__((target("avx2")))
+bool intersectsAVX2(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		if (!_mm256_testz_si256(va, vb))
+			return true;
+	}
+	return intersectsScalar(a + i, b + i, n - i);
+}
+__attribute__((target("avx2")))
+bool equalsAVX2(const uint64_t* a, const uint64_t* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(va, vb)) != -1)
+			return false;
+	}
+	return equalsScalar(a + i, b + i, n - i);
+}
+// The CPUs with AVX2 all have popcnt, which the generic build may not use
+__attribute__((target("avx2,popcnt")))
+unsigned countBitsAVX2(const uint64_t* a, size_t n)
+{
+	unsigned count = 0;
+	for (size_t i = 0; i < n; ++i)
+		count += __builtin_popcountll(a[i]);
+	return count;
+}
+
+#endif
+
+const WordKernels& getKernels()
+{
+	static const WordKernels scalarKernels = {"scalar", orWordsScalar, andNotWordsScalar, isSubsetScalar, intersectsScalar, equalsScalar, countBitsScalar};
+#ifdef ANDERS_X86_KERNELS
+	static const WordKernels sse2Kernels = {"sse2", orWordsSSE2, andNotWordsSSE2, isSubsetSSE2, intersectsSSE2, equalsSSE2, countBitsScalar};
+	static const WordKernels avx2Kernels = {"avx2", orWordsAVX2, andNotWordsAVX2, isSubsetAVX2, intersectsAVX2, equalsAVX2, countBitsAVX2};
+	static const WordKernels& kernels = []() -> const WordKernels&
+	{
+		// The sets are only built once the pass runs, long after the constructor that fills in the CPU features
+		if (__builtin_cpu_supports("avx2"))
+			return avx2Kernels;
+		if (__builtin_cpu_supports("sse2"))
+			return sse2Kernels;
+		return scalarKernels;
+	}();
+	return kernels;
+#else
+	return scalarKernels;
+#endif
+}
+
+}	// end of anonymous namespace
+
+AndersBitSet::AndersBitSet(const SparseBitVector<>& bv): baseWord(0), numElems(0), dense(false)
+{
+	for (auto idx: bv)
+		elems.push_back(idx);
+	numElems = elems.size();
+	normalize();
+}
+
+AndersBitSet::AndersBitSet(std::vector<unsigned>&& sortedElems): elems(std::move(sortedElems)), baseWord(0), numElems(elems.size()), dense(false)
+{
+	assert(std::is_sorted(elems.begin(), elems.end()) && std::adjacent_find(elems.begin(), elems.end()) == elems.end() && "The elements are not sorted!");
+	normalize();
+}
+
+void AndersBitSet::makeDense()
+{
+	baseWord = elems.front() / 64;
+	words.assign(elems.back() / 64 - baseWord + 1, 0);
+	for (auto idx: elems)
+		words[idx / 64 - baseWord] |= uint64_t(1) << (idx % 64);
+	std::vector<unsigned>().swap(elems);
+	dense = true;
+}
+
+void AndersBitSet::makeSparse()
+{
+	std::vector<unsigned> sparseElems;
+	sparseElems.reserve(numElems);
+	for (auto idx: *this)
+		sparseElems.push_back(idx);
+	elems.swap(sparseElems);
+	std::vector<uint64_t>().swap(words);
+	baseWord = 0;
+	dense = false;
+}
+
+void AndersBitSet::normalize()
+{
+	if (!dense)
+	{
+		if (numElems > MaxSparseSize && (elems.back() / 64 - elems.front() / 64 + 1) * 2 <= numElems)
+			makeDense();
+		return;
+	}
+
+	if (numElems == 0)
+	{
+		std::vector<uint64_t>().swap(words);
+		baseWord = 0;
+		dense = false;
+		return;
+	}
+	// Trim the zero words at both ends
+	size_t first = 0, last = words.size();
+	while (words[first] == 0)
+		++first;
+	while (words[last - 1] == 0)
+		--last;
+	if (first != 0 || last != words.size())
+	{
+		words.erase(words.begin() + last, words.end());
+		words.erase(words.begin(), words.begin() + first);
+		baseWord += first;
+	}
+	if (numElems <= MaxSparseSize || words.size() * 2 > numElems)
+		makeSparse();
+}
+
+void AndersBitSet::extendWords(unsigned first, unsigned last)
+{
+	assert(dense && first <= baseWord && last >= baseWord + words.size() - 1);
+	words.insert(words.begin(), baseWord - first, 0);
+	baseWord = first;
+	words.resize(last - first + 1, 0);
+}
+
+bool AndersBitSet::test(unsigned idx) const
+{
+	if (!dense)
+		return std::binary_search(elems.begin(), elems.end(), idx);
+	unsigned word = idx / 64;
+	if (word < baseWord || word - baseWord >= words.size())
+		return false;
+	return (words[word - baseWord] >> (idx % 64)) & 1;
+}
+
+bool AndersBitSet::contains(const AndersBitSet& other) const
+{
+	if (other.numElems > numElems)
+		return false;
+	if (other.numElems == 0)
+		return true;
+
+	if (dense && other.dense)
+	{
+		// The end words of other are not zero, so they have to be in our range
+		if (other.baseWord < baseWord || other.baseWord + other.words.size() > baseWord + words.size())
+			return false;
+		return getKernels().isSubset(other.words.data(), words.data() + (other.baseWord - baseWord), other.words.size());
+	}
+	if (dense)
+		return std::all_of(other.elems.begin(), other.elems.end(), [this](unsigned idx) { return test(idx); });
+	if (!other.dense)
+		return std::includes(elems.begin(), elems.end(), other.elems.begin(), other.elems.end());
+
+	auto itr = elems.begin(), ite = elems.end();
+	for (auto idx: other)
+	{
+		itr = std::lower_bound(itr, ite, idx);
+		if (itr == ite || *itr != idx)
+			return false;
+	}
+	return true;
+}
+
+bool AndersBitSet::intersects(const AndersBitSet& other) const
+{
+	if (numElems == 0 || other.numElems == 0)
+		return false;
+
+	if (dense && other.dense)
+	{
+		unsigned first = std::max(baseWord, other.baseWord);
+		unsigned last = std::min(baseWord + words.size(), other.baseWord + other.words.size());
+		if (first >= last)
+			return false;
+		return getKernels().intersects(words.data() + (first - baseWord), other.words.data() + (first - other.baseWord), last - first);
+	}
+	if (dense)
+		return std::any_of(other.elems.begin(), other.elems.end(), [this](unsigned idx) { return test(idx); });
+	if (other.dense)
+		return other.intersects(*this);
+
+	auto itr = elems.begin(), ite = elems.end();
+	auto otherItr = other.elems.begin(), otherIte = other.elems.end();
+	while (itr != ite && otherItr != otherIte)
+	{
+		if (*itr < *otherItr)
+			++itr;
+		else if (*otherItr < *itr)
+			++otherItr;
+		else
+			return true;
+	}
+	return false;
+}
+
+bool AndersBitSet::operator==(const AndersBitSet& other) const
+{
+	// The representation is canonical
+	if (numElems != other.numElems || dense != other.dense)
+		return false;
+	if (!dense)
+		return elems == other.elems;
+	return baseWord == other.baseWord && words.size() == other.words.size() && getKernels().equals(words.data(), other.words.data(), words.size());
+}
+
+size_t AndersBitSet::hash() const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	if (!dense)
+	{
+		for (auto idx: elems)
+			hash = (hash ^ idx) * 0x100000001b3ull;
+	}
+	else
+	{
+		hash = (hash ^ baseWord) * 0x100000001b3ull;
+		for (auto word: words)
+			hash = (hash ^ word) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+AndersBitSet AndersBitSet::withElement(unsigned idx) const
+{
+	AndersBitSet ret(*this);
+	if (test(idx))
+		return ret;
+
+	++ret.numElems;
+	if (!dense)
+		ret.elems.insert(std::upper_bound(ret.elems.begin(), ret.elems.end(), idx), idx);
+	else
+	{
+		unsigned word = idx / 64;
+		ret.extendWords(std::min(word, baseWord), std::max<unsigned>(word, baseWord + words.size() - 1));
+		ret.words[word - ret.baseWord] |= uint64_t(1) << (idx % 64);
+	}
+	ret.normalize();
+	return ret;
+}
+
+AndersBitSet AndersBitSet::getUnion(const AndersBitSet& lhs, const AndersBitSet& rhs)
+{
+	if (rhs.empty())
+		return lhs;
+	if (lhs.empty())
+		return rhs;
+	if (!lhs.dense && !rhs.dense)
+	{
+		std::vector<unsigned> unionElems;
+		unionElems.reserve(lhs.numElems + rhs.numElems);
+		std::set_union(lhs.elems.begin(), lhs.elems.end(), rhs.elems.begin(), rhs.elems.end(), std::back_inserter(unionElems));
+		return AndersBitSet(std::move(unionElems));
+	}
+
+	// At least one of them is dense. Start from it and extend it to the range of the other one
+	const AndersBitSet& denseSet = lhs.dense ? lhs : rhs;
+	const AndersBitSet& otherSet = lhs.dense ? rhs : lhs;
+	AndersBitSet ret(denseSet);
+	unsigned otherFirst = *otherSet.begin() / 64;
+	unsigned otherLast = otherSet.dense ? otherSet.baseWord + otherSet.words.size() - 1 : otherSet.elems.back() / 64;
+	ret.extendWords(std::min(otherFirst, ret.baseWord), std::max<unsigned>(otherLast, ret.baseWord + ret.words.size() - 1));
+
+	if (otherSet.dense)
+	{
+		uint64_t* out = ret.words.data() + (otherSet.baseWord - ret.baseWord);
+		const WordKernels& kernels = getKernels();
+		kernels.orWords(out, out, otherSet.words.data(), otherSet.words.size());
+		ret.numElems = kernels.countBits(ret.words.data(), ret.words.size());
+	}
+	else
+	{
+		for (auto idx: otherSet.elems)
+		{
+			uint64_t& word = ret.words[idx / 64 - ret.baseWord];
+			uint64_t bit = uint64_t(1) << (idx % 64);
+			if ((word & bit) == 0)
+			{
+				word |= bit;
+				++ret.numElems;
+			}
+		}
+	}
+	ret.normalize();
+	return ret;
+}
+
+AndersBitSet AndersBitSet::getDifference(const AndersBitSet& lhs, const AndersBitSet& rhs)
+{
+	if (!lhs.dense)
+	{
+		std::vector<unsigned> diffElems;
+		diffElems.reserve(lhs.numElems);
+		if (!rhs.dense)
+			std::set_difference(lhs.elems.begin(), lhs.elems.end(), rhs.elems.begin(), rhs.elems.end(), std::back_inserter(diffElems));
+		else
+			std::copy_if(lhs.elems.begin(), lhs.elems.end(), std::back_inserter(diffElems), [&rhs](unsigned idx) { return !rhs.test(idx); });
+		return AndersBitSet(std::move(diffElems));
+	}
+
+	AndersBitSet ret(lhs);
+	if (rhs.dense)
+	{
+		unsigned first = std::max(lhs.baseWord, rhs.baseWord);
+		unsigned last = std::min(lhs.baseWord + lhs.words.size(), rhs.baseWord + rhs.words.size());
+		if (first >= last)
+			return ret;
+		uint64_t* out = ret.words.data() + (first - ret.baseWord);
+		const WordKernels& kernels = getKernels();
+		kernels.andNotWords(out, out, rhs.words.data() + (first - rhs.baseWord), last - first);
+		ret.numElems = kernels.countBits(ret.words.data(), ret.words.size());
+	}
+	else
+	{
+		for (auto idx: rhs.elems)
+		{
+			unsigned word = idx / 64;
+			if (word < ret.baseWord || word - ret.baseWord >= ret.words.size())
+				continue;
+			uint64_t bit = uint64_t(1) << (idx % 64);
+			if ((ret.words[word - ret.baseWord] & bit) != 0)
+			{
+				ret.words[word - ret.baseWord] &= ~bit;
+				--ret.numElems;
+			}
+		}
+	}
+	ret.normalize();
+	return ret;
+}
+
+const char* AndersBitSet::getKernelName()
+{
+	return getKernels().name;
+}
@@ -0,0 +1,123 @@
+#ifndef ANDERSEN_BITSET_H
+#define ANDERSEN_BITSET_H
+
+#include "llvm/ADT/SparseBitVector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// The immutable set of node indices behind an AndersPtsSet
+// Small or scattered sets are kept as a sorted vector of their elements. Once a set is both larger than MaxSparseSize and dense enough for a word array over the range it spans to be no larger than the vector (two elements per 64-bit word), it switches to a word array over that range, and the operations between two dense sets run word-parallel kernels (AVX2 or SSE2 when the CPU has them, plain loops otherwise; see BitSet.cpp)
+// The representation only depends on the elements, so that two equal sets always compare and hash the same way
+class AndersBitSet
+{
+public:
+	static const unsigned MaxSparseSize = 16;
+private:
+	// Sparse representation: the elements, sorted
+	std::vector<unsigned> elems;
+	// Dense representation: words[i] holds the elements from (baseWord + i) * 64 on. The first and the last word are never zero
+	std::vector<uint64_t> words;
+	unsigned baseWord;
+	unsigned numElems;
+	bool dense;
+
+	// Switch to the representation that the elements call for. numElems must be up to date
+	void normalize();
+	void makeDense();
+	void makeSparse();
+	// Make the word array cover the words [first, last]
+	void extendWords(unsigned first, unsigned last);
+public:
+	class iterator
+	{
+	private:
+		const AndersBitSet* set;
+		// The index of the current element in elems, or of the current word in words
+		size_t pos;
+		// The bits of the current word that are still to be visited
+		uint64_t bits;
+
+		void skipEmptyWords()
+		{
+			while (bits == 0 && ++pos < set->words.size())
+				bits = set->words[pos];
+		}
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef unsigned value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const unsigned* pointer;
+		typedef unsigned reference;
+
+		iterator(const AndersBitSet* s, size_t p): set(s), pos(p), bits(0)
+		{
+			if (set->dense && pos < set->words.size())
+				bits = set->words[pos];
+		}
+
+		unsigned operator*() const
+		{
+			if (!set->dense)
+				return set->elems[pos];
+			return (set->baseWord + pos) * 64 + __builtin_ctzll(bits);
+		}
+		iterator& operator++()
+		{
+			if (!set->dense)
+				++pos;
+			else
+			{
+				bits &= bits - 1;
+				skipEmptyWords();
+			}
+			return *this;
+		}
+		iterator operator++(int)
+		{
+			iterator ret = *this;
+			++*this;
+			return ret;
+		}
+		bool operator==(const iterator& other) const { return pos == other.pos && bits == other.bits; }
+		bool operator!=(const iterator& other) const { return !(*this == other); }
+	};
+
+	AndersBitSet(): baseWord(0), numElems(0), dense(false) {}
+	explicit AndersBitSet(const llvm::SparseBitVector<>& bv);
+	// Build the set from sorted elements without duplicates
+	explicit AndersBitSet(std::vector<unsigned>&& sortedElems);
+
+	bool empty() const { return numElems == 0; }
+	unsigned count() const { return numElems; }
+	bool isDense() const { return dense; }
+
+	bool test(unsigned idx) const;
+	// Return true if *this is a superset of other
+	bool contains(const AndersBitSet& other) const;
+	bool intersects(const AndersBitSet& other) const;
+	bool operator==(const AndersBitSet& other) const;
+	size_t hash() const;
+
+	// Give back the spare capacity of the storage. Worth doing once for the sets that are kept
+	void shrinkToFit()
+	{
+		elems.shrink_to_fit();
+		words.shrink_to_fit();
+	}
+
+	AndersBitSet withElement(unsigned idx) const;
+	static AndersBitSet getUnion(const AndersBitSet& lhs, const AndersBitSet& rhs);
+	// The elements of lhs that are not in rhs
+	static AndersBitSet getDifference(const AndersBitSet& lhs, const AndersBitSet& rhs);
+
+	// The instruction set the kernels run on: "avx2", "sse2" or "scalar"
+	static const char* getKernelName();
+
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, dense ? words.size() : elems.size()); }
+};
+
+#endif
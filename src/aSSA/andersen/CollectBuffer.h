@@ -0,0 +1,56 @@
+#ifndef ANDERSEN_COLLECT_BUFFER_H
+#define ANDERSEN_COLLECT_BUFFER_H
+
+#include "Constraint.h"
+#include "NodeFactory.h"
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// What collecting the constraints of one function yields, kept apart from the other functions so that several functions can be collected at once (-anders-collect-threads, see ConstraintCollect.cpp)
+// The function reads the node factory but never writes to it: the object and temporary nodes it needs get provisional indices past the last node of the factory, from a counter that all the buffers of a collection share. Andersen::mergeCollectBuffer() creates the real nodes afterwards, in the order of the functions and of the creations within each function, and renumbers the constraints. So the result doesn't depend on how the functions were spread over the threads
+class AndersCollectBuffer
+{
+public:
+	// A node to create, with the provisional index of its first field
+	struct PendingNode
+	{
+		NodeIndex index;
+		const llvm::Value* value;
+		unsigned numFields;
+		bool isObject;
+	};
+private:
+	const AndersNodeFactory& nodeFactory;
+	std::atomic<NodeIndex>& nextIndex;
+	std::vector<PendingNode> nodes;
+
+	NodeIndex reserveNode(const llvm::Value* val, unsigned numFields, bool isObject)
+	{
+		NodeIndex idx = nextIndex.fetch_add(numFields, std::memory_order_relaxed);
+		nodes.push_back(PendingNode{idx, val, numFields, isObject});
+		return idx;
+	}
+public:
+	std::vector<AndersConstraint> constraints;
+	std::vector<AndersIndirectCall> indirectCalls;
+	// The external functions without model that the function calls, with the number of pointers each call makes point to anything
+	std::vector<std::pair<const llvm::Function*, unsigned>> unmodeledCalls;
+
+	AndersCollectBuffer(const AndersNodeFactory& f, std::atomic<NodeIndex>& n): nodeFactory(f), nextIndex(n) {}
+
+	// Same as the node factory methods, with provisional indices
+	NodeIndex createValueNode(const llvm::Value* val = nullptr)
+	{
+		return reserveNode(val, 1, false);
+	}
+	NodeIndex createObjectNode(const llvm::Value* val = nullptr, llvm::Type* ty = nullptr)
+	{
+		return reserveNode(val, nodeFactory.getNumObjectFields(ty), true);
+	}
+
+	const std::vector<PendingNode>& getNodes() const { return nodes; }
+};
+
+#endif
@@ -4,8 +4,9 @@
 #include "NodeFactory.h"
 
 #include <cassert>
+#include <vector>
 
-/// AndersConstraint - Objects of this structure are used to represent the various constraints identified by the algorithm.  The constraints are 'copy', for statements like "A = B", 'load' for statements like "A = *B", 'store' for statements like "*A = B", and AddressOf for statements like A = alloca;  The Offset is applied as *(A + K) = B for stores, A = *(B + K) for loads, and A = B + K for copies.  It is illegal on addressof constraints (because it is statically resolvable to A = &C where C = B + K)
+/// AndersConstraint - Objects of this structure are used to represent the various constraints identified by the algorithm.  The constraints are 'copy', for statements like "A = B", 'load' for statements like "A = *B", 'store' for statements like "*A = B", AddressOf for statements like A = alloca, and 'gep' for field accesses like "A = &B->f".  The Offset is only meaningful for gep constraints, where it is applied as A = B + K: A points to field K (relative to the pointee) of every object B points to.  Gep constraints are only generated in field-sensitive mode
 class AndersConstraint {
 public:
 	enum ConstraintType 
@@ -14,21 +15,24 @@ public:
 		COPY,
 		LOAD,
 		STORE,
+		GEP,
 	};
 private:
 	ConstraintType type;
 	NodeIndex dest;
 	NodeIndex src;
+	unsigned offset;
 public:
-	AndersConstraint(ConstraintType Ty, NodeIndex D, NodeIndex S): type(Ty), dest(D), src(S) {}
+	AndersConstraint(ConstraintType Ty, NodeIndex D, NodeIndex S, unsigned O = 0): type(Ty), dest(D), src(S), offset(O) {}
 
 	ConstraintType getType() const { return type; }
 	NodeIndex getDest() const { return dest; }
 	NodeIndex getSrc() const { return src; }
+	unsigned getOffset() const { return offset; }
 
 	bool operator==(const AndersConstraint &RHS) const
 	{
-		return RHS.type == type && RHS.dest == dest && RHS.src == src;
+		return RHS.type == type && RHS.dest == dest && RHS.src == src && RHS.offset == offset;
 	}
 
 	bool operator!=(const AndersConstraint &RHS) const
@@ -42,8 +46,34 @@ public:
 			return RHS.type < type;
 		else if (RHS.dest != dest)
 			return RHS.dest < dest;
-		return RHS.src < src;
+		else if (RHS.src != src)
+			return RHS.src < src;
+		return RHS.offset < offset;
 	}
 };
 
+/// AndersIndirectCall - An indirect call whose targets are resolved by the solver as the pts-to set of its function pointer grows. Every new target gets the copy constraints of a direct call to it: formal = actual for each argument, and ret = the return node of the target
+struct AndersIndirectCall
+{
+	// The called pointer
+	NodeIndex funPtr;
+	// The value node of the call, or InvalidIndex if it doesn't return a pointer
+	NodeIndex ret;
+	// The actual arguments, with InvalidIndex for those that are not pointers
+	std::vector<NodeIndex> args;
+};
+
+/// AndersCallTarget - A function that indirect calls may go to, described by its nodes only, so that the solver does not need the IR
+struct AndersCallTarget
+{
+	// The object node the address of the function points to
+	NodeIndex obj;
+	// The formal arguments, with InvalidIndex for those that are not pointers
+	std::vector<NodeIndex> formals;
+	// The vararg node, or InvalidIndex if the function is not variadic
+	NodeIndex vararg;
+	// The return node, or InvalidIndex if the function doesn't return a pointer
+	NodeIndex ret;
+};
+
 #endif
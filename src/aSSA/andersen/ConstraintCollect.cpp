@@ -6,18 +6,41 @@
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/PatternMatch.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <atomic>
+#include <thread>
 
 #define DEBUG_TYPE "hello"
 
 using namespace llvm;
 
+cl::opt<bool> FieldSensitive("anders-field-sensitive", cl::desc("Distinguish the fields of structs in the Andersen analysis"), cl::init(false));
+cl::opt<unsigned> MaxFields("anders-max-fields", cl::desc("Maximum number of fields distinguished per object in field-sensitive mode. The remaining fields are merged into the last one"), cl::init(32));
+cl::opt<bool> ReachableOnly("anders-reachable-only", cl::desc("Only collect the constraints of the functions reachable from main, following the indirect calls as the solution resolves them. Every function is collected if the module has no main"), cl::init(false));
+cl::opt<unsigned> CollectThreads("anders-collect-threads", cl::desc("Number of threads that collect the Andersen constraints of the functions. The constraints are the same whatever the number"), cl::init(1));
+cl::opt<bool> SummarizeGlobalInits("anders-summarize-globals", cl::desc("Add one constraint per distinct pointee of each field of a global initializer, and skip the parts of the initializers without pointers, instead of walking every element of the large constant tables"), cl::init(false));
+cl::opt<bool> OnTheFlyCalls("anders-otf-calls", cl::desc("Resolve the targets of indirect calls while solving, from the pts-to set of the called pointer. Otherwise, every address-taken function of the right arity is a target"), cl::init(false));
+
+extern cl::opt<bool> DemandDriven;
+extern cl::opt<bool> IncrementalSolve;
+
+STATISTIC(NumUnreachableFunctions, "Number of functions left out of the Andersen constraints as unreachable from main");
+STATISTIC(NumParallelCollections, "Number of times the Andersen constraints were collected on several threads");
+STATISTIC(NumGlobalInitConstraints, "Number of constraints added for the initializers of globals");
+STATISTIC(NumSummarizedInits, "Number of initializer constants whose constraints were already added, or that hold no pointer (-anders-summarize-globals)");
+STATISTIC(NumDiscoveryRounds, "Number of solves run to find the functions reachable through indirect calls");
+
 // CollectConstraints - This stage scans the program, adding a constraint to the Constraints list for each instruction in the program that induces a constraint, and setting up the initial points-to graph.
 
 void Andersen::collectConstraints(const Module& M)
 {
+	nodeFactory.setMaxFields(FieldSensitive ? MaxFields : 1);
+
 	// First, the universal ptr points to universal obj, and the universal obj points to itself
 	constraints.emplace_back(AndersConstraint::ADDR_OF,
 		nodeFactory.getUniversalPtrNode(), nodeFactory.getUniversalObjNode());
@@ -34,29 +57,204 @@ void Andersen::collectConstraints(const Module& M)
 	// Here is a notable points before we proceed:
 	// For functions with non-local linkage type, theoretically we should not trust anything that get passed to it or get returned by it. However, precision will be seriously hurt if we do that because if we do not run a -internalize pass before the -anders pass, almost every function is marked external. We'll just assume that even external linkage will not ruin the analysis result first
 
+	// With -anders-reachable-only, the later phases only look at the functions reachable from main, so there is no point in the constraints of the others. The set grows from main along the direct calls, then along the indirect calls as the solution of what has been collected resolves them, until no call reaches a new function
+	// The demand-driven solver wires the indirect calls statically, so the reachable functions are known without solving anything: it always leaves the others out
+	const Function* entry = M.getFunction("main");
+	reachableOnly = (ReachableOnly || DemandDriven) && entry != nullptr && !entry->isDeclaration();
+	if (reachableOnly)
+	{
+		addReachableFunction(entry);
+		do
+		{
+			// One function at a time: its calls queue more functions, which only the calling thread may do
+			while (!pendingFunctions.empty())
+			{
+				const Function* f = pendingFunctions.back();
+				pendingFunctions.pop_back();
+				collectConstraintsForFunctions(std::vector<const Function*>(1, f));
+			}
+		} while (discoverIndirectCallTargets());
+
+		for (auto const& f: M)
+		{
+			if (!f.isDeclaration() && !f.isIntrinsic() && !reachableFunctions.count(&f))
+				++NumUnreachableFunctions;
+		}
+		return;
+	}
+
+	std::vector<const Function*> functions;
 	for (auto const& f: M)
 	{
 		if (f.isDeclaration() || f.isIntrinsic())
 			continue;
+		functions.push_back(&f);
+	}
+	collectConstraintsForFunctions(functions);
+}
 
-		// Scan the function body
-		// A visitor pattern might help modularity, but it needs more boilerplate codes to set up, and it breaks down the main logic into pieces 
-
-		// First, create a value node for each instruction with pointer type. It is necessary to do the job here rather than on-the-fly because an instruction may refer to the value node definied before it (e.g. phi nodes)
-		for (const_inst_iterator itr = inst_begin(f), ite = inst_end(f); itr != ite; ++itr)
+void Andersen::collectConstraintsForFunctions(const std::vector<const Function*>& functions)
+{
+	// First, create a value node for each instruction with pointer type. It is necessary to do the job here rather than on-the-fly because an instruction may refer to the value node definied before it (e.g. phi nodes)
+	for (auto f: functions)
+	{
+		for (const_inst_iterator itr = inst_begin(*f), ite = inst_end(*f); itr != ite; ++itr)
 		{
 			auto inst = &*itr.getInstructionIterator();
 			if (inst->getType()->isPointerTy())
 				nodeFactory.createValueNode(inst);
 		}
+	}
+	// The constant geps may be shared by several functions, so their nodes are created up front as well
+	if (nodeFactory.isFieldSensitive())
+	{
+		for (auto f: functions)
+		{
+			for (const_inst_iterator itr = inst_begin(*f), ite = inst_end(*f); itr != ite; ++itr)
+				collectConstraintsForConstantGEPs(&*itr);
+		}
+	}
+
+	// Now, collect constraint for each relevant instruction. From here on, the functions only read the node factory, and each of them has its own buffer, so that they can be collected on several threads
+	NodeIndex firstIndex = nodeFactory.getNumNodes();
+	std::atomic<NodeIndex> nextIndex(firstIndex);
+	std::vector<AndersCollectBuffer> buffers;
+	buffers.reserve(functions.size());
+	for (unsigned i = 0, e = functions.size(); i < e; ++i)
+		buffers.emplace_back(nodeFactory, nextIndex);
 
-		// Now, collect constraint for each relevant instruction
-		for (const_inst_iterator itr = inst_begin(f), ite = inst_end(f); itr != ite; ++itr)
+	unsigned numThreads = std::max(1u, std::min<unsigned>(CollectThreads, functions.size()));
+	if (numThreads == 1)
+	{
+		for (unsigned i = 0, e = functions.size(); i < e; ++i)
+			collectConstraintsForFunction(*functions[i], buffers[i]);
+	}
+	else
+	{
+		++NumParallelCollections;
+		// The sizes of the functions vary a lot, so the threads take the next function as they are done with the previous one
+		std::atomic<unsigned> nextFunction(0);
+		auto collectFunctions = [&]()
 		{
-			auto inst = &*itr.getInstructionIterator();
-			collectConstraintsForInstruction(inst);
+			for (unsigned i = nextFunction++; i < functions.size(); i = nextFunction++)
+				collectConstraintsForFunction(*functions[i], buffers[i]);
+		};
+
+		nodeFactory.freezeNumFields(true);
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < numThreads; ++t)
+			workers.emplace_back(collectFunctions);
+		collectFunctions();
+		for (auto& worker: workers)
+			worker.join();
+		nodeFactory.freezeNumFields(false);
+	}
+
+	// The merge goes in the order of the functions, which makes the node indices and the constraints the same whatever the number of threads
+	std::vector<NodeIndex> provisionalMap(nextIndex - firstIndex, AndersNodeFactory::InvalidIndex);
+	for (auto& buf: buffers)
+		mergeCollectBuffer(buf, firstIndex, provisionalMap);
+}
+
+void Andersen::collectConstraintsForFunction(const Function& f, AndersCollectBuffer& buf)
+{
+	// Scan the function body
+	// A visitor pattern might help modularity, but it needs more boilerplate codes to set up, and it breaks down the main logic into pieces 
+	for (const_inst_iterator itr = inst_begin(f), ite = inst_end(f); itr != ite; ++itr)
+	{
+		auto inst = &*itr.getInstructionIterator();
+		collectConstraintsForInstruction(inst, buf);
+	}
+}
+
+void Andersen::mergeCollectBuffer(AndersCollectBuffer& buf, NodeIndex firstIndex, std::vector<NodeIndex>& provisionalMap)
+{
+	for (auto const& node: buf.getNodes())
+	{
+		NodeIndex idx = node.isObject ? nodeFactory.createObjectNodeWithFields(node.numFields, node.value) : nodeFactory.createValueNode(node.value);
+		for (unsigned i = 0; i < node.numFields; ++i)
+			provisionalMap[node.index - firstIndex + i] = idx + i;
+	}
+
+	// A buffer only refers to the nodes that existed before the collection, and to its own provisional nodes
+	auto renumber = [firstIndex, &provisionalMap](NodeIndex n)
+	{
+		return n != AndersNodeFactory::InvalidIndex && n >= firstIndex ? provisionalMap[n - firstIndex] : n;
+	};
+	constraints.reserve(constraints.size() + buf.constraints.size());
+	for (auto const& c: buf.constraints)
+		constraints.emplace_back(c.getType(), renumber(c.getDest()), renumber(c.getSrc()), c.getOffset());
+	for (auto& call: buf.indirectCalls)
+	{
+		call.funPtr = renumber(call.funPtr);
+		call.ret = renumber(call.ret);
+		for (auto& arg: call.args)
+			arg = renumber(arg);
+		indirectCalls.push_back(std::move(call));
+	}
+	for (auto const& call: buf.unmodeledCalls)
+		recordUnmodeledCall(call.first, call.second);
+
+	// The merged buffers would otherwise double the memory the constraints take until the end of the collection
+	std::vector<AndersConstraint>().swap(buf.constraints);
+	std::vector<AndersIndirectCall>().swap(buf.indirectCalls);
+}
+
+bool Andersen::addReachableFunction(const Function* f)
+{
+	if (!reachableOnly || f->isDeclaration() || f->isIntrinsic())
+		return false;
+	if (!reachableFunctions.insert(f).second)
+		return false;
+	pendingFunctions.push_back(f);
+	return true;
+}
+
+bool Andersen::discoverIndirectCallTargets()
+{
+	// Without on-the-fly calls, addConstraintForCall() has already queued every function an indirect call may go to
+	if (indirectCalls.empty())
+		return false;
+
+	// The solver merges nodes and consumes the constraints, while more constraints may come and HVN/HU must run before any merge. So it runs on a copy of the constraints, and its merges are undone afterwards
+	std::vector<AndersConstraint> savedConstraints(constraints);
+	// The solution of the last round satisfies all the constraints collected before it: only the ones collected since have something to propagate
+	if (!seedPtsGraph.empty())
+		newConstraints.assign(constraints.begin() + numDiscoveredConstraints, constraints.end());
+	numDiscoveredConstraints = constraints.size();
+	solveConstraints();
+	++NumDiscoveryRounds;
+
+	bool found = false;
+	for (auto const& call: indirectCalls)
+	{
+		for (auto v: ptsGraph[nodeFactory.getMergeTarget(call.funPtr)])
+		{
+			// This mirrors IndirectCallResolver::resolve(): the call may go to any addr-taken function that can take as many arguments
+			if (v == nodeFactory.getUniversalObjNode())
+			{
+				for (auto const& target: indirectCallTargets)
+				{
+					if (target.vararg != AndersNodeFactory::InvalidIndex || target.formals.size() == call.args.size())
+						found |= addReachableFunction(cast<Function>(nodeFactory.getValueForNode(target.obj)));
+				}
+				continue;
+			}
+
+			const Function* f = dyn_cast_or_null<Function>(nodeFactory.getValueForNode(v));
+			if (f != nullptr && (f->isVarArg() || f->arg_size() == call.args.size()))
+				found |= addReachableFunction(f);
 		}
 	}
+
+	// The solution of the constraints collected so far is a lower bound of the final one: the next solve starts from it
+	seedPtsGraph.resize(ptsGraph.size());
+	for (NodeIndex node = 0, e = ptsGraph.size(); node < e; ++node)
+		seedPtsGraph[node] = ptsGraph[nodeFactory.getMergeTarget(node)];
+	ptsGraph.clear();
+	nodeFactory.clearMerges();
+	constraints.swap(savedConstraints);
+	return found;
 }
 
 void Andersen::collectConstraintsForGlobals(const Module& M)
@@ -65,7 +263,7 @@ void Andersen::collectConstraintsForGlobals(const Module& M)
 	for (auto const& globalVal: M.globals())
 	{
 		NodeIndex gVal = nodeFactory.createValueNode(&globalVal);
-		NodeIndex gObj = nodeFactory.createObjectNode(&globalVal);
+		NodeIndex gObj = nodeFactory.createObjectNode(&globalVal, globalVal.getValueType());
 		constraints.emplace_back(AndersConstraint::ADDR_OF, gVal, gObj);
 	}
 
@@ -99,9 +297,21 @@ void Andersen::collectConstraintsForGlobals(const Module& M)
 			if (isa<PointerType>(itr->getType()))
 				nodeFactory.createValueNode(&*itr);
 		}
+
+		if (f.hasAddressTaken())
+		{
+			AndersCallTarget target;
+			target.obj = nodeFactory.getObjectNodeFor(&f);
+			for (Function::const_arg_iterator itr = f.arg_begin(), ite = f.arg_end(); itr != ite; ++itr)
+				target.formals.push_back(nodeFactory.getValueNodeFor(&*itr));
+			target.vararg = nodeFactory.getVarargNodeFor(&f);
+			target.ret = nodeFactory.getReturnNodeFor(&f);
+			indirectCallTargets.push_back(std::move(target));
+		}
 	}
 
 	// Init globals here since an initializer may refer to a global var/func below it
+	unsigned numConstraintsBefore = constraints.size();
 	for (auto const& globalVal: M.globals())
 	{
 		NodeIndex gObj = nodeFactory.getObjectNodeFor(&globalVal);
@@ -114,39 +324,92 @@ void Andersen::collectConstraintsForGlobals(const Module& M)
 		else
 		{
 			// If it doesn't have an initializer (i.e. it's defined in another translation unit), it points to the universal set.
-			constraints.emplace_back(AndersConstraint::COPY,
-				gObj, nodeFactory.getUniversalObjNode());
+			for (unsigned i = 0, e = nodeFactory.getObjectSize(gObj); i < e; ++i)
+				constraints.emplace_back(AndersConstraint::COPY,
+					gObj + i, nodeFactory.getUniversalObjNode());
 		}
 	}
+	NumGlobalInitConstraints += constraints.size() - numConstraintsBefore;
+
+	summarizedInits.clear();
+	summarizedPointees.clear();
+	pointerTypes.clear();
+}
+
+// Return true if a value of type ty holds a pointer
+bool Andersen::containsPointer(Type* ty)
+{
+	auto itr = pointerTypes.find(ty);
+	if (itr != pointerTypes.end())
+		return itr->second;
+
+	bool ret = ty->isPointerTy();
+	if (StructType* st = dyn_cast<StructType>(ty))
+	{
+		for (unsigned i = 0, e = st->getNumElements(); i != e && !ret; ++i)
+			ret = containsPointer(st->getElementType(i));
+	}
+	else if (ArrayType* at = dyn_cast<ArrayType>(ty))
+		ret = containsPointer(at->getElementType());
+	else if (VectorType* vt = dyn_cast<VectorType>(ty))
+		ret = containsPointer(vt->getElementType());
+
+	pointerTypes[ty] = ret;
+	return ret;
 }
 
 void Andersen::addGlobalInitializerConstraints(NodeIndex objNode, const Constant* c)
 {
 	//errs() << "Called with node# = " << objNode << ", initializer = " << *c << "\n";
+	// The elements of an array share their fields, so a large table adds the same constraints over and over. When summarizing, an aggregate adds nothing if it has no pointer or if the same constant has already been added at the same field, and a pointer adds nothing if its pointee has already been added at that field
+	if (SummarizeGlobalInits && !c->getType()->isSingleValueType())
+	{
+		if (!containsPointer(c->getType()) || !summarizedInits.insert(std::make_pair(objNode, c)).second)
+		{
+			++NumSummarizedInits;
+			return;
+		}
+	}
+
 	if (c->getType()->isSingleValueType())
 	{
 		if (isa<PointerType>(c->getType()))
 		{
 			NodeIndex rhsNode = nodeFactory.getObjectNodeForConstant(c);
 			assert(rhsNode != AndersNodeFactory::InvalidIndex && "rhs node not found");
-			constraints.emplace_back(AndersConstraint::ADDR_OF, objNode, rhsNode);
+			if (SummarizeGlobalInits && !summarizedPointees.insert(std::make_pair(objNode, rhsNode)).second)
+				++NumSummarizedInits;
+			else
+				constraints.emplace_back(AndersConstraint::ADDR_OF, objNode, rhsNode);
 		}
 	}
 	else if (c->isNullValue())
 	{
-		constraints.emplace_back(AndersConstraint::COPY, objNode, nodeFactory.getNullObjectNode());
+		for (unsigned i = 0, e = nodeFactory.getNumFields(c->getType()); i < e; ++i)
+		{
+			NodeIndex fieldNode = nodeFactory.getFieldNode(objNode, i);
+			constraints.emplace_back(AndersConstraint::COPY, fieldNode, nodeFactory.getNullObjectNode());
+			if (fieldNode != objNode + i)
+				break;
+		}
 	}
 	else if (!isa<UndefValue>(c))
 	{
-		// Since we are doing field-insensitive analysis, all objects in the array/struct are pointed-to by the 1st-field pointer
+		// In field-insensitive mode, all objects in the array/struct are pointed-to by the 1st-field pointer. Otherwise each struct element goes to its own field, and array elements share the same field
 		assert(isa<ConstantArray>(c) || isa<ConstantDataSequential>(c) || isa<ConstantStruct>(c));
 
+		StructType* st = dyn_cast<StructType>(c->getType());
+		unsigned offset = 0;
 		for (unsigned i = 0, e = c->getNumOperands(); i != e; ++i)
-			addGlobalInitializerConstraints(objNode, cast<Constant>(c->getOperand(i)));
+		{
+			addGlobalInitializerConstraints(nodeFactory.getFieldNode(objNode, offset), cast<Constant>(c->getOperand(i)));
+			if (st != nullptr && nodeFactory.isFieldSensitive())
+				offset += nodeFactory.getNumFields(st->getElementType(i));
+		}
 	}
 }
 
-void Andersen::collectConstraintsForInstruction(const Instruction* inst)
+void Andersen::collectConstraintsForInstruction(const Instruction* inst, AndersCollectBuffer& buf)
 {
 	switch (inst->getOpcode())
 	{
@@ -154,8 +417,8 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 		{
 			NodeIndex valNode = nodeFactory.getValueNodeFor(inst);
 			assert(valNode != AndersNodeFactory::InvalidIndex && "Failed to find alloca value node");
-			NodeIndex objNode = nodeFactory.createObjectNode(inst);
-			constraints.emplace_back(AndersConstraint::ADDR_OF, valNode, objNode);
+			NodeIndex objNode = buf.createObjectNode(inst, cast<AllocaInst>(inst)->getAllocatedType());
+			buf.constraints.emplace_back(AndersConstraint::ADDR_OF, valNode, objNode);
 			break;
 		}
 		case Instruction::Call:
@@ -164,7 +427,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 			ImmutableCallSite cs(inst);
 			assert(cs && "Something wrong with callsite?");
 
-			addConstraintForCall(cs);
+			addConstraintForCall(cs, buf);
 
 			break;
 		}
@@ -176,7 +439,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 				assert(retIndex != AndersNodeFactory::InvalidIndex && "Failed to find return node");
 				NodeIndex valIndex = nodeFactory.getValueNodeFor(inst->getOperand(0));
 				assert(valIndex != AndersNodeFactory::InvalidIndex && "Failed to find return value node");
-				constraints.emplace_back(AndersConstraint::COPY, retIndex, valIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, valIndex);
 			}
 			break;
 		}
@@ -188,7 +451,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 				assert(opIndex != AndersNodeFactory::InvalidIndex && "Failed to find load operand node");
 				NodeIndex valIndex = nodeFactory.getValueNodeFor(inst);
 				assert(valIndex != AndersNodeFactory::InvalidIndex && "Failed to find load value node");
-				constraints.emplace_back(AndersConstraint::LOAD, valIndex, opIndex);
+				buf.constraints.emplace_back(AndersConstraint::LOAD, valIndex, opIndex);
 			}
 			break;
 		}
@@ -200,7 +463,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 				assert(srcIndex != AndersNodeFactory::InvalidIndex && "Failed to find store src node");
 				NodeIndex dstIndex = nodeFactory.getValueNodeFor(inst->getOperand(1));
 				assert(dstIndex != AndersNodeFactory::InvalidIndex && "Failed to find store dst node");
-				constraints.emplace_back(AndersConstraint::STORE, dstIndex, srcIndex);
+				buf.constraints.emplace_back(AndersConstraint::STORE, dstIndex, srcIndex);
 			}
 			break;
 		}
@@ -208,13 +471,17 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 		{
 			assert(inst->getType()->isPointerTy());
 
-			// P1 = getelementptr P2, ... --> <Copy/P1/P2>
+			// P1 = getelementptr P2, ... --> <Copy/P1/P2>, or <Gep/P1/P2/offset> in field-sensitive mode
 			NodeIndex srcIndex = nodeFactory.getValueNodeFor(inst->getOperand(0));
 			assert(srcIndex != AndersNodeFactory::InvalidIndex && "Failed to find gep src node");
 			NodeIndex dstIndex = nodeFactory.getValueNodeFor(inst);
 			assert(dstIndex != AndersNodeFactory::InvalidIndex && "Failed to find gep dst node");
 
-			constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
+			unsigned offset = nodeFactory.getGEPOffset(cast<GEPOperator>(inst));
+			if (offset == 0)
+				buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
+			else
+				buf.constraints.emplace_back(AndersConstraint::GEP, dstIndex, srcIndex, offset);
 
 			break;
 		}
@@ -229,7 +496,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 				{
 					NodeIndex srcIndex = nodeFactory.getValueNodeFor(phiInst->getIncomingValue(i));
 					assert(srcIndex != AndersNodeFactory::InvalidIndex && "Failed to find phi src node");
-					constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
+					buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
 				}
 			}
 			break;
@@ -243,7 +510,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 				assert(srcIndex != AndersNodeFactory::InvalidIndex && "Failed to find bitcast src node");
 				NodeIndex dstIndex = nodeFactory.getValueNodeFor(inst);
 				assert(dstIndex != AndersNodeFactory::InvalidIndex && "Failed to find bitcast dst node");
-				constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
 			}
 			break;
 		}
@@ -264,7 +531,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 			{
 				NodeIndex srcIndex = nodeFactory.getValueNodeFor(srcValue);
 				assert(srcIndex != AndersNodeFactory::InvalidIndex && "Failed to find inttoptr src node");
-				constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
 				break;
 			}
 			
@@ -277,12 +544,12 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 			{
 				NodeIndex srcIndex = nodeFactory.getValueNodeFor(srcValue);
 				assert(srcIndex != AndersNodeFactory::InvalidIndex && "Failed to find inttoptr src node");
-				constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex);
 				break;
 			}
 			
 			// Otherwise, we really don't know what dst points to
-			constraints.emplace_back(AndersConstraint::COPY, dstIndex, nodeFactory.getUniversalPtrNode());
+			buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, nodeFactory.getUniversalPtrNode());
 
 			break;
 		}
@@ -296,8 +563,8 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 				assert(srcIndex2 != AndersNodeFactory::InvalidIndex && "Failed to find select src node 2");
 				NodeIndex dstIndex = nodeFactory.getValueNodeFor(inst);
 				assert(dstIndex != AndersNodeFactory::InvalidIndex && "Failed to find select dst node");
-				constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex1);
-				constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex2);
+				buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex1);
+				buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, srcIndex2);
 			}
 			break;
 		}
@@ -309,7 +576,7 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 				assert(dstIndex != AndersNodeFactory::InvalidIndex && "Failed to find va_arg dst node");
 				NodeIndex vaIndex = nodeFactory.getVarargNodeFor(inst->getParent()->getParent());
 				assert(vaIndex != AndersNodeFactory::InvalidIndex && "Failed to find vararg node");
-				constraints.emplace_back(AndersConstraint::COPY, dstIndex, vaIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, dstIndex, vaIndex);
 			}
 			break;
 		}
@@ -341,26 +608,53 @@ void Andersen::collectConstraintsForInstruction(const Instruction* inst)
 	}
 }
 
+// In field-sensitive mode, a constant gep on a global (e.g. a store to a field of a global struct) needs its own pointer node, since it doesn't point to the first field of the global
+void Andersen::collectConstraintsForConstantGEPs(const User* user)
+{
+	for (auto const& op: user->operands())
+	{
+		const ConstantExpr* ce = dyn_cast<ConstantExpr>(op);
+		if (ce == nullptr)
+			continue;
+
+		collectConstraintsForConstantGEPs(ce);
+		if (ce->getOpcode() != Instruction::GetElementPtr || nodeFactory.getValueNodeFor(ce) != nodeFactory.getValueNodeFor(ce->getOperand(0)))
+			continue;
+
+		unsigned offset = nodeFactory.getGEPOffset(cast<GEPOperator>(ce));
+		if (offset == 0 || offset == AndersNodeFactory::UnknownOffset)
+			continue;
+		NodeIndex objIndex = nodeFactory.getObjectNodeForConstant(ce);
+		if (objIndex == AndersNodeFactory::InvalidIndex)
+			continue;
+
+		NodeIndex valIndex = nodeFactory.createValueNode(ce);
+		constraints.emplace_back(AndersConstraint::ADDR_OF, valIndex, objIndex);
+	}
+}
+
 // There are two types of constraints to add for a function call:
 // - ValueNode(callsite) = ReturnNode(call target)
 // - ValueNode(formal arg) = ValueNode(actual arg)
-void Andersen::addConstraintForCall(ImmutableCallSite cs)
+void Andersen::addConstraintForCall(ImmutableCallSite cs, AndersCollectBuffer& buf)
 {
 	if (const Function* f = cs.getCalledFunction())	// Direct call
 	{
 		if (f->isDeclaration() || f->isIntrinsic())	// External library call
 		{
 			// Handle libraries separately
-			if (addConstraintForExternalLibrary(cs, f))
+			if (addConstraintForExternalLibrary(cs, f, buf))
 				return;
 			else	// Unresolved library call: ruin everything!
 			{
 				DEBUG(errs() << "Unresolved ext function: " << f->getName() << "\n");
+				unsigned numPolluted = 0;
 				if (cs.getType()->isPointerTy())
 				{
 					NodeIndex retIndex = nodeFactory.getValueNodeFor(cs.getInstruction());
 					assert(retIndex != AndersNodeFactory::InvalidIndex && "Failed to find ret node!");
-					constraints.emplace_back(AndersConstraint::COPY, retIndex, nodeFactory.getUniversalPtrNode());
+					buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, nodeFactory.getUniversalPtrNode());
+					++numPolluted;
 				}
 				for (ImmutableCallSite::arg_iterator itr = cs.arg_begin(), ite = cs.arg_end(); itr != ite; ++itr)
 				{
@@ -369,13 +663,17 @@ void Andersen::addConstraintForCall(ImmutableCallSite cs)
 					{
 						NodeIndex argIndex = nodeFactory.getValueNodeFor(argVal);
 						assert(argIndex != AndersNodeFactory::InvalidIndex && "Failed to find arg node!");
-						constraints.emplace_back(AndersConstraint::COPY, argIndex, nodeFactory.getUniversalPtrNode());
+						buf.constraints.emplace_back(AndersConstraint::COPY, argIndex, nodeFactory.getUniversalPtrNode());
+						++numPolluted;
 					}
 				}
+				if (numPolluted != 0)
+					buf.unmodeledCalls.push_back(std::make_pair(f, numPolluted));
 			}
 		}
 		else	// Non-external function call
 		{
+			addReachableFunction(f);
 			if (cs.getType()->isPointerTy())
 			{
 				NodeIndex retIndex = nodeFactory.getValueNodeFor(cs.getInstruction());
@@ -383,20 +681,47 @@ void Andersen::addConstraintForCall(ImmutableCallSite cs)
 				//errs() << f->getName() << "\n";
 				NodeIndex fRetIndex = nodeFactory.getReturnNodeFor(f);
 				assert(fRetIndex != AndersNodeFactory::InvalidIndex && "Failed to find function ret node!");
-				constraints.emplace_back(AndersConstraint::COPY, retIndex, fRetIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, fRetIndex);
 			}
 			// The argument constraints
-			addArgumentConstraintForCall(cs, f);
+			addArgumentConstraintForCall(cs, f, buf);
 		}
 	}
 	else	// Indirect call
 	{
+		// Let the solver pick the targets among the functions the called pointer may point to. The demand-driven and incremental solvers only know about plain constraints, though
+		NodeIndex calledIndex = nodeFactory.getValueNodeFor(cs.getCalledValue());
+		bool resolveOnTheFly = OnTheFlyCalls && !DemandDriven && !IncrementalSolve && calledIndex != AndersNodeFactory::InvalidIndex;
+		if (resolveOnTheFly)
+		{
+			AndersIndirectCall call;
+			call.funPtr = calledIndex;
+			call.ret = AndersNodeFactory::InvalidIndex;
+			if (cs.getType()->isPointerTy())
+			{
+				call.ret = nodeFactory.getValueNodeFor(cs.getInstruction());
+				assert(call.ret != AndersNodeFactory::InvalidIndex && "Failed to find ret node!");
+			}
+			for (ImmutableCallSite::arg_iterator itr = cs.arg_begin(), ite = cs.arg_end(); itr != ite; ++itr)
+			{
+				const Value* argVal = *itr;
+				if (argVal->getType()->isPointerTy())
+				{
+					NodeIndex argIndex = nodeFactory.getValueNodeFor(argVal);
+					assert(argIndex != AndersNodeFactory::InvalidIndex && "Failed to find arg node!");
+					call.args.push_back(argIndex);
+				}
+				else
+					call.args.push_back(AndersNodeFactory::InvalidIndex);
+			}
+			buf.indirectCalls.push_back(std::move(call));
+		}
 		// We do the simplest thing here: just assume the returned value can be anything :)
-		if (cs.getType()->isPointerTy())
+		else if (cs.getType()->isPointerTy())
 		{
 			NodeIndex retIndex = nodeFactory.getValueNodeFor(cs.getInstruction());
 			assert(retIndex != AndersNodeFactory::InvalidIndex && "Failed to find ret node!");
-			constraints.emplace_back(AndersConstraint::COPY, retIndex, nodeFactory.getUniversalPtrNode());
+			buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, nodeFactory.getUniversalPtrNode());
 		}
 
 		// For argument constraints, first search through all addr-taken functions: any function that takes can take as many variables is a potential candidate
@@ -414,11 +739,13 @@ void Andersen::addConstraintForCall(ImmutableCallSite cs)
 
 			if (f.isDeclaration() || f.isIntrinsic())	// External library call
 			{
-				if (addConstraintForExternalLibrary(cs, &f))
+				// The solver only resolves the functions we have the body of: modelling a library call may create nodes. So the library functions are still wired up front
+				if (addConstraintForExternalLibrary(cs, &f, buf))
 					continue;
 				else
 				{
 					// Pollute everything
+					unsigned numPolluted = 0;
 					for (ImmutableCallSite::arg_iterator itr = cs.arg_begin(), ite = cs.arg_end(); itr != ite; ++itr)
 					{
 						Value* argVal = *itr;
@@ -427,18 +754,24 @@ void Andersen::addConstraintForCall(ImmutableCallSite cs)
 						{
 							NodeIndex argIndex = nodeFactory.getValueNodeFor(argVal);
 							assert(argIndex != AndersNodeFactory::InvalidIndex && "Failed to find arg node!");
-							constraints.emplace_back(AndersConstraint::COPY, argIndex, nodeFactory.getUniversalPtrNode());
+							buf.constraints.emplace_back(AndersConstraint::COPY, argIndex, nodeFactory.getUniversalPtrNode());
+							++numPolluted;
 						}
 					}
+					if (numPolluted != 0)
+						buf.unmodeledCalls.push_back(std::make_pair(&f, numPolluted));
 				}
 			}
-			else
-				addArgumentConstraintForCall(cs, &f);
+			else if (!resolveOnTheFly)
+			{
+				addReachableFunction(&f);
+				addArgumentConstraintForCall(cs, &f, buf);
+			}
 		}
 	}
 }
 
-void Andersen::addArgumentConstraintForCall(ImmutableCallSite cs, const Function* f)
+void Andersen::addArgumentConstraintForCall(ImmutableCallSite cs, const Function* f, AndersCollectBuffer& buf)
 {
 	Function::const_arg_iterator fItr = f->arg_begin();
 	ImmutableCallSite::arg_iterator aItr = cs.arg_begin();
@@ -455,10 +788,10 @@ void Andersen::addArgumentConstraintForCall(ImmutableCallSite cs, const Function
 			{
 				NodeIndex aIndex = nodeFactory.getValueNodeFor(actual);
 				assert(aIndex != AndersNodeFactory::InvalidIndex && "Failed to find actual arg node!");
-				constraints.emplace_back(AndersConstraint::COPY, fIndex, aIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, fIndex, aIndex);
 			}
 			else
-				constraints.emplace_back(AndersConstraint::COPY, fIndex, nodeFactory.getUniversalPtrNode());
+				buf.constraints.emplace_back(AndersConstraint::COPY, fIndex, nodeFactory.getUniversalPtrNode());
 		}
 
 		++fItr, ++aItr;
@@ -476,7 +809,7 @@ void Andersen::addArgumentConstraintForCall(ImmutableCallSite cs, const Function
 				assert(aIndex != AndersNodeFactory::InvalidIndex && "Failed to find actual arg node!");
 				NodeIndex vaIndex = nodeFactory.getVarargNodeFor(f);
 				assert(vaIndex != AndersNodeFactory::InvalidIndex && "Failed to find vararg node!");
-				constraints.emplace_back(AndersConstraint::COPY, vaIndex, aIndex);
+				buf.constraints.emplace_back(AndersConstraint::COPY, vaIndex, aIndex);
 			}
 
 			++aItr;
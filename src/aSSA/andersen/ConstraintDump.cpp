@@ -0,0 +1,250 @@
+#include "Andersen.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+using namespace llvm;
+
+cl::opt<std::string> ExportConstraintsFile("anders-export-cons", cl::desc("Write the Andersen constraints into this file, in the binary format that anders-bench replays"), cl::init(""));
+cl::opt<bool> ExportOptimizedConstraints("anders-export-optimized", cl::desc("With -anders-export-cons, write the constraints after the offline optimizations instead of as collected"), cl::init(false));
+
+// Layout of a constraint dump. Every field is a little-endian 32-bit word:
+//   magic[2] version optimized maxFields numNodes numConstraints numCalls numTargets
+//   nodes[3 * numNodes]		(kind offset mergeTarget, where kind is numFields << 1 for an object node and 0 for a value node)
+//   constraints[4 * numConstraints]		(type dest src offset)
+//   calls		(funPtr ret numArgs args[numArgs], for each of the numCalls indirect calls resolved on the fly)
+//   targets		(obj vararg ret numFormals formals[numFormals], for each of the numTargets functions they may call)
+// The nodes carry no value: a dump is enough to run the solver, not to answer queries about the IR
+namespace {
+
+const char DumpMagic[8] = {'A', 'N', 'D', 'E', 'R', 'S', 'C', 'S'};
+const uint32_t DumpVersion = 1;
+const size_t HeaderWords = 2 + 7;
+
+void writeWord(raw_ostream& os, uint32_t word)
+{
+	char buf[4];
+	support::endian::write32le(buf, word);
+	os.write(buf, 4);
+}
+
+// Reads the words of a dump one after the other. Reading past the end fails, and so do all the reads that come after
+class DumpReader
+{
+private:
+	StringRef data;
+	size_t pos;
+	bool failed;
+public:
+	DumpReader(StringRef d): data(d), pos(0), failed(false) {}
+
+	uint32_t read()
+	{
+		if (failed || pos + 4 > data.size())
+		{
+			failed = true;
+			return 0;
+		}
+		uint32_t word = support::endian::read32le(data.data() + pos);
+		pos += 4;
+		return word;
+	}
+	// Read a node index, which must be smaller than numNodes. An optional node may be InvalidIndex as well
+	NodeIndex readNode(uint32_t numNodes, bool optional = false)
+	{
+		NodeIndex n = read();
+		if (n >= numNodes && !(optional && n == AndersNodeFactory::InvalidIndex))
+			failed = true;
+		return n;
+	}
+
+	bool hasFailed() const { return failed; }
+	bool atEnd() const { return pos == data.size(); }
+};
+
+}	// end of anonymous namespace
+
+// Everything the solution depends on, from numNodes on in the layout above
+void Andersen::writeSolverInput(raw_ostream& os) const
+{
+	uint32_t numNodes = nodeFactory.getNumNodes();
+	writeWord(os, numNodes);
+	writeWord(os, constraints.size());
+	writeWord(os, indirectCalls.size());
+	writeWord(os, indirectCallTargets.size());
+
+	for (NodeIndex i = 0; i < numNodes; ++i)
+	{
+		writeWord(os, nodeFactory.isObjectNode(i) ? nodeFactory.getObjectSize(i) << 1 : 0);
+		writeWord(os, nodeFactory.isObjectNode(i) ? nodeFactory.getObjectOffset(i) : 0);
+		writeWord(os, nodeFactory.getMergeTarget(i));
+	}
+
+	for (auto const& c: constraints)
+	{
+		writeWord(os, c.getType());
+		writeWord(os, c.getDest());
+		writeWord(os, c.getSrc());
+		writeWord(os, c.getOffset());
+	}
+
+	for (auto const& call: indirectCalls)
+	{
+		writeWord(os, call.funPtr);
+		writeWord(os, call.ret);
+		writeWord(os, call.args.size());
+		for (auto arg: call.args)
+			writeWord(os, arg);
+	}
+
+	for (auto const& target: indirectCallTargets)
+	{
+		writeWord(os, target.obj);
+		writeWord(os, target.vararg);
+		writeWord(os, target.ret);
+		writeWord(os, target.formals.size());
+		for (auto formal: target.formals)
+			writeWord(os, formal);
+	}
+}
+
+void Andersen::exportConstraints(const std::string& path, bool isOptimized) const
+{
+	int fd;
+	SmallString<128> tmpPath;
+	if (std::error_code ec = sys::fs::createUniqueFile(path + ".tmp%%%%%%", fd, tmpPath))
+	{
+		errs() << "Cannot write the Andersen constraints into " << path << ": " << ec.message() << '\n';
+		return;
+	}
+
+	{
+		raw_fd_ostream os(fd, true);
+
+		os.write(DumpMagic, 8);
+		writeWord(os, DumpVersion);
+		writeWord(os, isOptimized ? 1 : 0);
+		writeWord(os, nodeFactory.getMaxFields());
+		writeSolverInput(os);
+
+		if (os.has_error())
+		{
+			errs() << "Cannot write the Andersen constraints into " << path << '\n';
+			os.clear_error();
+			sys::fs::remove(tmpPath);
+			return;
+		}
+	}
+
+	if (std::error_code ec = sys::fs::rename(tmpPath, path))
+	{
+		errs() << "Cannot write the Andersen constraints into " << path << ": " << ec.message() << '\n';
+		sys::fs::remove(tmpPath);
+	}
+}
+
+std::unique_ptr<Andersen> Andersen::importConstraints(const std::string& path)
+{
+	auto bufOrErr = MemoryBuffer::getFile(path, -1, false);
+	if (!bufOrErr)
+	{
+		errs() << "Cannot read the Andersen constraints from " << path << ": " << bufOrErr.getError().message() << '\n';
+		return nullptr;
+	}
+
+	StringRef data = (*bufOrErr)->getBuffer();
+	if (data.size() < 4 * HeaderWords || std::memcmp(data.data(), DumpMagic, 8) != 0)
+	{
+		errs() << path << " is not an Andersen constraint dump\n";
+		return nullptr;
+	}
+
+	DumpReader reader(data.substr(8));
+	if (reader.read() != DumpVersion)
+	{
+		errs() << "The Andersen constraint dump " << path << " has an unsupported version\n";
+		return nullptr;
+	}
+
+	std::unique_ptr<Andersen> anders(new Andersen());
+	AndersNodeFactory& nodeFactory = anders->nodeFactory;
+	anders->optimized = reader.read() != 0;
+	nodeFactory.setMaxFields(reader.read());
+	uint32_t numNodes = reader.read(), numConstraints = reader.read(), numCalls = reader.read(), numTargets = reader.read();
+
+	// Rebuild the nodes. The special nodes are always there, and the field nodes of an object are created along with its first one
+	bool badNodes = numNodes < nodeFactory.getNumNodes();
+	std::vector<NodeIndex> mergeTargets;
+	for (NodeIndex i = 0; i < numNodes && !badNodes && !reader.hasFailed(); ++i)
+	{
+		uint32_t kind = reader.read(), offset = reader.read();
+		mergeTargets.push_back(reader.readNode(numNodes));
+
+		unsigned numFields = kind >> 1;
+		if (i >= nodeFactory.getNumNodes())
+		{
+			if (kind == 0)
+				nodeFactory.createValueNode();
+			else if (numFields > 0 && offset == 0)
+				nodeFactory.createObjectNodeWithFields(numFields);
+			else
+				badNodes = true;
+		}
+		badNodes = badNodes || i >= nodeFactory.getNumNodes() || nodeFactory.isObjectNode(i) != (kind != 0) || (kind != 0 && (nodeFactory.getObjectSize(i) != numFields || nodeFactory.getObjectOffset(i) != offset));
+	}
+	if (badNodes || reader.hasFailed())
+	{
+		errs() << "The Andersen constraint dump " << path << " is corrupted\n";
+		return nullptr;
+	}
+	for (NodeIndex i = 0, e = mergeTargets.size(); i < e; ++i)
+	{
+		if (mergeTargets[i] != i)
+			nodeFactory.mergeNode(mergeTargets[i], i);
+	}
+
+	anders->constraints.reserve(numConstraints);
+	for (uint32_t i = 0; i < numConstraints && !reader.hasFailed(); ++i)
+	{
+		uint32_t type = reader.read();
+		NodeIndex dest = reader.readNode(numNodes), src = reader.readNode(numNodes);
+		uint32_t offset = reader.read();
+		if (type > AndersConstraint::GEP)
+			break;
+		anders->constraints.emplace_back(static_cast<AndersConstraint::ConstraintType>(type), dest, src, offset);
+	}
+
+	for (uint32_t i = 0; i < numCalls && !reader.hasFailed(); ++i)
+	{
+		AndersIndirectCall call;
+		call.funPtr = reader.readNode(numNodes);
+		call.ret = reader.readNode(numNodes, true);
+		for (uint32_t j = 0, numArgs = reader.read(); j < numArgs && !reader.hasFailed(); ++j)
+			call.args.push_back(reader.readNode(numNodes, true));
+		anders->indirectCalls.push_back(std::move(call));
+	}
+
+	for (uint32_t i = 0; i < numTargets && !reader.hasFailed(); ++i)
+	{
+		AndersCallTarget target;
+		target.obj = reader.readNode(numNodes);
+		target.vararg = reader.readNode(numNodes, true);
+		target.ret = reader.readNode(numNodes, true);
+		for (uint32_t j = 0, numFormals = reader.read(); j < numFormals && !reader.hasFailed(); ++j)
+			target.formals.push_back(reader.readNode(numNodes, true));
+		anders->indirectCallTargets.push_back(std::move(target));
+	}
+
+	if (reader.hasFailed() || !reader.atEnd() || anders->constraints.size() != numConstraints)
+	{
+		errs() << "The Andersen constraint dump " << path << " is corrupted\n";
+		return nullptr;
+	}
+	return anders;
+}
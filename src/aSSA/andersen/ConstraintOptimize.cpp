@@ -9,7 +9,9 @@
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 
+#include <chrono>
 #include <deque>
 #include <unordered_map>
 #include <set>
@@ -18,6 +20,11 @@ using namespace llvm;
 
 cl::opt<bool> EnableHVN("enable-hvn", cl::desc("Enable the HVN constraint optimization"));
 cl::opt<bool> EnableHU("enable-hu", cl::desc("Enable the HU constraint optimization"));
+cl::opt<bool> AutoOptimize("anders-auto-opt", cl::desc("Turn on the HVN, HU, HCD and LCD optimizations that the statistics of the constraints say pay off, unless they are given on the command line"), cl::init(false));
+cl::opt<bool> AutoOptimizeBaseline("anders-auto-opt-baseline", cl::desc("With -anders-auto-opt, also solve the constraints without the automatic choices and report the time they save"), cl::init(false));
+
+extern cl::opt<bool> EnableHCD;
+extern cl::opt<bool> EnableLCD;
 
 namespace {
 
@@ -78,8 +85,23 @@ protected:
 		return n + 2 * nodeFactory.getNumNodes();
 	}
 
-	void buildPredecessorGraph()
+	void buildPredecessorGraph(const std::vector<NodeIndex>& solverDests)
 	{
+		// The solver adds copy edges into these nodes as it resolves the indirect calls. We don't know their sources yet
+		for (auto node: solverDests)
+		{
+			NodeIndex nodeTgt = nodeFactory.getMergeTarget(node);
+			indirectNodes.insert(nodeTgt);
+			predGraph.getOrInsertNode(nodeTgt);
+		}
+
+		// Field nodes are reached through gep constraints, which we don't model in the predecessor graph. Treat them conservatively
+		for (unsigned i = 0, e = nodeFactory.getNumNodes(); i < e; ++i)
+		{
+			if (nodeFactory.isObjectNode(i) && nodeFactory.getObjectSize(i) > 1)
+				indirectNodes.insert(nodeFactory.getMergeTarget(i));
+		}
+
 		for (auto const& c: constraints)
 		{
 			NodeIndex srcTgt = nodeFactory.getMergeTarget(c.getSrc());
@@ -115,6 +137,13 @@ protected:
 					predGraph.insertEdge(getRefNodeIndex(dstTgt), getRefNodeIndex(srcTgt));
 					break;
 				}
+				case AndersConstraint::GEP:
+				{
+					// Dest = Src + k. Dest doesn't point to what Src points to, so it must keep a label of its own. Make sure it gets one even without incoming edges
+					indirectNodes.insert(dstTgt);
+					predGraph.getOrInsertNode(dstTgt);
+					break;
+				}
 			}
 		}
 	}
@@ -349,6 +378,26 @@ protected:
 						newConstraints.emplace_back(AndersConstraint::COPY, destTgt, srcTgt);
 					}
 
+					break;
+				}
+				case AndersConstraint::GEP:
+				{
+					// If the src is a non-ptr, ignore this constraint
+					if (peLabel[srcTgt] == 0)
+						break;
+
+					// If the rhs is equivalent to some ADR node, then we know which field the lhs points to
+					NodeIndex srcTgtTgt = revLabelMap[peLabel[srcTgt]];
+					if (srcTgtTgt > nodeFactory.getNumNodes() && c.getOffset() != AndersNodeFactory::UnknownOffset)
+					{
+						srcTgtTgt %= nodeFactory.getNumNodes();
+						newConstraints.emplace_back(AndersConstraint::ADDR_OF, destTgt, nodeFactory.getFieldNode(srcTgtTgt, c.getOffset()));
+					}
+					else
+					{
+						newConstraints.emplace_back(AndersConstraint::GEP, destTgt, srcTgt, c.getOffset());
+					}
+
 					break;
 				}
 			}
@@ -370,10 +419,10 @@ protected:
 
 	virtual void propagateLabel(NodeIndex node) = 0;
 public:
-	ConstraintOptimizer(std::vector<AndersConstraint>& c, AndersNodeFactory& n): constraints(c), nodeFactory(n), pointerEqClass(1)
+	ConstraintOptimizer(std::vector<AndersConstraint>& c, AndersNodeFactory& n, const std::vector<NodeIndex>& solverDests): constraints(c), nodeFactory(n), pointerEqClass(1)
 	{
 		// Build a predecessor graph.  This is like our constraint graph with the edges going in the opposite direction, and there are edges for all the constraints, instead of just copy constraints.  We also build implicit edges for constraints are implied but not explicit.  I.E for the constraint a = &b, we add implicit edges *a = b.  This helps us capture more cycles
-		buildPredecessorGraph();
+		buildPredecessorGraph(solverDests);
 	}
 
 	void run() override
@@ -382,8 +431,12 @@ public:
 		runOnGraph(&predGraph);
 
 		// For all nodes on the same cycle: assign their representative's pe label to them
+		// Read the label before inserting into peLabel, which may grow it and invalidate the reference
 		for (auto const& mapping: mergeTarget)
-			peLabel[mapping.first] = peLabel[getMergeTargetRep(mapping.second)];
+		{
+			unsigned label = peLabel[getMergeTargetRep(mapping.second)];
+			peLabel[mapping.first] = label;
+		}
 
 		/*for (unsigned i = 0; i < peLabel.size(); ++i)
 		{
@@ -459,7 +512,7 @@ private:
 	}
 
 public:
-	HVNOptimizer(std::vector<AndersConstraint>& c, AndersNodeFactory& n): ConstraintOptimizer(c, n) {}
+	HVNOptimizer(std::vector<AndersConstraint>& c, AndersNodeFactory& n, const std::vector<NodeIndex>& d): ConstraintOptimizer(c, n, d) {}
 
 	void releaseMemory() override
 	{
@@ -552,7 +605,7 @@ private:
 		}
 	}
 public:
-	HUOptimizer(std::vector<AndersConstraint>& c, AndersNodeFactory& n): ConstraintOptimizer(c, n) {}
+	HUOptimizer(std::vector<AndersConstraint>& c, AndersNodeFactory& n, const std::vector<NodeIndex>& d): ConstraintOptimizer(c, n, d) {}
 
 	void releaseMemory() override
 	{
@@ -562,19 +615,225 @@ public:
 	}
 };
 
+// Counts the nodes on the cycles of copy edges, which are what the online cycle detection collapses
+class CopyCycleCounter: public CycleDetector<SparseBitVectorGraph>
+{
+private:
+	SparseBitVectorGraph copyGraph;
+	unsigned numCycleNodes;
+	// The number of non-rep nodes of the SCC being popped
+	unsigned sccSize;
+
+	NodeType* getRep(NodeIndex idx) override
+	{
+		return copyGraph.getOrInsertNode(idx);
+	}
+
+	void processNodeOnCycle(const NodeType* node, const NodeType* repNode) override
+	{
+		++sccSize;
+	}
+
+	void processCycleRepNode(const NodeType* node) override
+	{
+		// A trivial cycle is not interesting
+		if (sccSize != 0)
+			numCycleNodes += sccSize + 1;
+		sccSize = 0;
+	}
+public:
+	CopyCycleCounter(const std::vector<AndersConstraint>& constraints, const AndersNodeFactory& nodeFactory): numCycleNodes(0), sccSize(0)
+	{
+		for (auto const& c: constraints)
+		{
+			if (c.getType() == AndersConstraint::COPY)
+				copyGraph.insertEdge(nodeFactory.getMergeTarget(c.getSrc()), nodeFactory.getMergeTarget(c.getDest()));
+		}
+	}
+
+	void run() override
+	{
+		runOnGraph(&copyGraph);
+		releaseSCCMemory();
+	}
+
+	unsigned getNumCopyNodes() const { return copyGraph.getSize(); }
+	unsigned getNumCycleNodes() const { return numCycleNodes; }
+};
+
+// The thresholds of -anders-auto-opt. They come from the modules the optimizations were measured on: below MinConstraints, the solving takes so little time that no pre-pass pays for itself
+const unsigned AutoOptMinConstraints = 1000;
+// HVN is cheap, and merges the pointers that only get copies and geps of the same sources
+const double AutoOptMinCopyRatio = 0.3;
+// HU also merges the results of loads, but computes a pts-to set for every node of the predecessor graph: it only pays off when there are many loads and stores, through pointers to few objects
+const double AutoOptMinHULoadStoreRatio = 0.2;
+const double AutoOptMaxHUFanOut = 8;
+// HCD finds the cycles that go through loads and stores offline
+const double AutoOptMinHCDLoadStoreRatio = 0.1;
+// LCD looks for a cycle whenever a copy edge does not change its target: that pays off when the copy cycles are many, or when the pts-to sets they would duplicate are large
+const double AutoOptMinCycleDensity = 0.05;
+const double AutoOptMinLCDFanOut = 16;
+
+// Turn flag on or off as decided, unless it is given on the command line, and tell why
+void selectOptimization(cl::opt<bool>& flag, const char* name, bool payOff, const std::string& reason)
+{
+	if (flag.getNumOccurrences() > 0)
+	{
+		errs() << "  " << name << (flag ? " on" : " off") << ": given on the command line\n";
+		return;
+	}
+	flag = payOff;
+	errs() << "  " << name << (payOff ? " on: " : " off: ") << reason << "\n";
+}
+
 }	// end of anonymous namespace
 
+/// selectOptimizations - With -anders-auto-opt, turn on the optimizations that
+/// pay off on these constraints: HVN and HU, which run next, and the HCD and
+/// LCD of the solver. The choice rests on the share of each type of
+/// constraint, the share of the nodes with copy edges that are on a copy
+/// cycle, and the number of objects the address of a load or a store points to
+/// before solving: those it takes the address of, and those its direct copy
+/// sources do. The report on stderr gives the figures behind each choice.
+void Andersen::selectOptimizations()
+{
+	unsigned numByType[AndersConstraint::GEP + 1] = {0};
+	for (auto const& c: constraints)
+		++numByType[c.getType()];
+
+	unsigned numNodes = nodeFactory.getNumNodes();
+	std::vector<unsigned> numAddrs(numNodes, 0);
+	for (auto const& c: constraints)
+	{
+		if (c.getType() == AndersConstraint::ADDR_OF)
+			++numAddrs[nodeFactory.getMergeTarget(c.getDest())];
+	}
+	std::vector<unsigned> estimatedFanOut(numAddrs);
+	for (auto const& c: constraints)
+	{
+		if (c.getType() == AndersConstraint::COPY)
+			estimatedFanOut[nodeFactory.getMergeTarget(c.getDest())] += numAddrs[nodeFactory.getMergeTarget(c.getSrc())];
+	}
+	uint64_t totalFanOut = 0;
+	for (auto const& c: constraints)
+	{
+		if (c.getType() == AndersConstraint::LOAD)
+			totalFanOut += estimatedFanOut[nodeFactory.getMergeTarget(c.getSrc())];
+		else if (c.getType() == AndersConstraint::STORE)
+			totalFanOut += estimatedFanOut[nodeFactory.getMergeTarget(c.getDest())];
+	}
+
+	CopyCycleCounter cycles(constraints, nodeFactory);
+	cycles.run();
+
+	double numConstraints = std::max<size_t>(constraints.size(), 1);
+	unsigned numLoadStores = numByType[AndersConstraint::LOAD] + numByType[AndersConstraint::STORE];
+	double copyRatio = (numByType[AndersConstraint::COPY] + numByType[AndersConstraint::GEP]) / numConstraints;
+	double loadStoreRatio = numLoadStores / numConstraints;
+	double fanOut = numLoadStores == 0 ? 0 : double(totalFanOut) / numLoadStores;
+	double cycleDensity = cycles.getNumCopyNodes() == 0 ? 0 : double(cycles.getNumCycleNodes()) / cycles.getNumCopyNodes();
+
+	errs() << "Andersen automatic optimizations for " << constraints.size() << " constraints (" << numByType[AndersConstraint::ADDR_OF] << " addr-of, " << numByType[AndersConstraint::COPY] << " copy, " << numByType[AndersConstraint::LOAD] << " load, " << numByType[AndersConstraint::STORE] << " store, " << numByType[AndersConstraint::GEP] << " gep):\n";
+	if (constraints.size() < AutoOptMinConstraints)
+	{
+		std::string reason = "fewer than " + std::to_string(AutoOptMinConstraints) + " constraints";
+		selectOptimization(EnableHVN, "HVN", false, reason);
+		selectOptimization(EnableHU, "HU", false, reason);
+		selectOptimization(EnableHCD, "HCD", false, reason);
+		selectOptimization(EnableLCD, "LCD", false, reason);
+		return;
+	}
+
+	std::string reason;
+	raw_string_ostream os(reason);
+	os << format("copies and geps are %.0f%% of the constraints (%s %.0f%%)", 100 * copyRatio, copyRatio >= AutoOptMinCopyRatio ? "at least" : "less than", 100 * AutoOptMinCopyRatio);
+	selectOptimization(EnableHVN, "HVN", copyRatio >= AutoOptMinCopyRatio, os.str());
+
+	reason.clear();
+	if (!EnableHVN)
+		os << "it is only worth it on top of HVN";
+	else
+		os << format("loads and stores are %.0f%% of the constraints (%s %.0f%%), and their addresses point to %.1f objects on average (%s %.0f)", 100 * loadStoreRatio, loadStoreRatio >= AutoOptMinHULoadStoreRatio ? "at least" : "less than", 100 * AutoOptMinHULoadStoreRatio, fanOut, fanOut <= AutoOptMaxHUFanOut ? "at most" : "more than", AutoOptMaxHUFanOut);
+	selectOptimization(EnableHU, "HU", EnableHVN && loadStoreRatio >= AutoOptMinHULoadStoreRatio && fanOut <= AutoOptMaxHUFanOut, os.str());
+
+	reason.clear();
+	os << format("loads and stores are %.0f%% of the constraints (%s %.0f%%)", 100 * loadStoreRatio, loadStoreRatio >= AutoOptMinHCDLoadStoreRatio ? "at least" : "less than", 100 * AutoOptMinHCDLoadStoreRatio);
+	selectOptimization(EnableHCD, "HCD", loadStoreRatio >= AutoOptMinHCDLoadStoreRatio, os.str());
+
+	reason.clear();
+	os << format("%.1f%% of the %u nodes with copy edges are on a copy cycle (%s %.0f%%), and the addresses of the loads and stores point to %.1f objects on average (%s %.0f)", 100 * cycleDensity, cycles.getNumCopyNodes(), cycleDensity >= AutoOptMinCycleDensity ? "at least" : "less than", 100 * AutoOptMinCycleDensity, fanOut, fanOut >= AutoOptMinLCDFanOut ? "at least" : "less than", AutoOptMinLCDFanOut);
+	selectOptimization(EnableLCD, "LCD", cycleDensity >= AutoOptMinCycleDensity || fanOut >= AutoOptMinLCDFanOut, os.str());
+}
+
+// With -anders-auto-opt-baseline: optimize and solve a copy of the constraints with the optimizations given on the command line only, and return how long it took. This mirrors solveAndCompareConstraints()
+double Andersen::timeBaselineSolve()
+{
+	std::vector<AndersConstraint> savedConstraints(constraints);
+	AndersNodeFactory savedNodeFactory(nodeFactory);
+	AndersPtsGraph savedSeeds(seedPtsGraph);
+	std::vector<AndersConstraint> savedNewConstraints(newConstraints);
+	uint64_t savedNumNodeVisits = numNodeVisits;
+	bool savedOptimized = optimized;
+
+	AutoOptimize = false;
+	auto start = std::chrono::steady_clock::now();
+	optimizeConstraints();
+	solveConstraints();
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	AutoOptimize = true;
+
+	constraints.swap(savedConstraints);
+	nodeFactory = std::move(savedNodeFactory);
+	seedPtsGraph.swap(savedSeeds);
+	newConstraints.swap(savedNewConstraints);
+	numNodeVisits = savedNumNodeVisits;
+	optimized = savedOptimized;
+	return time;
+}
+
 // Optimize the constraints by performing offline variable substitution
 void Andersen::optimizeConstraints()
 {
+	// HVN and HU assume that no node has been merged yet
+	if (optimized)
+		return;
+	optimized = true;
+	// Starting from a seed, the solver only propagates what the new constraints add, which leaves HVN and HU nothing to save. Their merges would only make it propagate more (see seedSolution() in ConstraintSolving.cpp)
+	if (!seedPtsGraph.empty())
+		return;
+
+	if (AutoOptimize)
+		selectOptimizations();
+
 	//errs() << "\n#constraints = " << constraints.size() << "\n";
 	//dumpConstraints();
 
+	// The nodes that get new incoming edges from the indirect calls resolved during the solving: the formals of the possible targets and the values returned by the calls
+	std::vector<NodeIndex> solverDests;
+	if (!indirectCalls.empty())
+	{
+		for (auto const& target: indirectCallTargets)
+		{
+			for (auto formal: target.formals)
+			{
+				if (formal != AndersNodeFactory::InvalidIndex)
+					solverDests.push_back(formal);
+			}
+			if (target.vararg != AndersNodeFactory::InvalidIndex)
+				solverDests.push_back(target.vararg);
+		}
+		for (auto const& call: indirectCalls)
+		{
+			if (call.ret != AndersNodeFactory::InvalidIndex)
+				solverDests.push_back(call.ret);
+		}
+	}
+
 	// First, let's do HVN
 	// There is an additional assumption here that before HVN, we have not merged any two nodes. Might fix that in the future
 	if (EnableHVN)
 	{
-		HVNOptimizer hvn(constraints, nodeFactory);
+		HVNOptimizer hvn(constraints, nodeFactory, solverDests);
 		hvn.run();
 	}
 
@@ -587,7 +846,7 @@ void Andersen::optimizeConstraints()
 	// There is an additional assumption here that before HU, the predecessor graph will have no cycle. Might fix that in the future
 	if (EnableHU)
 	{
-		HUOptimizer hu(constraints, nodeFactory);
+		HUOptimizer hu(constraints, nodeFactory, solverDests);
 		hu.run();
 	}
 
@@ -1,77 +1,173 @@
 #include "Andersen.h"
 #include "CycleDetector.h"
 #include "SparseBitVectorGraph.h"
+#include "UnificationSolver.h"
 
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <queue>
 #include <map>
+#include <thread>
+
+#define DEBUG_TYPE "andersen"
 
 using namespace llvm;
 
+STATISTIC(NumNodeVisits, "Number of nodes visited by the Andersen solver");
+STATISTIC(NumWaveRounds, "Number of rounds of the wave propagation solver");
+
+namespace {
+
+// The algorithm that solves the constraints
+enum class SolverKind
+{
+	WorkList,
+	Wave,
+	Unification,
+};
+
+// The order in which the sequential solver picks the nodes from its worklist
+enum class WorkListOrder
+{
+	FIFO,
+	LRF,
+	Topo,
+};
+
+}	// end of anonymous namespace
+
 cl::opt<bool> EnableHCD("enable-hcd", cl::desc("Enable the hybrid cycle detection algorithm"));
 cl::opt<bool> EnableLCD("enable-lcd", cl::desc("Enable the lazy cycle detection algorithm"));
+cl::opt<SolverKind> SolverAlgorithm("anders-solver", cl::desc("Algorithm that solves the Andersen constraints"),
+	cl::values(
+		clEnumValN(SolverKind::WorkList, "worklist", "Worklist solver with lazy cycle detection"),
+		clEnumValN(SolverKind::Wave, "wave", "Wave propagation: collapse every copy cycle, then propagate in topological order, round after round"),
+		clEnumValN(SolverKind::Unification, "unification", "Steensgaard-style unification: near-linear, but the pts-to sets are coarser"),
+		clEnumValEnd),
+	cl::init(SolverKind::WorkList));
+cl::opt<bool> CompareSolvers("anders-compare-solvers", cl::desc("Also solve the constraints with the unification solver, or with the worklist one if unification is selected, and report the number of regions per pointer of both"), cl::init(false));
+cl::opt<unsigned> SolverThreads("anders-threads", cl::desc("Number of threads used to solve the constraints (1 = sequential solver)"), cl::init(1));
+cl::opt<WorkListOrder> WorkListOrdering("anders-worklist", cl::desc("Order in which the sequential Andersen solver visits the nodes"),
+	cl::values(
+		clEnumValN(WorkListOrder::FIFO, "fifo", "First in, first out"),
+		clEnumValN(WorkListOrder::LRF, "lrf", "Least recently fired node first"),
+		clEnumValN(WorkListOrder::Topo, "topo", "Topological order of the copy edges, computed once and again whenever cycles are collapsed"),
+		clEnumValEnd),
+	cl::init(WorkListOrder::FIFO));
 
 namespace {
 
 // This class represent the constraint graph
+// The edges are kept in sparse bitvectors: they are compact, they iterate in order without chasing one heap node per edge, and merging two nodes is a bitwise or
 class ConstraintGraphNode
 {
 private:
 	NodeIndex idx;
 
-	// We use set rather than SmallSet because we need the capability of iteration
-	typedef std::set<NodeIndex> NodeSet;
+	typedef SparseBitVector<> NodeSet;
 	NodeSet copyEdges, loadEdges, storeEdges;
+	// Gep edges are labelled with the field offset. They are rare, so a sorted vector will do
+	typedef std::vector<std::pair<NodeIndex, unsigned>> GepEdgeSet;
+	GepEdgeSet gepEdges;
+	// The indirect calls made through this node, as indices into Andersen::indirectCalls. Kept sorted
+	typedef std::vector<unsigned> CallEdgeSet;
+	CallEdgeSet callEdges;
 
 	bool insertCopyEdge(NodeIndex dst)
 	{
-		return copyEdges.insert(dst).second;
+		return copyEdges.test_and_set(dst);
 	}
 	bool removeCopyEdge(NodeIndex dst)
 	{
-		return copyEdges.erase(dst);
+		if (!copyEdges.test(dst))
+			return false;
+		copyEdges.reset(dst);
+		return true;
 	}
 	bool insertLoadEdge(NodeIndex dst)
 	{
-		return loadEdges.insert(dst).second;
+		return loadEdges.test_and_set(dst);
 	}
 	bool removeLoadEdge(NodeIndex dst)
 	{
-		return loadEdges.erase(dst);
+		if (!loadEdges.test(dst))
+			return false;
+		loadEdges.reset(dst);
+		return true;
 	}
 	bool insertStoreEdge(NodeIndex dst)
 	{
-		return storeEdges.insert(dst).second;
+		return storeEdges.test_and_set(dst);
 	}
 	bool removeStoreEdge(NodeIndex dst)
 	{
-		return storeEdges.erase(dst);
+		if (!storeEdges.test(dst))
+			return false;
+		storeEdges.reset(dst);
+		return true;
 	}
-	bool isEmpty() const
+	bool insertGepEdge(NodeIndex dst, unsigned offset)
 	{
-		return copyEdges.empty() && loadEdges.empty() && storeEdges.empty();
+		auto edge = std::make_pair(dst, offset);
+		auto itr = std::lower_bound(gepEdges.begin(), gepEdges.end(), edge);
+		if (itr != gepEdges.end() && *itr == edge)
+			return false;
+		gepEdges.insert(itr, edge);
+		return true;
+	}
+	bool insertCallEdge(unsigned call)
+	{
+		auto itr = std::lower_bound(callEdges.begin(), callEdges.end(), call);
+		if (itr != callEdges.end() && *itr == call)
+			return false;
+		callEdges.insert(itr, call);
+		return true;
 	}
 
 	void mergeEdges(const ConstraintGraphNode& other)
 	{
-		copyEdges.insert(other.copyEdges.begin(), other.copyEdges.end());
-		loadEdges.insert(other.loadEdges.begin(), other.loadEdges.end());
-		storeEdges.insert(other.storeEdges.begin(), other.storeEdges.end());
+		copyEdges |= other.copyEdges;
+		loadEdges |= other.loadEdges;
+		storeEdges |= other.storeEdges;
+		for (auto const& edge: other.gepEdges)
+			insertGepEdge(edge.first, edge.second);
+		for (auto call: other.callEdges)
+			insertCallEdge(call);
+	}
+
+	void clear()
+	{
+		copyEdges.clear();
+		loadEdges.clear();
+		storeEdges.clear();
+		GepEdgeSet().swap(gepEdges);
+		CallEdgeSet().swap(callEdges);
 	}
 
 	ConstraintGraphNode(NodeIndex i): idx(i) {}
 public:
 	typedef NodeSet::iterator iterator;
-	typedef NodeSet::const_iterator const_iterator;
+	typedef NodeSet::iterator const_iterator;
 
 	NodeIndex getNodeIndex() const { return idx; }
 
+	bool isEmpty() const
+	{
+		return copyEdges.empty() && loadEdges.empty() && storeEdges.empty() && gepEdges.empty() && callEdges.empty();
+	}
+
 	bool replaceCopyEdge(NodeIndex oldIdx, NodeIndex newIdx)
 	{
 		return removeCopyEdge(oldIdx) && insertCopyEdge(newIdx);
@@ -85,8 +181,6 @@ public:
 		return removeStoreEdge(oldIdx) && insertStoreEdge(newIdx);
 	}
 
-	iterator begin() { return copyEdges.begin(); }
-	iterator end() { return copyEdges.end(); }
 	const_iterator begin() const { return copyEdges.begin(); }
 	const_iterator end() const { return copyEdges.end(); }
 
@@ -104,102 +198,101 @@ public:
 		return llvm::iterator_range<const_iterator>(store_begin(), store_end());
 	}
 
+	GepEdgeSet::const_iterator gep_begin() const { return gepEdges.begin(); }
+	GepEdgeSet::const_iterator gep_end() const { return gepEdges.end(); }
+	llvm::iterator_range<GepEdgeSet::const_iterator> geps() const
+	{
+		return llvm::iterator_range<GepEdgeSet::const_iterator>(gep_begin(), gep_end());
+	}
+
+	CallEdgeSet::const_iterator call_begin() const { return callEdges.begin(); }
+	CallEdgeSet::const_iterator call_end() const { return callEdges.end(); }
+	llvm::iterator_range<CallEdgeSet::const_iterator> calls() const
+	{
+		return llvm::iterator_range<CallEdgeSet::const_iterator>(call_begin(), call_end());
+	}
+
 	friend class ConstraintGraph;
 };
 
+// The graph is indexed by NodeIndex and sized for all the nodes upfront, so node pointers stay valid while edges are added during the solving. A node without any outgoing edge is considered absent from the graph
 class ConstraintGraph
 {
 private:
-	typedef std::map<NodeIndex, ConstraintGraphNode> NodeMapTy;
-	NodeMapTy graph;
+	typedef std::vector<ConstraintGraphNode> NodeVecTy;
+	NodeVecTy graph;
+	unsigned numMerges;
 public:
-	typedef NodeMapTy::iterator iterator;
-	typedef NodeMapTy::const_iterator const_iterator;
+	typedef NodeVecTy::iterator iterator;
+	typedef NodeVecTy::const_iterator const_iterator;
 
-	ConstraintGraph() {}
+	ConstraintGraph(unsigned numNodes): numMerges(0)
+	{
+		graph.reserve(numNodes);
+		for (unsigned i = 0; i < numNodes; ++i)
+			graph.push_back(ConstraintGraphNode(i));
+	}
 
 	bool insertCopyEdge(NodeIndex src, NodeIndex dst)
 	{
-		auto itr = graph.find(src);
-		if (itr == graph.end())
-		{
-			ConstraintGraphNode srcNode(src);
-			srcNode.insertCopyEdge(dst);
-			graph.insert(std::make_pair(src, std::move(srcNode)));
-			return true;
-		}
-		else
-			return (itr->second).insertCopyEdge(dst);
+		return graph[src].insertCopyEdge(dst);
 	}
 
 	bool insertLoadEdge(NodeIndex src, NodeIndex dst)
 	{
-		auto itr = graph.find(src);
-		if (itr == graph.end())
-		{
-			ConstraintGraphNode srcNode(src);
-			srcNode.insertLoadEdge(dst);
-			graph.insert(std::make_pair(src, std::move(srcNode)));
-			return true;
-		}
-		else
-			return (itr->second).insertLoadEdge(dst);
+		return graph[src].insertLoadEdge(dst);
 	}
 
 	bool insertStoreEdge(NodeIndex src, NodeIndex dst)
 	{
-		auto itr = graph.find(src);
-		if (itr == graph.end())
-		{
-			ConstraintGraphNode srcNode(src);
-			srcNode.insertStoreEdge(dst);
-			graph.insert(std::make_pair(src, std::move(srcNode)));
-			return true;
-		}
-		else
-			return (itr->second).insertStoreEdge(dst);
+		return graph[src].insertStoreEdge(dst);
 	}
 
-	void mergeNodes(NodeIndex dst, NodeIndex src)
+	bool insertGepEdge(NodeIndex src, NodeIndex dst, unsigned offset)
 	{
-		auto itr = graph.find(src);
-		if (itr == graph.end())
-			return;
+		return graph[src].insertGepEdge(dst, offset);
+	}
 
-		const ConstraintGraphNode& srcNode = itr->second;
-		itr = graph.find(dst);
-		if (itr == graph.end())
-		{
-			ConstraintGraphNode dstNode(dst);
-			graph.insert(std::make_pair(dst, srcNode));
-		}
-		else
-			(itr->second).mergeEdges(srcNode);
+	bool insertCallEdge(NodeIndex src, unsigned call)
+	{
+		return graph[src].insertCallEdge(call);
 	}
 
+	void mergeNodes(NodeIndex dst, NodeIndex src)
+	{
+		graph[dst].mergeEdges(graph[src]);
+		++numMerges;
+	}
+
+	// The number of nodes collapsed so far, so that the solver can tell whether an order it computed is stale
+	unsigned getNumMerges() const { return numMerges; }
+
 	void deleteNode(NodeIndex idx)
 	{
-		graph.erase(idx);
+		graph[idx].clear();
 	}
 
 	ConstraintGraphNode* getNodeWithIndex(NodeIndex idx)
 	{
-		auto itr = graph.find(idx);
-		if (itr == graph.end())
+		ConstraintGraphNode& node = graph[idx];
+		if (node.isEmpty())
+			return nullptr;
+		else
+			return &node;
+	}
+	const ConstraintGraphNode* getNodeWithIndex(NodeIndex idx) const
+	{
+		const ConstraintGraphNode& node = graph[idx];
+		if (node.isEmpty())
 			return nullptr;
 		else
-			return &(itr->second);
+			return &node;
 	}
 
 	ConstraintGraphNode* getOrInsertNode(NodeIndex idx)
 	{
-		auto itr = graph.find(idx);
-		if (itr == graph.end())
-		{
-			ConstraintGraphNode newNode(idx);
-			itr = graph.insert(std::make_pair(idx, newNode)).first;
-		}
-		return &(itr->second);
+		assert(idx < graph.size() && "Node index out of range!");
+		return &graph[idx];
 	}
 
 	iterator begin() { return graph.begin(); }
@@ -215,8 +308,8 @@ template <> class AndersGraphTraits<ConstraintGraph>
 {
 public:
 	typedef ConstraintGraphNode NodeType;
-	typedef MapValueIterator<ConstraintGraph::const_iterator> NodeIterator;
-	typedef ConstraintGraphNode::iterator ChildIterator;
+	typedef ConstraintGraph::const_iterator NodeIterator;
+	typedef ConstraintGraphNode::const_iterator ChildIterator;
 
 	static inline ChildIterator child_begin(const NodeType* n)
 	{
@@ -229,59 +322,175 @@ public:
 
 	static inline NodeIterator node_begin(const ConstraintGraph* g)
 	{
-		return NodeIterator(g->begin());
+		return g->begin();
 	}
 	static inline NodeIterator node_end(const ConstraintGraph* g)
 	{
-		return NodeIterator(g->end());
+		return g->end();
 	}
 };
 
 namespace {
 
-void collapseNodes(NodeIndex dst, NodeIndex src, AndersNodeFactory& nodeFactory, std::map<NodeIndex, AndersPtsSet>& ptsGraph, ConstraintGraph& constraintGraph)
+// prevPtsGraph holds, for each node, the part of its pts-to set that has already been propagated to its successors (see solveConstraints())
+// Return true if the merged node has pts-to info that its successors have not seen yet, i.e. if dst has to be put back on the worklist
+bool collapseNodes(NodeIndex dst, NodeIndex src, AndersNodeFactory& nodeFactory, AndersPtsGraph& ptsGraph, AndersPtsGraph& prevPtsGraph, ConstraintGraph& constraintGraph)
 {
 	if (dst == src)
-		return;
+		return false;
 
 	// Node merge
 	nodeFactory.mergeNode(dst, src);
-	if (ptsGraph.count(src))
-		ptsGraph[dst].unionWith(ptsGraph[src]);
+	ptsGraph[dst].unionWith(ptsGraph[src]);
 	constraintGraph.mergeNodes(dst, src);
+	// The successors of the merged node have seen either prev(dst) or prev(src). Unless the two agree, start over and propagate the whole set again
+	if (!(prevPtsGraph[dst] == prevPtsGraph[src]))
+		prevPtsGraph[dst].clear();
 
-	// We don't need the node cycleIdx any more
-	ptsGraph.erase(src);
+	// We don't need the node cycleIdx any more. Clearing its pts-to set gives its storage back
+	ptsGraph[src].clear();
+	prevPtsGraph[src].clear();
 	constraintGraph.deleteNode(src);
+
+	return !(ptsGraph[dst] == prevPtsGraph[dst]);
+}
+
+// Return the set of field nodes that a gep of the given offset yields on the pointees in ptsSet
+AndersPtsSet getGEPTargets(const AndersNodeFactory& nodeFactory, const AndersPtsSet& ptsSet, unsigned offset)
+{
+	SparseBitVector<> fields;
+	for (auto v: ptsSet)
+	{
+		if (offset == AndersNodeFactory::UnknownOffset)
+		{
+			// We don't know which field we end up in, so it could be any of them
+			NodeIndex base = v - nodeFactory.getObjectOffset(v);
+			for (unsigned i = 0, e = nodeFactory.getObjectSize(v); i < e; ++i)
+				fields.set(base + i);
+		}
+		else
+			fields.set(nodeFactory.getFieldNode(v, offset));
+	}
+	return AndersPtsSet(fields);
+}
+
+// Rank the representatives in topological order of the copy edges (reverse DFS postorder), so that a node is visited before the nodes it propagates to. The cycles that have not been collapsed yet are ordered arbitrarily. The other nodes get the rank of their representative
+void computeTopoOrder(const ConstraintGraph& constraintGraph, const AndersNodeFactory& nodeFactory, std::vector<unsigned>& rank)
+{
+	struct StackEntry
+	{
+		NodeIndex node;
+		ConstraintGraphNode::const_iterator itr, ite;
+	};
+
+	unsigned numNodes = rank.size();
+	unsigned nextRank = numNodes;
+	BitVector visited(numNodes);
+	// The DFS is iterative: the copy chains can be far deeper than the call stack
+	std::vector<StackEntry> stack;
+	for (NodeIndex root = 0; root < numNodes; ++root)
+	{
+		if (visited.test(root) || nodeFactory.getMergeTarget(root) != root)
+			continue;
+
+		visited.set(root);
+		const ConstraintGraphNode* rootNode = constraintGraph.getNodeWithIndex(root);
+		if (rootNode == nullptr)
+		{
+			rank[root] = --nextRank;
+			continue;
+		}
+		stack.push_back(StackEntry{root, rootNode->begin(), rootNode->end()});
+
+		while (!stack.empty())
+		{
+			StackEntry& top = stack.back();
+			if (top.itr == top.ite)
+			{
+				rank[top.node] = --nextRank;
+				stack.pop_back();
+				continue;
+			}
+
+			NodeIndex succ = nodeFactory.getMergeTarget(*top.itr);
+			++top.itr;
+			if (visited.test(succ))
+				continue;
+
+			visited.set(succ);
+			const ConstraintGraphNode* succNode = constraintGraph.getNodeWithIndex(succ);
+			if (succNode == nullptr)
+				rank[succ] = --nextRank;
+			else
+				stack.push_back(StackEntry{succ, succNode->begin(), succNode->end()});
+		}
+	}
+
+	for (NodeIndex node = 0; node < numNodes; ++node)
+		rank[node] = rank[nodeFactory.getMergeTarget(node)];
 }
 
 // The worklist for our analysis
+// Membership is tracked in a bitvector indexed by NodeIndex. Except in FIFO mode, the nodes are dequeued by increasing priority, as given by a vector that the solver owns and keeps up to date
 class AndersWorkList
 {
 private:
+	typedef std::pair<unsigned, NodeIndex> Entry;
+
+	WorkListOrder order;
+	const std::vector<unsigned>& priority;
 	// The FIFO queue
 	std::queue<NodeIndex> list;
-	// Avoid duplicate entries in FIFO queue
-	llvm::SmallSet<NodeIndex, 16> set;
+	// A min-heap of (priority, node), for the other orders
+	std::vector<Entry> heap;
+	// Avoid duplicate entries in the queue
+	BitVector set;
 public:
-	AndersWorkList() {}
+	AndersWorkList(WorkListOrder o, const std::vector<unsigned>& p): order(o), priority(p), set(p.size()) {}
 	void enqueue(NodeIndex elem)
 	{
-		if (!set.count(elem))
-		{
+		if (set.test(elem))
+			return;
+
+		set.set(elem);
+		if (order == WorkListOrder::FIFO)
 			list.push(elem);
-			set.insert(elem);
+		else
+		{
+			heap.push_back(Entry(priority[elem], elem));
+			std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
 		}
 	}
 	NodeIndex dequeue()
 	{
-		assert(!list.empty() && "Trying to dequeue an empty queue!");
-		NodeIndex ret = list.front();
-		list.pop();
-		set.erase(ret);
+		assert(!isEmpty() && "Trying to dequeue an empty queue!");
+		NodeIndex ret;
+		if (order == WorkListOrder::FIFO)
+		{
+			ret = list.front();
+			list.pop();
+		}
+		else
+		{
+			std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+			ret = heap.back().second;
+			heap.pop_back();
+		}
+		set.reset(ret);
 		return ret;
 	}
-	bool isEmpty() const { return list.empty(); }
+	bool isEmpty() const { return list.empty() && heap.empty(); }
+
+	// The priorities have changed since the nodes were enqueued: sort them again
+	void reorder()
+	{
+		if (order == WorkListOrder::FIFO)
+			return;
+
+		for (auto& entry: heap)
+			entry.first = priority[entry.second];
+		std::make_heap(heap.begin(), heap.end(), std::greater<Entry>());
+	}
 };
 
 // The technique used here is described in "The Ant and the Grasshopper: Fast and Accurate Pointer Analysis for Millions of Lines of Code. In Programming Language Design and Implementation (PLDI), June 2007." It is known as the "HCD" (Hybrid Cycle Detection) algorithm. It is called a hybrid because it performs an offline analysis and uses its results during the solving (online) phase. This is just the offline portion
@@ -316,6 +525,7 @@ private:
 			switch (c.getType())
 			{
 				case AndersConstraint::ADDR_OF:
+				case AndersConstraint::GEP:
 					break;
 				case AndersConstraint::LOAD:
 				{
@@ -406,8 +616,14 @@ public:
 	}
 };
 
-void buildConstraintGraph(ConstraintGraph& cGraph, const std::vector<AndersConstraint>& constraints, AndersNodeFactory& nodeFactory, std::map<NodeIndex, AndersPtsSet>& ptsGraph)
+void buildConstraintGraph(ConstraintGraph& cGraph, const std::vector<AndersConstraint>& constraints, const std::vector<AndersIndirectCall>& indirectCalls, AndersNodeFactory& nodeFactory, AndersPtsGraph& ptsGraph)
 {
+	// Node indices are dense and no node is created during solving, so every pts-to set can be allocated upfront
+	ptsGraph.clear();
+	ptsGraph.resize(nodeFactory.getNumNodes());
+
+	// Points-to sets are interned, so build the initial ones as plain bitvectors first and intern each of them only once
+	DenseMap<NodeIndex, SparseBitVector<>> initialPts;
 	for (auto const& c: constraints)
 	{
 		NodeIndex srcTgt = nodeFactory.getMergeTarget(c.getSrc());
@@ -417,7 +633,7 @@ void buildConstraintGraph(ConstraintGraph& cGraph, const std::vector<AndersConst
 			case AndersConstraint::ADDR_OF:
 			{
 				// We don't want to replace src with srcTgt because, after all, the address of a variable is NOT the same as the address of another variable
-				ptsGraph[dstTgt].insert(c.getSrc());
+				initialPts[dstTgt].set(c.getSrc());
 				break;
 			}
 			case AndersConstraint::LOAD:
@@ -435,8 +651,167 @@ void buildConstraintGraph(ConstraintGraph& cGraph, const std::vector<AndersConst
 				cGraph.insertCopyEdge(srcTgt, dstTgt);
 				break;
 			}
+			case AndersConstraint::GEP:
+			{
+				cGraph.insertGepEdge(srcTgt, dstTgt, c.getOffset());
+				break;
+			}
 		}
 	}
+
+	for (auto const& mapping: initialPts)
+		ptsGraph[mapping.first] = AndersPtsSet(mapping.second);
+
+	// An indirect call is resolved whenever its called pointer gets new pointees
+	for (unsigned i = 0, e = indirectCalls.size(); i < e; ++i)
+		cGraph.insertCallEdge(nodeFactory.getMergeTarget(indirectCalls[i].funPtr), i);
+}
+
+// On-the-fly call graph construction: a function becomes a target of an indirect call when it shows up in the pts-to set of the called pointer. The copy edges from the actuals to its formals and from its return node to the value of the call are only added then
+// Like the copy edges found through load/store constraints, a new edge gets the whole pts-to set of its source right away. The nodes whose pts-to set changes are handed back to the solver
+class IndirectCallResolver
+{
+private:
+	const std::vector<AndersIndirectCall>& calls;
+	const std::vector<AndersCallTarget>& targets;
+	AndersNodeFactory& nodeFactory;
+	ConstraintGraph& constraintGraph;
+	AndersPtsGraph& ptsGraph;
+	// Map from the object node of a function to its index in targets
+	DenseMap<NodeIndex, unsigned> targetMap;
+	// The targets each call has been wired to
+	std::vector<SparseBitVector<>> resolved;
+
+	void addCopyEdge(NodeIndex src, NodeIndex dst, std::vector<NodeIndex>& changedNodes)
+	{
+		NodeIndex srcTgt = nodeFactory.getMergeTarget(src);
+		NodeIndex dstTgt = nodeFactory.getMergeTarget(dst);
+		if (srcTgt == dstTgt)
+			return;
+		if (constraintGraph.insertCopyEdge(srcTgt, dstTgt) && ptsGraph[dstTgt].unionWith(ptsGraph[srcTgt]))
+			changedNodes.push_back(dstTgt);
+	}
+
+	// This mirrors the constraints that addConstraintForCall() adds for a direct call to the target
+	void wireCall(unsigned callIdx, unsigned targetIdx, std::vector<NodeIndex>& changedNodes)
+	{
+		const AndersIndirectCall& call = calls[callIdx];
+		const AndersCallTarget& target = targets[targetIdx];
+		if (!resolved[callIdx].test_and_set(targetIdx))
+			return;
+		// #arg mismatch
+		if (target.vararg == AndersNodeFactory::InvalidIndex && target.formals.size() != call.args.size())
+			return;
+
+		unsigned numArgs = std::min(target.formals.size(), call.args.size());
+		for (unsigned i = 0; i < numArgs; ++i)
+		{
+			if (target.formals[i] != AndersNodeFactory::InvalidIndex)
+				addCopyEdge(call.args[i] != AndersNodeFactory::InvalidIndex ? call.args[i] : nodeFactory.getUniversalPtrNode(), target.formals[i], changedNodes);
+		}
+
+		// Copy all pointers passed through the varargs section to the varargs node
+		if (target.vararg != AndersNodeFactory::InvalidIndex)
+		{
+			for (unsigned i = numArgs, e = call.args.size(); i < e; ++i)
+			{
+				if (call.args[i] != AndersNodeFactory::InvalidIndex)
+					addCopyEdge(call.args[i], target.vararg, changedNodes);
+			}
+		}
+
+		// The target may have been cast to a type it does not return a pointer of
+		if (call.ret != AndersNodeFactory::InvalidIndex)
+			addCopyEdge(target.ret != AndersNodeFactory::InvalidIndex ? target.ret : nodeFactory.getUniversalPtrNode(), call.ret, changedNodes);
+	}
+public:
+	IndirectCallResolver(const std::vector<AndersIndirectCall>& c, const std::vector<AndersCallTarget>& t, AndersNodeFactory& n, ConstraintGraph& cg, AndersPtsGraph& p): calls(c), targets(t), nodeFactory(n), constraintGraph(cg), ptsGraph(p), resolved(c.size())
+	{
+		for (unsigned i = 0, e = targets.size(); i < e; ++i)
+			targetMap[targets[i].obj] = i;
+	}
+
+	// pointees are the new pointees of the called pointer of the call
+	void resolve(unsigned callIdx, const AndersPtsSet& pointees, std::vector<NodeIndex>& changedNodes)
+	{
+		for (auto v: pointees)
+		{
+			if (v == nodeFactory.getUniversalObjNode())
+			{
+				// The call may go anywhere: any addr-taken function that can take as many arguments is a potential target, and the returned value can be anything
+				for (unsigned i = 0, e = targets.size(); i < e; ++i)
+					wireCall(callIdx, i, changedNodes);
+				if (calls[callIdx].ret != AndersNodeFactory::InvalidIndex)
+					addCopyEdge(nodeFactory.getUniversalPtrNode(), calls[callIdx].ret, changedNodes);
+				continue;
+			}
+
+			// Anything else than a function with a body is not a target: the library functions have been taken care of when the constraints were collected
+			auto itr = targetMap.find(v);
+			if (itr != targetMap.end())
+				wireCall(callIdx, itr->second, changedNodes);
+		}
+	}
+};
+
+// Start the solver from seedPtsGraph, a solution of all the constraints but newConstraints, instead of from scratch. Such a solution already satisfies the copy, gep, load and store edges of the old constraints, so a representative whose nodes all have the same seed can take its seed as the part of its pts-to set that has been propagated. Then only the new constraints and the pointees they add are propagated. The nodes merged with a node of another seed (by HCD, or because they are new) start with nothing propagated, as in a solve from scratch
+void seedSolution(AndersPtsGraph& seedPtsGraph, const std::vector<AndersConstraint>& newConstraints, AndersNodeFactory& nodeFactory, ConstraintGraph& constraintGraph, AndersPtsGraph& ptsGraph, AndersPtsGraph& prevPtsGraph, IndirectCallResolver& callResolver)
+{
+	// The nodes created since the seed was computed have none
+	seedPtsGraph.resize(ptsGraph.size());
+	BitVector mixed(ptsGraph.size());
+	for (NodeIndex node = 0, e = seedPtsGraph.size(); node < e; ++node)
+	{
+		NodeIndex rep = nodeFactory.getMergeTarget(node);
+		if (!(seedPtsGraph[node] == seedPtsGraph[rep]))
+			mixed.set(rep);
+		if (!seedPtsGraph[node].isEmpty())
+			ptsGraph[rep].unionWith(seedPtsGraph[node]);
+	}
+	for (NodeIndex node = 0, e = seedPtsGraph.size(); node < e; ++node)
+	{
+		if (nodeFactory.getMergeTarget(node) == node && !mixed.test(node))
+			prevPtsGraph[node] = seedPtsGraph[node];
+	}
+	seedPtsGraph.clear();
+
+	// The node each new constraint reads the pts-to set of has to propagate it again, along all its edges: an edge that is already satisfied costs one union. Its successors only get visited if that adds something to them. This goes first, so that the copy edges of its new loads and stores are inserted by its visit, which fills them
+	for (auto const& c: newConstraints)
+	{
+		switch (c.getType())
+		{
+			case AndersConstraint::ADDR_OF:
+				// buildConstraintGraph() has added the pointee, which makes the pts-to set differ from the propagated part
+				break;
+			case AndersConstraint::STORE:
+				prevPtsGraph[nodeFactory.getMergeTarget(c.getDest())].clear();
+				break;
+			case AndersConstraint::LOAD:
+			case AndersConstraint::COPY:
+			case AndersConstraint::GEP:
+				prevPtsGraph[nodeFactory.getMergeTarget(c.getSrc())].clear();
+				break;
+		}
+	}
+
+	// The copy edges that the loads, the stores and the indirect calls derive from the seeds are not in the graph yet. They need not carry anything: their target already has the seed of their source, or their source has nothing propagated
+	std::vector<NodeIndex> changedNodes;
+	for (NodeIndex node = 0, e = prevPtsGraph.size(); node < e; ++node)
+	{
+		ConstraintGraphNode* cNode = constraintGraph.getNodeWithIndex(node);
+		if (cNode == nullptr || prevPtsGraph[node].isEmpty())
+			continue;
+		for (auto v: prevPtsGraph[node])
+		{
+			NodeIndex vRep = nodeFactory.getMergeTarget(v);
+			for (auto dst: cNode->loads())
+				constraintGraph.insertCopyEdge(vRep, nodeFactory.getMergeTarget(dst));
+			for (auto src: cNode->stores())
+				constraintGraph.insertCopyEdge(nodeFactory.getMergeTarget(src), vRep);
+		}
+		for (auto call: cNode->calls())
+			callResolver.resolve(call, prevPtsGraph[node], changedNodes);
+	}
 }
 
 class OnlineCycleDetector: public CycleDetector<ConstraintGraph>
@@ -444,8 +819,11 @@ class OnlineCycleDetector: public CycleDetector<ConstraintGraph>
 private:
 	AndersNodeFactory& nodeFactory;
 	ConstraintGraph& constraintGraph;
-	std::map<NodeIndex, AndersPtsSet>& ptsGraph;
+	AndersPtsGraph& ptsGraph;
+	AndersPtsGraph& prevPtsGraph;
 	const DenseSet<NodeIndex>& candidates;
+	// The collapsed nodes that need to be visited again by the solver
+	std::vector<NodeIndex>& revisitNodes;
 
 	NodeType* getRep(NodeIndex idx) override
 	{
@@ -458,7 +836,8 @@ private:
 		NodeIndex cycleIdx = nodeFactory.getMergeTarget(node->getNodeIndex());
 		//errs() << "Collapse node " << cycleIdx << " with node " << repIdx << "\n";
 
-		collapseNodes(repIdx, cycleIdx, nodeFactory, ptsGraph, constraintGraph);
+		if (collapseNodes(repIdx, cycleIdx, nodeFactory, ptsGraph, prevPtsGraph, constraintGraph))
+			revisitNodes.push_back(repIdx);
 	}
 	// Specify how to process the rep nodes if a cycle is found
 	void processCycleRepNode(const NodeType* node) override
@@ -467,13 +846,457 @@ private:
 	}
 
 public:
-	OnlineCycleDetector(AndersNodeFactory& n, ConstraintGraph& co, std::map<NodeIndex, AndersPtsSet>& p, const DenseSet<NodeIndex>& ca): nodeFactory(n), constraintGraph(co), ptsGraph(p), candidates(ca) {}
+	OnlineCycleDetector(AndersNodeFactory& n, ConstraintGraph& co, AndersPtsGraph& p, AndersPtsGraph& pp, const DenseSet<NodeIndex>& ca, std::vector<NodeIndex>& r): nodeFactory(n), constraintGraph(co), ptsGraph(p), prevPtsGraph(pp), candidates(ca), revisitNodes(r) {}
 
 	void run() override
 	{
 		// Perform cycle detection on for nodes on the candidate list
 		for (auto node: candidates)
 			runOnNode(node);
+		// The graph changes before the next run, but the storage can be reused
+		resetSCCState();
+	}
+};
+
+// This is where we perform HCD: check if node has a collapse target, and if it does, merge them immediately
+// Return the node that node has been merged into, or node itself if it is still a representative and can be processed. Other collapsed nodes that need to be visited again are appended to revisitNodes
+NodeIndex collapseOfflineCycle(NodeIndex node, const AndersPtsSet& ptsSet, OfflineCycleDetector& offlineInfo, AndersNodeFactory& nodeFactory, AndersPtsGraph& ptsGraph, AndersPtsGraph& prevPtsGraph, ConstraintGraph& constraintGraph, std::vector<NodeIndex>& revisitNodes)
+{
+	NodeIndex collapseTarget = offlineInfo.getCollapseTarget(node);
+	if (collapseTarget == AndersNodeFactory::InvalidIndex)
+		return node;
+
+	//errs() << "node = " << node << ", collapseTgt = " << collapseTarget << "\n";
+	NodeIndex ctRep = nodeFactory.getMergeTarget(collapseTarget);
+	// Here we have to pay special attention to whether the node points-to itself.
+	bool mergeSelf = false;
+	for (auto v: ptsSet)
+	{
+		NodeIndex vRep = nodeFactory.getMergeTarget(v);
+		if (vRep == node)
+		{
+			mergeSelf = true;
+			continue;
+		}
+		if (collapseNodes(ctRep, vRep, nodeFactory, ptsGraph, prevPtsGraph, constraintGraph))
+			revisitNodes.push_back(ctRep);
+	}
+
+	if (mergeSelf)
+	{
+		collapseNodes(ctRep, node, nodeFactory, ptsGraph, prevPtsGraph, constraintGraph);
+		return ctRep;
+	}
+	return node;
+}
+
+// Run fn(threadId) on numThreads threads and wait for all of them. The calling thread takes part as thread #0
+template <typename Func>
+void runOnThreads(unsigned numThreads, Func fn)
+{
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < numThreads; ++t)
+		workers.emplace_back(fn, t);
+	fn(0);
+	for (auto& worker: workers)
+		worker.join();
+}
+
+// A bulk-synchronous version of the worklist solver. Each round takes the whole current worklist and:
+// - resolves the load/store constraints of every node in parallel, collecting the new copy edges in per-thread buffers that are inserted into the constraint graph afterwards;
+// - buckets the outgoing copy edges of every node by the thread that owns the target node;
+// - lets every thread union the deltas of the round into the target nodes it owns, so that no two threads ever write to the same points-to set.
+// Node merging (HCD and LCD) and the delta computation only happen between rounds on the calling thread, so the parallel steps never write to the constraint graph or to prevPtsGraph. Their only writes to the node factory are the path compressions of the lock-free union-find the merge targets live in while the solver runs (see AndersNodeFactory::beginConcurrentMerges()). All the steps are monotone, hence we reach the same fixed point as the sequential solver.
+class ParallelSolver
+{
+private:
+	typedef std::pair<NodeIndex, NodeIndex> Edge;
+	// A copy edge to propagate, as (target node, index of the source node in the current round)
+	typedef std::pair<NodeIndex, unsigned> Propagation;
+
+	// Below this many nodes per thread, a round is not worth spawning threads for
+	static const unsigned MinNodesPerThread = 64;
+
+	unsigned numThreads;
+	AndersNodeFactory& nodeFactory;
+	ConstraintGraph& constraintGraph;
+	AndersPtsGraph& ptsGraph;
+	AndersPtsGraph& prevPtsGraph;
+	OfflineCycleDetector& offlineInfo;
+	IndirectCallResolver& callResolver;
+
+	// The set of nodes that LCD believes might be on a cycle
+	DenseSet<NodeIndex> cycleCandidates;
+	// The set of edges that LCD believes not on a cycle
+	DenseSet<Edge> checkedEdges;
+	// The cycles to collapse are looked for among the cycle candidates, and the collapsed nodes are put back on the worklist
+	std::vector<NodeIndex> revisitNodes;
+	OnlineCycleDetector cycleDetector;
+	uint64_t numVisits;
+	// The merge targets of the nodes while the solver runs
+	AndersConcurrentUnionFind mergeTargets;
+
+	// The nodes processed in the current round, along with their full pts-to set and the part of it that is new since their last visit
+	std::vector<NodeIndex> nodes;
+	std::vector<AndersPtsSet> fullSets, deltaSets;
+
+	// Turn the raw worklist into the list of distinct representatives that have something new to propagate
+	void collectRoundNodes(const std::vector<NodeIndex>& workList, std::vector<NodeIndex>& nextList)
+	{
+		DenseSet<NodeIndex> seen;
+		std::vector<NodeIndex> candidates;
+		for (auto node: workList)
+		{
+			node = nodeFactory.getMergeTarget(node);
+			if (!seen.insert(node).second)
+				continue;
+
+			if (constraintGraph.getNodeWithIndex(node) == nullptr)
+				continue;
+			if (ptsGraph[node].isEmpty())
+				continue;
+
+			if (EnableHCD)
+			{
+				NodeIndex rep = collapseOfflineCycle(node, ptsGraph[node], offlineInfo, nodeFactory, ptsGraph, prevPtsGraph, constraintGraph, nextList);
+				if (rep != node)
+				{
+					nextList.push_back(rep);
+					continue;
+				}
+			}
+
+			candidates.push_back(node);
+		}
+
+		// HCD may have merged some of the nodes we've already picked
+		seen.clear();
+		for (auto node: candidates)
+		{
+			node = nodeFactory.getMergeTarget(node);
+			if (!seen.insert(node).second || constraintGraph.getNodeWithIndex(node) == nullptr)
+				continue;
+
+			const AndersPtsSet& ptsSet = ptsGraph[node];
+			AndersPtsSet deltaSet = ptsSet.getDifference(prevPtsGraph[node]);
+			if (deltaSet.isEmpty())
+				continue;
+			prevPtsGraph[node] = ptsSet;
+
+			nodes.push_back(node);
+			fullSets.push_back(ptsSet);
+			deltaSets.push_back(deltaSet);
+		}
+	}
+
+	void runRound(std::vector<NodeIndex>& nextList)
+	{
+		unsigned roundThreads = std::max(1u, std::min(numThreads, static_cast<unsigned>(nodes.size() / MinNodesPerThread)));
+		NumNodeVisits += nodes.size();
+		numVisits += nodes.size();
+
+		// Step 1: check indirect constraints and find the copy edges they imply. Only the new pointees can imply new edges. The field nodes reached through gep edges are collected as well
+		std::vector<std::vector<Edge>> newEdges(roundThreads);
+		std::vector<std::vector<std::pair<NodeIndex, AndersPtsSet>>> gepUpdates(roundThreads);
+		runOnThreads(roundThreads, [&](unsigned tid)
+		{
+			std::vector<Edge>& edges = newEdges[tid];
+			for (size_t i = tid, e = nodes.size(); i < e; i += roundThreads)
+			{
+				const ConstraintGraphNode* cNode = constraintGraph.getNodeWithIndex(nodes[i]);
+				for (auto const& gep: cNode->geps())
+					gepUpdates[tid].push_back(std::make_pair(nodeFactory.getMergeTarget(gep.first), getGEPTargets(nodeFactory, deltaSets[i], gep.second)));
+				for (auto v: deltaSets[i])
+				{
+					NodeIndex vRep = nodeFactory.getMergeTarget(v);
+					for (auto const& dst: cNode->loads())
+						edges.push_back(Edge(vRep, nodeFactory.getMergeTarget(dst)));
+					for (auto const& dst: cNode->stores())
+						edges.push_back(Edge(nodeFactory.getMergeTarget(dst), vRep));
+				}
+			}
+		});
+		// A new copy edge has missed everything its source propagated before, so it gets the whole pts-to set of its source right away
+		for (auto const& edges: newEdges)
+		{
+			for (auto const& edge: edges)
+			{
+				if (constraintGraph.insertCopyEdge(edge.first, edge.second) && ptsGraph[edge.second].unionWith(ptsGraph[edge.first]))
+					nextList.push_back(edge.second);
+			}
+		}
+		newEdges.clear();
+		for (auto const& updates: gepUpdates)
+		{
+			for (auto const& update: updates)
+			{
+				if (ptsGraph[update.first].unionWith(update.second))
+					nextList.push_back(update.first);
+			}
+		}
+		gepUpdates.clear();
+		// The new pointees of the called pointers may be new targets of their calls
+		for (size_t i = 0, e = nodes.size(); i < e; ++i)
+		{
+			for (auto call: constraintGraph.getNodeWithIndex(nodes[i])->calls())
+				callResolver.resolve(call, deltaSets[i], nextList);
+		}
+
+		// Step 2: bucket the copy edges by the owner of their target
+		std::vector<std::vector<std::vector<Propagation>>> buckets(roundThreads, std::vector<std::vector<Propagation>>(roundThreads));
+		runOnThreads(roundThreads, [&](unsigned tid)
+		{
+			for (size_t i = tid, e = nodes.size(); i < e; i += roundThreads)
+			{
+				NodeIndex node = nodes[i];
+				for (auto const& dst: *constraintGraph.getNodeWithIndex(node))
+				{
+					NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
+					if (tgtNode != node)
+						buckets[tid][tgtNode % roundThreads].push_back(Propagation(tgtNode, i));
+				}
+			}
+		});
+
+		// Step 3: propagate the deltas along the copy edges. Each thread only writes to the targets it owns
+		std::vector<std::vector<NodeIndex>> changedNodes(roundThreads);
+		std::vector<std::vector<Edge>> candidateEdges(roundThreads);
+		runOnThreads(roundThreads, [&](unsigned tid)
+		{
+			for (auto const& producerBuckets: buckets)
+			{
+				for (auto const& prop: producerBuckets[tid])
+				{
+					AndersPtsSet& tgtPtsSet = ptsGraph[prop.first];
+					if (tgtPtsSet.unionWith(deltaSets[prop.second]))
+						changedNodes[tid].push_back(prop.first);
+					else if (EnableLCD && fullSets[prop.second] == tgtPtsSet)
+						candidateEdges[tid].push_back(Edge(nodes[prop.second], prop.first));
+				}
+			}
+		});
+
+		for (auto const& changed: changedNodes)
+			nextList.insert(nextList.end(), changed.begin(), changed.end());
+		// This is where we do lazy cycle detection: add the cycle candidates whose edge has not been cycle-checked previously
+		for (auto const& edges: candidateEdges)
+		{
+			for (auto const& edge: edges)
+			{
+				if (checkedEdges.insert(edge).second)
+					cycleCandidates.insert(edge.second);
+			}
+		}
+	}
+
+public:
+	ParallelSolver(unsigned t, AndersNodeFactory& n, ConstraintGraph& c, AndersPtsGraph& p, AndersPtsGraph& pp, OfflineCycleDetector& o, IndirectCallResolver& r): numThreads(t), nodeFactory(n), constraintGraph(c), ptsGraph(p), prevPtsGraph(pp), offlineInfo(o), callResolver(r), cycleDetector(n, c, p, pp, cycleCandidates, revisitNodes), numVisits(0), mergeTargets(n.getNumNodes()) {}
+
+	uint64_t getNumVisits() const { return numVisits; }
+
+	void run(std::vector<NodeIndex> workList)
+	{
+		nodeFactory.beginConcurrentMerges(mergeTargets);
+		std::vector<NodeIndex> nextList;
+		while (!workList.empty())
+		{
+			// First we've got to check if there is any cycle candidates in the last round. If there is, detect and collapse cycle
+			if (EnableLCD && !cycleCandidates.empty())
+			{
+				cycleDetector.run();
+				cycleCandidates.clear();
+				workList.insert(workList.end(), revisitNodes.begin(), revisitNodes.end());
+				revisitNodes.clear();
+			}
+
+			collectRoundNodes(workList, nextList);
+			runRound(nextList);
+
+			workList.swap(nextList);
+			nextList.clear();
+			nodes.clear();
+			fullSets.clear();
+			deltaSets.clear();
+		}
+		nodeFactory.endConcurrentMerges();
+	}
+};
+
+// Collapse every cycle of copy edges, and list the remaining representatives in postorder. Tarjan's algorithm completes an SCC only after all the SCCs it reaches, so the reverse of that list is a topological order of the acyclic graph that is left
+class WaveCycleDetector: public CycleDetector<ConstraintGraph>
+{
+private:
+	AndersNodeFactory& nodeFactory;
+	ConstraintGraph& constraintGraph;
+	AndersPtsGraph& ptsGraph;
+	AndersPtsGraph& prevPtsGraph;
+	// The collapsed nodes that have something left to propagate
+	std::vector<NodeIndex>& pendingNodes;
+	std::vector<NodeIndex> postOrder;
+
+	NodeType* getRep(NodeIndex idx) override
+	{
+		return constraintGraph.getOrInsertNode(nodeFactory.getMergeTarget(idx));
+	}
+	void processNodeOnCycle(const NodeType* node, const NodeType* repNode) override
+	{
+		NodeIndex repIdx = nodeFactory.getMergeTarget(repNode->getNodeIndex());
+		if (collapseNodes(repIdx, nodeFactory.getMergeTarget(node->getNodeIndex()), nodeFactory, ptsGraph, prevPtsGraph, constraintGraph))
+			pendingNodes.push_back(repIdx);
+	}
+	void processCycleRepNode(const NodeType* node) override
+	{
+		// A node without any outgoing edge has nothing to propagate
+		if (!node->isEmpty())
+			postOrder.push_back(node->getNodeIndex());
+	}
+public:
+	WaveCycleDetector(AndersNodeFactory& n, ConstraintGraph& c, AndersPtsGraph& p, AndersPtsGraph& pp, std::vector<NodeIndex>& pn): nodeFactory(n), constraintGraph(c), ptsGraph(p), prevPtsGraph(pp), pendingNodes(pn) {}
+
+	void run() override
+	{
+		postOrder.clear();
+		runOnGraph(&constraintGraph);
+		resetSCCState();
+	}
+
+	const std::vector<NodeIndex>& getPostOrder() const { return postOrder; }
+};
+
+// The wave propagation solver described in "Wave Propagation and Deep Propagation for Pointer Analysis. In Code Generation and Optimization (CGO), March 2009." Each round:
+// - collapses every cycle of copy edges, so that the copy graph is acyclic, and orders it topologically;
+// - propagates the new part of every pts-to set along the copy and gep edges in that order. A node has received the deltas of all its predecessors before it passes its own on, hence every node is visited at most once per round;
+// - resolves the load/store constraints and the indirect calls with the deltas of the round. The copy edges they add are propagated by the next round.
+// The rounds go on until no pts-to set has anything left to propagate. LCD is useless here since every cycle is collapsed as soon as it exists, but HCD still applies
+class WaveSolver
+{
+private:
+	AndersNodeFactory& nodeFactory;
+	ConstraintGraph& constraintGraph;
+	AndersPtsGraph& ptsGraph;
+	AndersPtsGraph& prevPtsGraph;
+	OfflineCycleDetector& offlineInfo;
+	IndirectCallResolver& callResolver;
+
+	// The nodes whose pts-to set has grown during the current round. The solver is done when none of them has anything left to propagate
+	std::vector<NodeIndex> pendingNodes;
+	WaveCycleDetector cycleDetector;
+	// The nodes visited by the current wave, along with the part of their pts-to set that is new since the previous round
+	std::vector<std::pair<NodeIndex, AndersPtsSet>> deltas;
+	uint64_t numVisits;
+
+	void propagateWave()
+	{
+		auto const& postOrder = cycleDetector.getPostOrder();
+		for (auto itr = postOrder.rbegin(), ite = postOrder.rend(); itr != ite; ++itr)
+		{
+			// HCD may have merged the node earlier in this wave
+			NodeIndex node = nodeFactory.getMergeTarget(*itr);
+			ConstraintGraphNode* cNode = constraintGraph.getNodeWithIndex(node);
+			if (cNode == nullptr)
+				continue;
+			const AndersPtsSet& ptsSet = ptsGraph[node];
+			if (ptsSet.isEmpty())
+				continue;
+
+			if (EnableHCD)
+			{
+				NodeIndex ctRep = collapseOfflineCycle(node, ptsSet, offlineInfo, nodeFactory, ptsGraph, prevPtsGraph, constraintGraph, pendingNodes);
+				// The merged node may come before the current one in the order: leave it to the next round
+				if (ctRep != node)
+				{
+					pendingNodes.push_back(ctRep);
+					continue;
+				}
+			}
+
+			AndersPtsSet deltaSet = ptsSet.getDifference(prevPtsGraph[node]);
+			if (deltaSet.isEmpty())
+				continue;
+			prevPtsGraph[node] = ptsSet;
+			++NumNodeVisits;
+			++numVisits;
+
+			for (auto const& dst: *cNode)
+			{
+				NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
+				if (tgtNode != node && ptsGraph[tgtNode].unionWith(deltaSet))
+					pendingNodes.push_back(tgtNode);
+			}
+			for (auto const& gep: cNode->geps())
+			{
+				NodeIndex tgtNode = nodeFactory.getMergeTarget(gep.first);
+				if (ptsGraph[tgtNode].unionWith(getGEPTargets(nodeFactory, deltaSet, gep.second)))
+					pendingNodes.push_back(tgtNode);
+			}
+
+			deltas.push_back(std::make_pair(node, deltaSet));
+		}
+	}
+
+	void resolveComplexConstraints()
+	{
+		for (auto const& entry: deltas)
+		{
+			// The node may have been merged after its visit, and its constraints along with it
+			NodeIndex node = nodeFactory.getMergeTarget(entry.first);
+			const ConstraintGraphNode* cNode = constraintGraph.getNodeWithIndex(node);
+			const AndersPtsSet& deltaSet = entry.second;
+
+			for (auto call: cNode->calls())
+				callResolver.resolve(call, deltaSet, pendingNodes);
+
+			// A new copy edge has missed everything its source propagated before, so it gets the whole pts-to set of its source right away
+			for (auto v: deltaSet)
+			{
+				NodeIndex vRep = nodeFactory.getMergeTarget(v);
+				for (auto const& dst: cNode->loads())
+				{
+					NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
+					if (constraintGraph.insertCopyEdge(vRep, tgtNode) && ptsGraph[tgtNode].unionWith(ptsGraph[vRep]))
+						pendingNodes.push_back(tgtNode);
+				}
+				for (auto const& dst: cNode->stores())
+				{
+					NodeIndex srcNode = nodeFactory.getMergeTarget(dst);
+					if (constraintGraph.insertCopyEdge(srcNode, vRep) && ptsGraph[vRep].unionWith(ptsGraph[srcNode]))
+						pendingNodes.push_back(vRep);
+				}
+			}
+		}
+		deltas.clear();
+	}
+
+	// Every wave visits all the nodes, so a node that has not grown during the round has nothing left to propagate
+	bool hasPendingNodes()
+	{
+		bool pending = false;
+		for (auto node: pendingNodes)
+		{
+			node = nodeFactory.getMergeTarget(node);
+			if (constraintGraph.getNodeWithIndex(node) != nullptr && !(ptsGraph[node] == prevPtsGraph[node]))
+			{
+				pending = true;
+				break;
+			}
+		}
+		pendingNodes.clear();
+		return pending;
+	}
+public:
+	WaveSolver(AndersNodeFactory& n, ConstraintGraph& c, AndersPtsGraph& p, AndersPtsGraph& pp, OfflineCycleDetector& o, IndirectCallResolver& r): nodeFactory(n), constraintGraph(c), ptsGraph(p), prevPtsGraph(pp), offlineInfo(o), callResolver(r), cycleDetector(n, c, p, pp, pendingNodes), numVisits(0) {}
+
+	uint64_t getNumVisits() const { return numVisits; }
+
+	void run()
+	{
+		do
+		{
+			++NumWaveRounds;
+			cycleDetector.run();
+			propagateWave();
+			resolveComplexConstraints();
+		} while (hasPendingNodes());
 	}
 };
 
@@ -495,33 +1318,114 @@ public:
 /// cycle detect them all at the same time to do this more cheaply.  This
 /// catches cycles slightly later than the original technique did, but does it
 /// make significantly cheaper.
+///
+/// Points-to info is propagated by difference: every node remembers in
+/// prevPtsGraph the part of its points-to set that its successors have
+/// already received, and a visit only pushes (and resolves load/store
+/// constraints for) what has been added since.
+///
+/// The sequential solver visits the nodes of each iteration in the order set
+/// by -anders-worklist: plain FIFO (the default), least recently fired first,
+/// or topological order of the copy edges. The topological order is computed
+/// before the first iteration and again only after cycles were collapsed: the
+/// copy edges added by the load/store constraints in between may leave it
+/// slightly off, which costs visits but not precision.
+///
+/// The targets of the indirect calls collected in indirectCalls are resolved
+/// as the called pointers get new pointees (see IndirectCallResolver).
+///
+/// If seedPtsGraph is set (-anders-incremental, and the discovery rounds of
+/// -anders-reachable-only), it is a solution of all the constraints but
+/// newConstraints, and only what newConstraints add to it is propagated (see
+/// seedSolution()).
+///
+/// With -anders-threads=N (N > 1), the worklist is processed by the
+/// bulk-synchronous ParallelSolver instead.
+///
+/// With -anders-solver=wave, the WaveSolver replaces the worklist altogether.
+///
+/// With -anders-solver=unification, the AndersUnificationSolver replaces the
+/// inclusion constraints by unifications (see UnificationSolver.h).
 void Andersen::solveConstraints()
 {
+	if (SolverAlgorithm == SolverKind::Unification)
+	{
+		AndersUnificationSolver solver(nodeFactory, indirectCalls, indirectCallTargets);
+		solver.run(constraints, seedPtsGraph, ptsGraph);
+		constraints.clear();
+		seedPtsGraph.clear();
+		newConstraints.clear();
+		// A unification is the closest thing to a node visit
+		numNodeVisits += solver.getNumUnions();
+		return;
+	}
+
 	// We'll do offline HCD first
 	OfflineCycleDetector offlineInfo(constraints, nodeFactory);
 	if (EnableHCD)
 		offlineInfo.run();
 
 	// Now build the constraint graph
-	ConstraintGraph constraintGraph;
-	buildConstraintGraph(constraintGraph, constraints, nodeFactory, ptsGraph);
+	ConstraintGraph constraintGraph(nodeFactory.getNumNodes());
+	buildConstraintGraph(constraintGraph, constraints, indirectCalls, nodeFactory, ptsGraph);
 	// The constraint vector is useless now
 	constraints.clear();
 
+	// The part of each pts-to set that has already been pushed along the copy edges and checked against the load/store constraints
+	AndersPtsGraph prevPtsGraph(ptsGraph.size());
+	IndirectCallResolver callResolver(indirectCalls, indirectCallTargets, nodeFactory, constraintGraph, ptsGraph);
+	if (!seedPtsGraph.empty())
+		seedSolution(seedPtsGraph, newConstraints, nodeFactory, constraintGraph, ptsGraph, prevPtsGraph, callResolver);
+	newConstraints.clear();
+
+	if (SolverAlgorithm == SolverKind::Wave)
+	{
+		WaveSolver solver(nodeFactory, constraintGraph, ptsGraph, prevPtsGraph, offlineInfo, callResolver);
+		solver.run();
+		numNodeVisits += solver.getNumVisits();
+		return;
+	}
+
+	if (SolverThreads > 1)
+	{
+		std::vector<NodeIndex> workList;
+		for (NodeIndex node = 0, e = ptsGraph.size(); node < e; ++node)
+		{
+			if (nodeFactory.getMergeTarget(node) == node && constraintGraph.getNodeWithIndex(node) != nullptr && !(ptsGraph[node] == prevPtsGraph[node]))
+				workList.push_back(node);
+		}
+
+		ParallelSolver solver(SolverThreads, nodeFactory, constraintGraph, ptsGraph, prevPtsGraph, offlineInfo, callResolver);
+		solver.run(std::move(workList));
+		numNodeVisits += solver.getNumVisits();
+		return;
+	}
+
+	// The worklist priority of each node: the time of its last visit with -anders-worklist=lrf, its topological rank with -anders-worklist=topo
+	std::vector<unsigned> priority(ptsGraph.size(), 0);
+	// The number of collapsed nodes when the topological order was last computed
+	unsigned topoOrderMerges = 0;
+	if (WorkListOrdering == WorkListOrder::Topo)
+		computeTopoOrder(constraintGraph, nodeFactory, priority);
+	unsigned numVisits = 0;
 	// We switch between two work lists instead of relying on only one work list
-	AndersWorkList workList1, workList2;
+	AndersWorkList workList1(WorkListOrdering, priority), workList2(WorkListOrdering, priority);
 	// The "current" and the "next" work list
 	AndersWorkList *currWorkList = &workList1, *nextWorkList = &workList2;
 	// The set of nodes that LCD believes might be on a cycle
 	DenseSet<NodeIndex> cycleCandidates;
 	// The set of edges that LCD believes not on a cycle
 	DenseSet<std::pair<NodeIndex, NodeIndex>> checkedEdges;
-
-	// Scan the node list, add it to work list if the node a representative and can contribute to the calculation right now.
-	for (auto const& mapping: ptsGraph)
+	// The collapsed nodes that have to be visited again
+	std::vector<NodeIndex> revisitNodes;
+	OnlineCycleDetector cycleDetector(nodeFactory, constraintGraph, ptsGraph, prevPtsGraph, cycleCandidates, revisitNodes);
+	// The nodes that the indirect calls resolved during a visit have changed
+	std::vector<NodeIndex> callChangedNodes;
+
+	// Scan the node list, add it to work list if the node a representative and can contribute to the calculation right now: it has pointees that it has not propagated yet, which are all of them unless we start from a seed
+	for (NodeIndex node = 0, e = ptsGraph.size(); node < e; ++node)
 	{
-		NodeIndex node = mapping.first;
-		if (nodeFactory.getMergeTarget(node) == node && constraintGraph.getNodeWithIndex(node) != nullptr)
+		if (nodeFactory.getMergeTarget(node) == node && constraintGraph.getNodeWithIndex(node) != nullptr && !(ptsGraph[node] == prevPtsGraph[node]))
 			currWorkList->enqueue(node);
 	}
 
@@ -533,9 +1437,22 @@ void Andersen::solveConstraints()
 		if (EnableLCD && !cycleCandidates.empty())
 		{
 			// Detect and collapse cycles online
-			OnlineCycleDetector cycleDetector(nodeFactory, constraintGraph, ptsGraph, cycleCandidates);
 			cycleDetector.run();
 			cycleCandidates.clear();
+
+			for (auto rep: revisitNodes)
+				currWorkList->enqueue(rep);
+			revisitNodes.clear();
+		}
+
+		// The nodes fired during the last iteration have changed their LRF priorities, and the cycles collapsed since the last topological order have made it stale
+		if (WorkListOrdering == WorkListOrder::LRF)
+			currWorkList->reorder();
+		else if (WorkListOrdering == WorkListOrder::Topo && constraintGraph.getNumMerges() != topoOrderMerges)
+		{
+			computeTopoOrder(constraintGraph, nodeFactory, priority);
+			topoOrderMerges = constraintGraph.getNumMerges();
+			currWorkList->reorder();
 		}
 
 		while (!currWorkList->isEmpty())
@@ -548,47 +1465,44 @@ void Andersen::solveConstraints()
 			if (cNode == nullptr)
 				continue;
 
-			auto ptsItr = ptsGraph.find(node);
-			if (ptsItr != ptsGraph.end())
-			{
-				// Check indirect constraints and add copy edge to the constraint graph if necessary
-				const AndersPtsSet& ptsSet = ptsItr->second;
+			++NumNodeVisits;
+			++numNodeVisits;
+			if (WorkListOrdering == WorkListOrder::LRF)
+				priority[node] = ++numVisits;
 
-				// This is where we perform HCD: check if node has a collapse target, and if it does, merge them immediately
+			// Check indirect constraints and add copy edge to the constraint graph if necessary
+			const AndersPtsSet& ptsSet = ptsGraph[node];
+			if (!ptsSet.isEmpty())
+			{
+				// This is where we perform HCD
 				if (EnableHCD)
 				{
-					NodeIndex collapseTarget = offlineInfo.getCollapseTarget(node);
-					if (collapseTarget != AndersNodeFactory::InvalidIndex)
+					NodeIndex ctRep = collapseOfflineCycle(node, ptsSet, offlineInfo, nodeFactory, ptsGraph, prevPtsGraph, constraintGraph, revisitNodes);
+					for (auto rep: revisitNodes)
+						nextWorkList->enqueue(rep);
+					revisitNodes.clear();
+					// If the node collapsing succeeds, we can't proceed here because node no longer exists. Push ctRep to the worklist and proceed
+					if (ctRep != node)
 					{
-						//errs() << "node = " << node << ", collapseTgt = " << collapseTarget << "\n";
-						NodeIndex ctRep = nodeFactory.getMergeTarget(collapseTarget);
-						// Here we have to pay special attention to whether the node points-to itself.
-						bool mergeSelf = false;
-						for (auto v: ptsSet)
-						{
-							NodeIndex vRep = nodeFactory.getMergeTarget(v);
-							if (vRep == node)
-							{
-								mergeSelf = true;
-								continue;
-							}
-							collapseNodes(ctRep, vRep, nodeFactory, ptsGraph, constraintGraph);
-						}
-
-						if (mergeSelf)
-						{
-							collapseNodes(ctRep, node, nodeFactory, ptsGraph, constraintGraph);
-							// If the node collapsing succeeds, we can't proceed here because node no longer exists. Push ctRep to the worklist and proceed
-							if (ctRep != node)
-							{
-								nextWorkList->enqueue(ctRep);
-								continue;
-							}
-						}
+						nextWorkList->enqueue(ctRep);
+						continue;
 					}
 				}
 
-				for (auto v: ptsSet)
+				// Only the pointees added since the last visit are new to the successors and to the load/store constraints
+				AndersPtsSet deltaSet = ptsSet.getDifference(prevPtsGraph[node]);
+				if (deltaSet.isEmpty())
+					continue;
+				prevPtsGraph[node] = ptsSet;
+
+				// The new pointees may be new targets of the calls made through node
+				for (auto call: cNode->calls())
+					callResolver.resolve(call, deltaSet, callChangedNodes);
+				for (auto changed: callChangedNodes)
+					nextWorkList->enqueue(changed);
+				callChangedNodes.clear();
+
+				for (auto v: deltaSet)
 				{
 					DenseMap<NodeIndex, NodeIndex> updateMap;
 
@@ -597,10 +1511,11 @@ void Andersen::solveConstraints()
 					{
 						NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
 						//errs() << "Examining load edge " << node << " -> " << tgtNode << "\n";
-						if (constraintGraph.insertCopyEdge(vRep, tgtNode))
+						// A new copy edge has missed everything its source propagated before, so it gets the whole pts-to set of its source right away
+						if (constraintGraph.insertCopyEdge(vRep, tgtNode) && ptsGraph[tgtNode].unionWith(ptsGraph[vRep]))
 						{
 							//errs() << "\tInsert copy edge " << v << " -> " << tgtNode << "\n";
-							nextWorkList->enqueue(vRep);
+							nextWorkList->enqueue(tgtNode);
 						}
 
 						// If we find that dst has been merged to elsewhere, remember this fact to update the constraint graph later
@@ -616,10 +1531,10 @@ void Andersen::solveConstraints()
 					for (auto const& dst: cNode->stores())
 					{
 						NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
-						if (constraintGraph.insertCopyEdge(tgtNode, vRep))
+						if (constraintGraph.insertCopyEdge(tgtNode, vRep) && ptsGraph[vRep].unionWith(ptsGraph[tgtNode]))
 						{
 							//errs() << "\tInsert copy edge " << tgtNode << " -> " << v << "\n";
-							nextWorkList->enqueue(tgtNode);
+							nextWorkList->enqueue(vRep);
 						}
 
 						// If we find that dst has been merged to elsewhere, remember this fact to update the constraint graph later
@@ -632,6 +1547,14 @@ void Andersen::solveConstraints()
 						cNode->replaceStoreEdge(mapping.first, mapping.second);
 				}
 
+				// Gep edges point their target to the corresponding fields of the new pointees
+				for (auto const& gep: cNode->geps())
+				{
+					NodeIndex tgtNode = nodeFactory.getMergeTarget(gep.first);
+					if (ptsGraph[tgtNode].unionWith(getGEPTargets(nodeFactory, deltaSet, gep.second)))
+						nextWorkList->enqueue(tgtNode);
+				}
+
 				DenseMap<NodeIndex, NodeIndex> updateMap;
 				// Finally, it's time to propagate pts-to info along the copy edges
 				for (auto const& dst: *cNode)
@@ -642,7 +1565,7 @@ void Andersen::solveConstraints()
 					AndersPtsSet& tgtPtsSet = ptsGraph[tgtNode];
 					
 					//errs() << "pts[" << tgtNode << "] |= pts[" << node << "]\n";
-					bool isChanged =  tgtPtsSet.unionWith(ptsSet);
+					bool isChanged =  tgtPtsSet.unionWith(deltaSet);
 
 					if (isChanged)
 					{
@@ -673,3 +1596,113 @@ void Andersen::solveConstraints()
 		std::swap(currWorkList, nextWorkList);
 	}
 }
+
+namespace {
+
+const char* getSolverName(SolverKind kind)
+{
+	switch (kind)
+	{
+		case SolverKind::WorkList:
+			return "worklist";
+		case SolverKind::Wave:
+			return "wave";
+		case SolverKind::Unification:
+			return "unification";
+	}
+	return "?";
+}
+
+}	// end of anonymous namespace
+
+// The number of regions each pointer may point to, as getPointsToSet() reports them: the distinct values of the pointees, null aside. InvalidIndex for the nodes that are not the pointer of a value
+void Andersen::countRegionsPerPointer(std::vector<unsigned>& counts) const
+{
+	counts.assign(nodeFactory.getNumNodes(), AndersNodeFactory::InvalidIndex);
+	// The nodes of a merged set share their pts-to set, so it is only counted once
+	std::vector<unsigned> repCounts(nodeFactory.getNumNodes(), AndersNodeFactory::InvalidIndex);
+	for (NodeIndex n = 0, e = nodeFactory.getNumNodes(); n < e; ++n)
+	{
+		if (nodeFactory.isObjectNode(n) || nodeFactory.getValueForNode(n) == nullptr || n == nodeFactory.getUniversalPtrNode())
+			continue;
+
+		NodeIndex rep = nodeFactory.getMergeTarget(n);
+		if (repCounts[rep] == AndersNodeFactory::InvalidIndex)
+		{
+			unsigned count = 0;
+			const Value* last = nullptr;
+			for (auto v: ptsGraph[rep])
+			{
+				const Value* val = nodeFactory.getValueForNode(v);
+				if (v == nodeFactory.getNullObjectNode() || val == nullptr || val == last)
+					continue;
+				last = val;
+				++count;
+			}
+			repCounts[rep] = count;
+		}
+		counts[n] = repCounts[rep];
+	}
+}
+
+/// solveAndCompareConstraints - Solve the constraints (see solveConstraints())
+/// and, on a copy of the constraints and of the node merges, with the
+/// unification solver, or with the worklist solver if unification is the
+/// selected one. Only the solution of the selected solver is kept. The report
+/// gives the time and the number of regions per pointer of both: the warnings
+/// of PARCOACH follow from the regions.
+void Andersen::solveAndCompareConstraints()
+{
+	SolverKind selected = SolverAlgorithm;
+	SolverKind other = selected == SolverKind::Unification ? SolverKind::WorkList : SolverKind::Unification;
+
+	std::vector<AndersConstraint> savedConstraints(constraints);
+	AndersNodeFactory savedNodeFactory(nodeFactory);
+	AndersPtsGraph savedSeeds(seedPtsGraph);
+	std::vector<AndersConstraint> savedNewConstraints(newConstraints);
+	uint64_t savedNumNodeVisits = numNodeVisits;
+
+	SolverAlgorithm = other;
+	auto otherStart = std::chrono::steady_clock::now();
+	solveConstraints();
+	double otherTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - otherStart).count();
+	SolverAlgorithm = selected;
+	std::vector<unsigned> otherCounts;
+	countRegionsPerPointer(otherCounts);
+
+	constraints.swap(savedConstraints);
+	nodeFactory = std::move(savedNodeFactory);
+	seedPtsGraph.swap(savedSeeds);
+	newConstraints.swap(savedNewConstraints);
+	numNodeVisits = savedNumNodeVisits;
+
+	auto selectedStart = std::chrono::steady_clock::now();
+	solveConstraints();
+	double selectedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - selectedStart).count();
+	std::vector<unsigned> selectedCounts;
+	countRegionsPerPointer(selectedCounts);
+
+	unsigned numPointers = 0, numCoarser = 0, numFiner = 0;
+	uint64_t selectedTotal = 0, otherTotal = 0;
+	unsigned selectedMax = 0, otherMax = 0;
+	for (NodeIndex n = 0, e = selectedCounts.size(); n < e; ++n)
+	{
+		if (selectedCounts[n] == AndersNodeFactory::InvalidIndex)
+			continue;
+		++numPointers;
+		selectedTotal += selectedCounts[n];
+		otherTotal += otherCounts[n];
+		selectedMax = std::max(selectedMax, selectedCounts[n]);
+		otherMax = std::max(otherMax, otherCounts[n]);
+		if (otherCounts[n] > selectedCounts[n])
+			++numCoarser;
+		else if (otherCounts[n] < selectedCounts[n])
+			++numFiner;
+	}
+
+	double divisor = numPointers == 0 ? 1 : numPointers;
+	errs() << "Andersen solver comparison over " << numPointers << " pointers:\n";
+	errs() << format("  %-12s %10.3f s, %8.2f regions per pointer on average, %u at most\n", getSolverName(selected), selectedTime, selectedTotal / divisor, selectedMax);
+	errs() << format("  %-12s %10.3f s, %8.2f regions per pointer on average, %u at most\n", getSolverName(other), otherTime, otherTotal / divisor, otherMax);
+	errs() << "  " << numCoarser << " pointers have more regions and " << numFiner << " fewer with " << getSolverName(other) << "\n";
+}
@@ -2,16 +2,17 @@
 #define ANDERSEN_CYCLEDETECTOR_H
 
 #include "GraphTraits.h"
+#include "NodeFactory.h"
 
-#include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/GraphTraits.h"
 
-#include <deque>
-#include <stack>
+#include <algorithm>
+#include <vector>
 
 // An abstract base class that offers the functionality of detecting SCC in a graph
 // Any concreate class that does cycle detection should inherit from this class, specifiy the GraphType, and implement all the abstract virtual functions
+// The DFS is iterative, so that the long copy chains of generated code cannot overflow the call stack, and its state lives in vectors indexed by NodeIndex rather than in hash maps. As in Pearce's space-efficient algorithm, a single number per node serves as both its DFS number and its lowlink
 template <class GraphType>
 class CycleDetector
 {
@@ -21,56 +22,114 @@ public:
 	typedef typename GraphTraits::NodeIterator node_iterator;
 	typedef typename GraphTraits::ChildIterator child_iterator;
 private:
+	// A node whose successors are being walked
+	struct DFSFrame
+	{
+		NodeType* node;
+		// The DFS number of node. The node is the root of an SCC iff its lowlink is still equal to it once all its successors are done
+		unsigned timestamp;
+		child_iterator itr, ite;
+	};
+
 	// The SCC stack
-	std::stack<const NodeType*> sccStack;
-	// Map from NodeIndex to DFS number. Nodes that are not in the map are never visited
-	llvm::DenseMap<const NodeType*, unsigned> dfsNum;
+	std::vector<const NodeType*> sccStack;
+	// The DFS stack, in place of the call stack of a recursive DFS
+	std::vector<DFSFrame> dfsStack;
+	// Map from NodeIndex to lowlink. 0 means that the node is never visited
+	std::vector<unsigned> dfsNum;
 	// The "inComponent" array in Nutilla's improved SCC algorithm
-	llvm::DenseSet<const NodeType*> inComponent;
+	llvm::BitVector inComponent;
+	// The nodes visited so far, so that the state can be reset without walking the whole index space
+	std::vector<NodeIndex> visitedNodes;
 	// DFS timestamp
 	unsigned timestamp;
 
-	// visiting each node and perform some task
-	void visit(NodeType* node)
+	bool isVisited(NodeIndex idx) const
 	{
-		unsigned myTimeStamp = timestamp++;
-		assert(!dfsNum.count(node) && "Revisit the same node again?");
-		dfsNum[node] = myTimeStamp;
+		return idx < dfsNum.size() && dfsNum[idx] != 0;
+	}
 
-		// Traverse succecessor edges
-		for (auto childItr = GraphTraits::child_begin(node), childIte = GraphTraits::child_end(node); childItr != childIte; ++childItr)
+	void beginVisit(NodeType* node)
+	{
+		NodeIndex idx = node->getNodeIndex();
+		if (idx >= dfsNum.size())
 		{
-			NodeType* succRep = getRep(*childItr);
-			if (!dfsNum.count(succRep))
-				visit(succRep);
-
-			if (!inComponent.count(succRep) && dfsNum[node] > dfsNum[succRep])
-				dfsNum[node] = dfsNum[succRep];
+			// Grow geometrically: the indices of the nodes are not known in advance (e.g. REF and ADR nodes go past the node factory)
+			size_t newSize = std::max<size_t>(idx + 1, 2 * dfsNum.size());
+			dfsNum.resize(newSize, 0);
+			inComponent.resize(newSize);
 		}
+		assert(dfsNum[idx] == 0 && "Revisit the same node again?");
+		unsigned myTimeStamp = ++timestamp;
+		dfsNum[idx] = myTimeStamp;
+		visitedNodes.push_back(idx);
+		dfsStack.push_back(DFSFrame{node, myTimeStamp, GraphTraits::child_begin(node), GraphTraits::child_end(node)});
+	}
 
+	// The lowlink of node goes down to the one of succ, unless succ is already in a component
+	void updateLowLink(const NodeType* node, const NodeType* succ)
+	{
+		NodeIndex idx = node->getNodeIndex(), succIdx = succ->getNodeIndex();
+		if (!inComponent.test(succIdx) && dfsNum[idx] > dfsNum[succIdx])
+			dfsNum[idx] = dfsNum[succIdx];
+	}
+
+	// All the successors of node are done
+	void finishVisit(NodeType* node, unsigned myTimeStamp)
+	{
 		// See if we have any cycle detected
-		if (myTimeStamp != dfsNum[node])
+		if (myTimeStamp != dfsNum[node->getNodeIndex()])
 		{
 			// If not, push the sccStack and go on
-			sccStack.push(node);
+			sccStack.push_back(node);
 			return;
 		}
 
 		// Cycle detected
-		inComponent.insert(node);
+		inComponent.set(node->getNodeIndex());
 		while (!sccStack.empty())
 		{
-			const NodeType* cycleNode = sccStack.top();
-			if (dfsNum[cycleNode] < myTimeStamp)
+			const NodeType* cycleNode = sccStack.back();
+			if (dfsNum[cycleNode->getNodeIndex()] < myTimeStamp)
 				break;
 
 			processNodeOnCycle(cycleNode, node);
-			inComponent.insert(cycleNode);
-			sccStack.pop();
+			inComponent.set(cycleNode->getNodeIndex());
+			sccStack.pop_back();
 		}
 
 		processCycleRepNode(node);
 	}
+
+	// visiting each node reachable from root and perform some task
+	void visit(NodeType* root)
+	{
+		beginVisit(root);
+		while (!dfsStack.empty())
+		{
+			DFSFrame& top = dfsStack.back();
+			if (top.itr == top.ite)
+			{
+				NodeType* node = top.node;
+				unsigned myTimeStamp = top.timestamp;
+				dfsStack.pop_back();
+				finishVisit(node, myTimeStamp);
+				// Back in the parent, which has to take the lowlink of node into account
+				if (!dfsStack.empty())
+					updateLowLink(dfsStack.back().node, node);
+				continue;
+			}
+
+			// Traverse succecessor edges
+			NodeType* succRep = getRep(*top.itr);
+			++top.itr;
+			if (!isVisited(succRep->getNodeIndex()))
+				// top is invalidated here. The lowlink is updated when succRep is done
+				beginVisit(succRep);
+			else
+				updateLowLink(top.node, succRep);
+		}
+	}
 protected:
 	// Nodes may get merged during the analysis. This function returns the merge target (if the node is merged into another node) or the node itself (if the nodes has not been merged into another node)
 	virtual NodeType* getRep(NodeIndex node) = 0;
@@ -83,13 +142,17 @@ protected:
 	void runOnGraph(GraphType* graph)
 	{
 		assert(sccStack.empty() && "sccStack is not empty before cycle detection!");
-		assert(dfsNum.empty() && "dfsNum is not empty before cycle detection!");
-		assert(inComponent.empty() && "inComponent is not empty before cycle detection!");
+		assert(visitedNodes.empty() && "dfsNum is not empty before cycle detection!");
 
+		// Take a snapshot of the node list first: visit() may insert new nodes into the graph, and with a hash-based graph a rehash would make us skip part of the nodes
+		std::vector<NodeIndex> nodeList;
 		for (auto itr = GraphTraits::node_begin(graph), ite = GraphTraits::node_end(graph); itr != ite; ++itr)
+			nodeList.push_back(itr->getNodeIndex());
+
+		for (auto idx: nodeList)
 		{
-			NodeType* repNode = getRep(itr->getNodeIndex());
-			if (!dfsNum.count(repNode))
+			NodeType* repNode = getRep(idx);
+			if (!isVisited(repNode->getNodeIndex()))
 				visit(repNode);
 		}
 
@@ -102,16 +165,32 @@ protected:
 		assert(sccStack.empty() && "sccStack is not empty before cycle detection!");
 
 		NodeType* repNode = getRep(node);
-		if (!dfsNum.count(repNode))
+		if (!isVisited(repNode->getNodeIndex()))
 			visit(repNode);
 
 		assert(sccStack.empty() && "sccStack not empty after cycle detection!");
 	}
 
+	// Forget the visited nodes but keep the storage, for a detector that runs again on the same graph
+	void resetSCCState()
+	{
+		for (auto idx: visitedNodes)
+		{
+			dfsNum[idx] = 0;
+			inComponent.reset(idx);
+		}
+		visitedNodes.clear();
+		timestamp = 0;
+	}
+
 	void releaseSCCMemory()
 	{
-		dfsNum.clear();
+		std::vector<unsigned>().swap(dfsNum);
 		inComponent.clear();
+		std::vector<NodeIndex>().swap(visitedNodes);
+		std::vector<const NodeType*>().swap(sccStack);
+		std::vector<DFSFrame>().swap(dfsStack);
+		timestamp = 0;
 	}
 public:
 	CycleDetector(): timestamp(0) {}
@@ -0,0 +1,265 @@
+#include "DemandSolver.h"
+
+#include "llvm/ADT/Statistic.h"
+
+#include <algorithm>
+
+#define DEBUG_TYPE "andersen"
+
+using namespace llvm;
+
+STATISTIC(NumDemandQueries, "Number of demand-driven pts-to queries");
+STATISTIC(NumDemandEvaluations, "Number of rule evaluations of the demand-driven solver");
+
+template <typename T>
+void AndersDemandSolver::AdjacencyList<T>::build(unsigned numNodes, std::vector<std::pair<NodeIndex, T>>& edges)
+{
+	std::stable_sort(edges.begin(), edges.end(), [](const std::pair<NodeIndex, T>& a, const std::pair<NodeIndex, T>& b) { return a.first < b.first; });
+
+	begins.assign(numNodes + 1, 0);
+	targets.clear();
+	targets.reserve(edges.size());
+	for (auto const& edge: edges)
+	{
+		++begins[edge.first + 1];
+		targets.push_back(edge.second);
+	}
+	for (unsigned i = 0; i < numNodes; ++i)
+		begins[i + 1] += begins[i];
+
+	edges.clear();
+	edges.shrink_to_fit();
+}
+
+AndersDemandSolver::AndersDemandSolver(const std::vector<AndersConstraint>& constraints, const AndersNodeFactory& n, unsigned b): nodeFactory(n), budget(b), steps(0)
+{
+	std::vector<std::pair<NodeIndex, NodeIndex>> addrOfInEdges, addrOfOutEdges, copyInEdges, copyOutEdges, loadInEdges, loadOutEdges, storeInEdges, storeOutEdges;
+	std::vector<std::pair<NodeIndex, std::pair<NodeIndex, unsigned>>> gepInEdges, gepOutEdges;
+	for (auto const& c: constraints)
+	{
+		NodeIndex dest = c.getDest(), src = c.getSrc();
+		switch (c.getType())
+		{
+			case AndersConstraint::ADDR_OF:
+				addrOfInEdges.push_back(std::make_pair(dest, src));
+				addrOfOutEdges.push_back(std::make_pair(src, dest));
+				break;
+			case AndersConstraint::COPY:
+				copyInEdges.push_back(std::make_pair(dest, src));
+				copyOutEdges.push_back(std::make_pair(src, dest));
+				break;
+			case AndersConstraint::LOAD:
+				loadInEdges.push_back(std::make_pair(dest, src));
+				loadOutEdges.push_back(std::make_pair(src, dest));
+				break;
+			case AndersConstraint::STORE:
+				// storeIn goes from the pointer to the stored values, storeOut from a stored value to the pointers
+				storeInEdges.push_back(std::make_pair(dest, src));
+				storeOutEdges.push_back(std::make_pair(src, dest));
+				break;
+			case AndersConstraint::GEP:
+				gepInEdges.push_back(std::make_pair(dest, std::make_pair(src, c.getOffset())));
+				gepOutEdges.push_back(std::make_pair(src, std::make_pair(dest, c.getOffset())));
+				break;
+		}
+	}
+
+	unsigned numNodes = nodeFactory.getNumNodes();
+	addrOfIn.build(numNodes, addrOfInEdges);
+	addrOfOut.build(numNodes, addrOfOutEdges);
+	copyIn.build(numNodes, copyInEdges);
+	copyOut.build(numNodes, copyOutEdges);
+	loadIn.build(numNodes, loadInEdges);
+	loadOut.build(numNodes, loadOutEdges);
+	storeIn.build(numNodes, storeInEdges);
+	storeOut.build(numNodes, storeOutEdges);
+	gepIn.build(numNodes, gepInEdges);
+	gepOut.build(numNodes, gepOutEdges);
+}
+
+void AndersDemandSolver::enqueue(EntryKey key, Entry& entry)
+{
+	if (entry.queued)
+		return;
+	entry.queued = true;
+	workList.push_back(key);
+}
+
+const SparseBitVector<>& AndersDemandSolver::read(EntryKind kind, NodeIndex n, EntryKey reader)
+{
+	EntryKey key = makeKey(kind, n);
+	auto itr = entries.find(key);
+	if (itr == entries.end())
+	{
+		itr = entries.emplace(key, Entry()).first;
+		enqueue(key, itr->second);
+	}
+	itr->second.readers.insert(reader);
+	return itr->second.set;
+}
+
+// pointsTo(v) = { o | v = &o }
+//             U pointsTo(s) for v = s
+//             U pointsTo(a) for v = *p, a in pointsTo(p)
+//             U field(o, k) for v = s + k, o in pointsTo(s)
+//             U pointsTo(s) for *q = s, q in flowsTo(v)		(if v is an object)
+bool AndersDemandSolver::evaluatePointsTo(NodeIndex v, EntryKey key, SparseBitVector<>& result)
+{
+	for (auto itr = addrOfIn.begin(v), ite = addrOfIn.end(v); itr != ite; ++itr)
+		result.set(*itr);
+
+	for (auto itr = copyIn.begin(v), ite = copyIn.end(v); itr != ite; ++itr)
+		result |= read(POINTS_TO, *itr, key);
+
+	for (auto itr = loadIn.begin(v), ite = loadIn.end(v); itr != ite; ++itr)
+	{
+		for (auto a: read(POINTS_TO, *itr, key))
+		{
+			if (++steps > budget)
+				return false;
+			result |= read(POINTS_TO, a, key);
+		}
+	}
+
+	for (auto itr = gepIn.begin(v), ite = gepIn.end(v); itr != ite; ++itr)
+	{
+		unsigned offset = itr->second;
+		for (auto o: read(POINTS_TO, itr->first, key))
+		{
+			if (++steps > budget)
+				return false;
+			if (offset == AndersNodeFactory::UnknownOffset)
+			{
+				// We don't know which field we end up in, so it could be any of them
+				NodeIndex base = o - nodeFactory.getObjectOffset(o);
+				for (unsigned i = 0, e = nodeFactory.getObjectSize(o); i < e; ++i)
+					result.set(base + i);
+			}
+			else
+				result.set(nodeFactory.getFieldNode(o, offset));
+		}
+	}
+
+	if (nodeFactory.isObjectNode(v))
+	{
+		for (auto q: read(FLOWS_TO, v, key))
+		{
+			if (++steps > budget)
+				return false;
+			for (auto itr = storeIn.begin(q), ite = storeIn.end(q); itr != ite; ++itr)
+				result |= read(POINTS_TO, *itr, key);
+		}
+	}
+
+	return true;
+}
+
+// flowsTo(o) = { v | v = &o }
+//            U { w | w = v, v in flowsTo(o) }
+//            U { w | w = *p, p in flowsTo(a), a in flowsTo(o) }
+//            U { a | *q = v, v in flowsTo(o), a in pointsTo(q) }
+//            U { w | w = s + k, s in flowsTo(o'), o = field(o', k) }
+bool AndersDemandSolver::evaluateFlowsTo(NodeIndex o, EntryKey key, SparseBitVector<>& result)
+{
+	for (auto itr = addrOfOut.begin(o), ite = addrOfOut.end(o); itr != ite; ++itr)
+		result.set(*itr);
+
+	for (auto v: read(FLOWS_TO, o, key))
+	{
+		if (++steps > budget)
+			return false;
+		result.set(v);
+
+		for (auto itr = copyOut.begin(v), ite = copyOut.end(v); itr != ite; ++itr)
+			result.set(*itr);
+
+		if (nodeFactory.isObjectNode(v))
+		{
+			for (auto p: read(FLOWS_TO, v, key))
+			{
+				if (++steps > budget)
+					return false;
+				for (auto itr = loadOut.begin(p), ite = loadOut.end(p); itr != ite; ++itr)
+					result.set(*itr);
+			}
+		}
+
+		for (auto itr = storeOut.begin(v), ite = storeOut.end(v); itr != ite; ++itr)
+			result |= read(POINTS_TO, *itr, key);
+	}
+
+	// o may be reached through a gep on any field of its object
+	if (nodeFactory.isObjectNode(o))
+	{
+		NodeIndex base = o - nodeFactory.getObjectOffset(o);
+		for (unsigned i = 0, e = nodeFactory.getObjectSize(o); i < e; ++i)
+		{
+			for (auto s: read(FLOWS_TO, base + i, key))
+			{
+				if (++steps > budget)
+					return false;
+				for (auto itr = gepOut.begin(s), ite = gepOut.end(s); itr != ite; ++itr)
+				{
+					unsigned offset = itr->second;
+					if (offset == AndersNodeFactory::UnknownOffset || nodeFactory.getFieldNode(base + i, offset) == o)
+						result.set(itr->first);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+bool AndersDemandSolver::evaluate(EntryKey key)
+{
+	++NumDemandEvaluations;
+
+	NodeIndex n = static_cast<NodeIndex>(key);
+	SparseBitVector<> result;
+	bool finished;
+	if ((key >> 32) == POINTS_TO)
+		finished = evaluatePointsTo(n, key, result);
+	else
+		finished = evaluateFlowsTo(n, key, result);
+	if (!finished)
+		return false;
+
+	Entry& entry = entries[key];
+	if (entry.set |= result)
+	{
+		for (auto reader: entry.readers)
+			enqueue(reader, entries[reader]);
+	}
+	return true;
+}
+
+bool AndersDemandSolver::query(NodeIndex n, AndersPtsSet& ptsSet)
+{
+	++NumDemandQueries;
+
+	auto itr = results.find(n);
+	if (itr != results.end())
+	{
+		ptsSet = itr->second;
+		return true;
+	}
+
+	EntryKey key = makeKey(POINTS_TO, n);
+	if (entries.find(key) == entries.end())
+		enqueue(key, entries[key]);
+
+	steps = 0;
+	while (!workList.empty())
+	{
+		EntryKey next = workList.back();
+		workList.pop_back();
+		entries[next].queued = false;
+		if (!evaluate(next))
+			return false;
+	}
+
+	ptsSet = AndersPtsSet(entries[key].set);
+	results[n] = ptsSet;
+	return true;
+}
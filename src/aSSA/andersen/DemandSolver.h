@@ -0,0 +1,83 @@
+#ifndef ANDERSEN_DEMAND_SOLVER_H
+#define ANDERSEN_DEMAND_SOLVER_H
+
+#include "Constraint.h"
+#include "NodeFactory.h"
+#include "PtsSet.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SparseBitVector.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A demand-driven Andersen solver: it only computes the pts-to sets that the queries need, and remembers them for the next queries
+// A query is a reachability problem over two mutually dependent relations: pointsTo(v), the objects v points to, and flowsTo(o), the nodes that point to o. The stores into an object o are found through flowsTo(o), so that only the stores which may write o are looked at. Both relations are computed on demand, as the least fixed point of the entries demanded so far
+// Once a query is over, every entry it has demanded is exact. A query that takes more than its budget gives up, and the caller is expected to solve the whole program instead
+class AndersDemandSolver
+{
+private:
+	// Edges of one kind, grouped by their source node
+	template <typename T> class AdjacencyList
+	{
+	private:
+		std::vector<unsigned> begins;
+		std::vector<T> targets;
+	public:
+		void build(unsigned numNodes, std::vector<std::pair<NodeIndex, T>>& edges);
+
+		const T* begin(NodeIndex n) const { return targets.data() + begins[n]; }
+		const T* end(NodeIndex n) const { return targets.data() + begins[n + 1]; }
+	};
+	typedef AdjacencyList<NodeIndex> NodeList;
+	typedef AdjacencyList<std::pair<NodeIndex, unsigned>> GepList;
+
+	const AndersNodeFactory& nodeFactory;
+
+	// addrOf: v = &o, copy: v = s, load: v = *p, store: *q = s, gep: v = s + k. Each constraint is indexed both ways
+	NodeList addrOfIn, addrOfOut, copyIn, copyOut, loadIn, loadOut, storeIn, storeOut;
+	GepList gepIn, gepOut;
+
+	// An entry of either relation. The key is made of the relation and the node
+	enum EntryKind
+	{
+		POINTS_TO,
+		FLOWS_TO,
+	};
+	typedef uint64_t EntryKey;
+	struct Entry
+	{
+		llvm::SparseBitVector<> set;
+		// The entries whose rule has read this one
+		llvm::DenseSet<EntryKey> readers;
+		bool queued = false;
+	};
+	// References must stay valid while new entries are demanded, hence std::unordered_map
+	std::unordered_map<EntryKey, Entry> entries;
+	std::vector<EntryKey> workList;
+
+	// The results of the previous queries
+	llvm::DenseMap<NodeIndex, AndersPtsSet> results;
+
+	unsigned budget, steps;
+
+	static EntryKey makeKey(EntryKind kind, NodeIndex n) { return (static_cast<EntryKey>(kind) << 32) | n; }
+
+	// Return the current value of the entry, demanding it if needed, and remember that reader depends on it
+	const llvm::SparseBitVector<>& read(EntryKind kind, NodeIndex n, EntryKey reader);
+	void enqueue(EntryKey key, Entry& entry);
+	// Apply the rule of the entry once. Return false if the budget runs out
+	bool evaluate(EntryKey key);
+	bool evaluatePointsTo(NodeIndex v, EntryKey key, llvm::SparseBitVector<>& result);
+	bool evaluateFlowsTo(NodeIndex o, EntryKey key, llvm::SparseBitVector<>& result);
+public:
+	// budget is the number of set elements a single query may look at
+	AndersDemandSolver(const std::vector<AndersConstraint>& constraints, const AndersNodeFactory& nodeFactory, unsigned budget);
+
+	// Compute the pts-to set of n into ptsSet. Return false if the query runs out of budget
+	bool query(NodeIndex n, AndersPtsSet& ptsSet);
+};
+
+#endif
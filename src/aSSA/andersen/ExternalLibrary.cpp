@@ -6,6 +6,7 @@
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cstring>
 
 using namespace llvm;
@@ -26,6 +27,14 @@ static const char* noopFuncs[] = {
 	"iswalpha", "iswctype", "iswdigit", "iswlower", "iswspace", "iswprint",
 	"iswupper", "sin", "cos", "sinf", "cosf", "asin", "acos", "tan", "atan",
 	"fabs", "pow", "floor", "ceil", "sqrt", "sqrtf", "hypot", 
+	"logf", "log2", "log1p", "expf", "expm1", "powf", "fmod", "fmodf", "fmin", "fmax",
+	"fminf", "fmaxf", "fabsf", "floorf", "ceilf", "round", "roundf", "lround", "trunc",
+	"cbrt", "erf", "erfc", "tgamma", "lgamma", "atan2", "atan2f", "sinh", "cosh", "tanh",
+	"tanf", "asinf", "acosf", "atanf", "ldexp", "frexp", "nearbyint", "rint", "copysign",
+	"isnan", "isinf", "__isnan", "__isinf", "__finite",
+	"snprintf", "vsnprintf", "__isoc99_scanf", "getchar", "getc",
+	"lseek", "ftruncate", "fsync", "access", "getpid", "gethostname", "usleep",
+	"nanosleep", "clock_gettime", "times", "sysconf", "getrusage", "atexit",
 	"random", "tolower","toupper", "towlower", "towupper", "system", "clock",
 	"exit", "abort", "gettimeofday", "settimeofday", "sleep", "ctime",
 	"strspn", "strcspn", "localtime", "strftime",
@@ -39,7 +48,7 @@ static const char* noopFuncs[] = {
 	"llvm.bswap.i16", "llvm.bswap.i32", "llvm.ctlz.i64",
 	"llvm.lifetime.start", "llvm.lifetime.end", "llvm.stackrestore",
 	"memset", "llvm.memset.i32", "llvm.memset.p0i8.i32", "llvm.memset.i64",
-	"llvm.memset.p0i8.i64", "llvm.va_end",
+	"llvm.memset.p0i8.i64", "llvm.va_end", "llvm.prefetch", "llvm.stackprotector",
 	// The following functions might not be NOOP. They need to be removed from this list in the future
 	"setrlimit", "getrlimit",
 	nullptr
@@ -52,6 +61,8 @@ static const char* mallocFuncs[] = {
 	"strdup", "strndup",
 	"getenv",
 	"memalign", "posix_memalign",
+	"MPI_Alloc_mem", "MPI_Win_allocate", "MPI_Win_allocate_shared", "MPI_Win_shared_query",
+	"omp_alloc", "omp_target_alloc", "__kmpc_alloc",
 	nullptr
 };
 
@@ -75,6 +86,8 @@ static const char* retArg1Funcs[] = {
 
 static const char* retArg2Funcs[] = {
 	"freopen",
+	// The thread's copy of a threadprivate variable. Aliasing it with the variable is conservative
+	"__kmpc_threadprivate_cached",
 	nullptr
 };
 
@@ -82,7 +95,7 @@ static const char* memcpyFuncs[] = {
 	"llvm.memcpy.i32", "llvm.memcpy.p0i8.p0i8.i32", "llvm.memcpy.i64",
 	"llvm.memcpy.p0i8.p0i8.i64", "llvm.memmove.i32", "llvm.memmove.p0i8.p0i8.i32",
 	"llvm.memmove.i64", "llvm.memmove.p0i8.p0i8.i64",
-	"memccpy", "memmove", "bcopy",
+	"memccpy", "memmove", "bcopy", "llvm.va_copy",
 	nullptr
 };
 
@@ -91,6 +104,30 @@ static const char* convertFuncs[] = {
 	nullptr
 };
 
+// MPI and OpenMP runtime calls are the most frequent external calls of the programs PARCOACH looks at. Apart from the functions modelled above or listed below, they only read and write plain data through their pointer arguments: their handles (communicators, requests, locks...) are opaque to the program, and the buffers they fill hold data from other processes or reductions, which are no pointers of this process. So they don't induce any points-to constraints
+static const char* noopPrefixes[] = {
+	"MPI_", "PMPI_",
+	"mpi_", "pmpi_",	// Fortran bindings: every argument is passed by reference, hence the pollution if they were unresolved
+	"__kmpc_", "omp_",
+	nullptr
+};
+
+// The functions with a no-op prefix that do hand out pointers: the attribute getters and MPI_Buffer_detach() return pointers the library keeps, and the copy function of __kmpc_copyprivate() copies private variables of any type between threads. They remain unresolved
+static const char* unmodeledPrefixedFuncs[] = {
+	"MPI_Buffer_detach", "MPI_Comm_get_attr", "MPI_Attr_get", "MPI_Type_get_attr", "MPI_Win_get_attr",
+	"__kmpc_copyprivate",
+	nullptr
+};
+
+// The allocation functions that return the new memory through an argument rather than as their result, with the index of that argument
+static const std::pair<const char*, unsigned> allocArgFuncs[] = {
+	{"posix_memalign", 0},
+	{"MPI_Alloc_mem", 2},
+	{"MPI_Win_allocate", 4},
+	{"MPI_Win_allocate_shared", 4},
+	{"MPI_Win_shared_query", 4},
+};
+
 static bool lookupName(const char* table[], const char* str)
 {
 	for (unsigned i = 0; table[i] != nullptr; ++i)
@@ -101,9 +138,27 @@ static bool lookupName(const char* table[], const char* str)
 	return false;
 }
 
+static bool lookupPrefix(const char* table[], StringRef str)
+{
+	for (unsigned i = 0; table[i] != nullptr; ++i)
+	{
+		if (str.startswith(table[i]))
+			return true;
+	}
+	return false;
+}
+
+// The PMPI_ profiling interface behaves like the MPI_ one
+static std::string getMPIName(StringRef name)
+{
+	if (name.startswith("PMPI_"))
+		return name.drop_front(1).str();
+	return name.str();
+}
+
 // This function identifies if the external callsite is a library function call, and add constraint correspondingly
 // If this is a call to a "known" function, add the constraints and return true. If this is a call to an unknown function, return false.
-bool Andersen::addConstraintForExternalLibrary(ImmutableCallSite cs, const Function* f)
+bool Andersen::addConstraintForExternalLibrary(ImmutableCallSite cs, const Function* f, AndersCollectBuffer& buf)
 {
 	assert(f != nullptr && "called function is nullptr!");
 	assert((f->isDeclaration() || f->isIntrinsic()) && "Not an external function!");
@@ -112,27 +167,42 @@ bool Andersen::addConstraintForExternalLibrary(ImmutableCallSite cs, const Funct
 	if (lookupName(noopFuncs, f->getName().data()))
 		return true;
 
+	std::string name = getMPIName(f->getName());
+
 	// Realloc-like library is a little different: if the first argument is nullptr, then it behaves like retArg0Funcs; otherwise, it behaves like mallocFuncs
-	bool isReallocLike = lookupName(reallocFuncs, f->getName().data());
+	bool isReallocLike = lookupName(reallocFuncs, name.c_str());
 
 	// Library calls that might allocate memory.
-	if (lookupName(mallocFuncs, f->getName().data()) || (isReallocLike && !isa<ConstantPointerNull>(cs.getArgument(0))))
+	if (lookupName(mallocFuncs, name.c_str()) || (isReallocLike && !isa<ConstantPointerNull>(cs.getArgument(0))))
 	{
 		const Instruction* inst = cs.getInstruction();
 
-		// Create the obj node
-		NodeIndex objIndex = nodeFactory.createObjectNode(inst);
+		// Create the obj node. In field-sensitive mode, guess its type from the cast that usually follows the allocation
+		Type* objType = nullptr;
+		if (nodeFactory.isFieldSensitive())
+		{
+			for (auto user: inst->users())
+			{
+				if (isa<BitCastInst>(user))
+				{
+					objType = user->getType()->getPointerElementType();
+					break;
+				}
+			}
+		}
+		NodeIndex objIndex = buf.createObjectNode(inst, objType);
 
 		// Get the pointer node
 		NodeIndex ptrIndex = nodeFactory.getValueNodeFor(inst);
 		if (ptrIndex == AndersNodeFactory::InvalidIndex)
 		{
 			// Must be something like posix_memalign()
-			if (f->getName() == "posix_memalign")
+			auto allocArg = std::find_if(std::begin(allocArgFuncs), std::end(allocArgFuncs), [&name](const std::pair<const char*, unsigned>& func) { return name == func.first; });
+			if (allocArg != std::end(allocArgFuncs) && allocArg->second < cs.arg_size())
 			{
-				ptrIndex = nodeFactory.getValueNodeFor(cs.getArgument(0));
-				assert(ptrIndex != AndersNodeFactory::InvalidIndex && "Failed to find arg0 node");
-				constraints.emplace_back(AndersConstraint::STORE, ptrIndex, objIndex);
+				ptrIndex = nodeFactory.getValueNodeFor(cs.getArgument(allocArg->second));
+				assert(ptrIndex != AndersNodeFactory::InvalidIndex && "Failed to find out arg node");
+				buf.constraints.emplace_back(AndersConstraint::STORE, ptrIndex, objIndex);
 			}
 			else
 			{
@@ -143,65 +213,84 @@ bool Andersen::addConstraintForExternalLibrary(ImmutableCallSite cs, const Funct
 		else
 		{
 			// Normal malloc-like call 
-			constraints.emplace_back(AndersConstraint::ADDR_OF, ptrIndex, objIndex);
+			buf.constraints.emplace_back(AndersConstraint::ADDR_OF, ptrIndex, objIndex);
 		}
 		
 		return true;
 	}
 
-	if (lookupName(retArg0Funcs, f->getName().data()) || (isReallocLike && isa<ConstantPointerNull>(cs.getArgument(0))))
+	if (lookupName(retArg0Funcs, name.c_str()) || (isReallocLike && isa<ConstantPointerNull>(cs.getArgument(0))))
 	{
 		NodeIndex retIndex = nodeFactory.getValueNodeFor(cs.getInstruction());
 		if (retIndex != AndersNodeFactory::InvalidIndex)
 		{
 			NodeIndex arg0Index = nodeFactory.getValueNodeFor(cs.getArgument(0));
 			assert(arg0Index != AndersNodeFactory::InvalidIndex && "Failed to find arg0 node");
-			constraints.emplace_back(AndersConstraint::COPY, retIndex, arg0Index);
+			buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, arg0Index);
 		}
 		
 		return true;
 	}
 
-	if (lookupName(retArg1Funcs, f->getName().data()))
+	if (lookupName(retArg1Funcs, name.c_str()))
 	{
 		NodeIndex retIndex = nodeFactory.getValueNodeFor(cs.getInstruction());
 		assert(retIndex != AndersNodeFactory::InvalidIndex && "Failed to find call site node");
 		NodeIndex arg1Index = nodeFactory.getValueNodeFor(cs.getArgument(1));
 		assert(arg1Index != AndersNodeFactory::InvalidIndex && "Failed to find arg1 node");
-		constraints.emplace_back(AndersConstraint::COPY, retIndex, arg1Index);
+		buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, arg1Index);
 		return true;
 	}
 
-	if (lookupName(retArg2Funcs, f->getName().data()))
+	if (lookupName(retArg2Funcs, name.c_str()))
 	{
 		NodeIndex retIndex = nodeFactory.getValueNodeFor(cs.getInstruction());
 		assert(retIndex != AndersNodeFactory::InvalidIndex && "Failed to find call site node");
 		NodeIndex arg2Index = nodeFactory.getValueNodeFor(cs.getArgument(2));
 		assert(arg2Index != AndersNodeFactory::InvalidIndex && "Failed to find arg2 node");
-		constraints.emplace_back(AndersConstraint::COPY, retIndex, arg2Index);
+		buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, arg2Index);
 		return true;
 	}
 
-	if (lookupName(memcpyFuncs, f->getName().data()))
+	if (lookupName(memcpyFuncs, name.c_str()))
 	{
 		NodeIndex arg0Index = nodeFactory.getValueNodeFor(cs.getArgument(0));
 		assert(arg0Index != AndersNodeFactory::InvalidIndex && "Failed to find arg0 node");
 		NodeIndex arg1Index = nodeFactory.getValueNodeFor(cs.getArgument(1));
 		assert(arg1Index != AndersNodeFactory::InvalidIndex && "Failed to find arg1 node");	
 
-		NodeIndex tempIndex = nodeFactory.createValueNode();
-		constraints.emplace_back(AndersConstraint::LOAD, tempIndex, arg1Index);
-		constraints.emplace_back(AndersConstraint::STORE, arg0Index, tempIndex);
+		NodeIndex tempIndex = buf.createValueNode();
+		buf.constraints.emplace_back(AndersConstraint::LOAD, tempIndex, arg1Index);
+		buf.constraints.emplace_back(AndersConstraint::STORE, arg0Index, tempIndex);
+
+		// In field-sensitive mode, copy each field separately. Without a type to tell the size of the copied struct, assume the largest object possible
+		if (nodeFactory.isFieldSensitive())
+		{
+			Type* dstType = cs.getArgument(0)->stripPointerCasts()->getType()->getPointerElementType();
+			unsigned numFields = nodeFactory.getMaxFields();
+			if (isa<StructType>(dstType))
+				numFields = std::min(nodeFactory.getNumFields(dstType), numFields);
+			for (unsigned i = 1; i < numFields; ++i)
+			{
+				NodeIndex dstField = buf.createValueNode();
+				NodeIndex srcField = buf.createValueNode();
+				NodeIndex fieldTemp = buf.createValueNode();
+				buf.constraints.emplace_back(AndersConstraint::GEP, dstField, arg0Index, i);
+				buf.constraints.emplace_back(AndersConstraint::GEP, srcField, arg1Index, i);
+				buf.constraints.emplace_back(AndersConstraint::LOAD, fieldTemp, srcField);
+				buf.constraints.emplace_back(AndersConstraint::STORE, dstField, fieldTemp);
+			}
+		}
 
 		// Don't forget the return value
 		NodeIndex retIndex = nodeFactory.getValueNodeFor(cs.getInstruction());
 		if (retIndex != AndersNodeFactory::InvalidIndex)
-			constraints.emplace_back(AndersConstraint::COPY, retIndex, arg0Index);
+			buf.constraints.emplace_back(AndersConstraint::COPY, retIndex, arg0Index);
 
 		return true;
 	}
 
-	if (lookupName(convertFuncs, f->getName().data()))
+	if (lookupName(convertFuncs, name.c_str()))
 	{
 		if (!isa<ConstantPointerNull>(cs.getArgument(1)))
 		{
@@ -209,7 +298,7 @@ bool Andersen::addConstraintForExternalLibrary(ImmutableCallSite cs, const Funct
 			assert(arg0Index != AndersNodeFactory::InvalidIndex && "Failed to find arg0 node");
 			NodeIndex arg1Index = nodeFactory.getValueNodeFor(cs.getArgument(1));
 			assert(arg1Index != AndersNodeFactory::InvalidIndex && "Failed to find arg1 node");
-			constraints.emplace_back(AndersConstraint::STORE, arg0Index, arg1Index);
+			buf.constraints.emplace_back(AndersConstraint::STORE, arg0Index, arg1Index);
 		}
 
 		return true;
@@ -224,11 +313,81 @@ bool Andersen::addConstraintForExternalLibrary(ImmutableCallSite cs, const Funct
 		assert(arg0Index != AndersNodeFactory::InvalidIndex && "Failed to find arg0 node");
 		NodeIndex vaIndex = nodeFactory.getVarargNodeFor(parentF);
 		assert(vaIndex != AndersNodeFactory::InvalidIndex && "Failed to find va node");
-		constraints.emplace_back(AndersConstraint::ADDR_OF, arg0Index, vaIndex);
+		buf.constraints.emplace_back(AndersConstraint::ADDR_OF, arg0Index, vaIndex);
+
+		return true;
+	}
+
+	// __kmpc_fork_call(loc, argc, microtask, args...) runs microtask(gtid, btid, args...) on each thread of the team. gtid and btid point to integers of the runtime
+	if ((name == "__kmpc_fork_call" || name == "__kmpc_fork_teams") && cs.arg_size() >= 3)
+	{
+		const Function* microtask = dyn_cast<Function>(cs.getArgument(2)->stripPointerCasts());
+		if (microtask == nullptr || microtask->isDeclaration())
+			return false;
+		addReachableFunction(microtask);
 
+		Function::const_arg_iterator fItr = microtask->arg_begin(), fEnd = microtask->arg_end();
+		for (unsigned i = 0; i < 2 && fItr != fEnd; ++i)
+			++fItr;
+		for (unsigned i = 3, e = cs.arg_size(); i < e && fItr != fEnd; ++i, ++fItr)
+		{
+			if (!fItr->getType()->isPointerTy())
+				continue;
+			NodeIndex formalIndex = nodeFactory.getValueNodeFor(&*fItr);
+			assert(formalIndex != AndersNodeFactory::InvalidIndex && "Failed to find formal arg node");
+			const Value* actual = cs.getArgument(i);
+			NodeIndex actualIndex = actual->getType()->isPointerTy() ? nodeFactory.getValueNodeFor(actual) : nodeFactory.getUniversalPtrNode();
+			assert(actualIndex != AndersNodeFactory::InvalidIndex && "Failed to find actual arg node");
+			buf.constraints.emplace_back(AndersConstraint::COPY, formalIndex, actualIndex);
+		}
 		return true;
 	}
 
+	// __kmpc_omp_task_alloc(loc, gtid, flags, sizeOfTask, sizeOfShareds, taskEntry) allocates the task along with the block of its shared variables, which the task points to. One object stands for both, pointing to itself. The runtime later runs taskEntry(gtid, task)
+	if (name == "__kmpc_omp_task_alloc")
+	{
+		const Instruction* inst = cs.getInstruction();
+		NodeIndex taskIndex = nodeFactory.getValueNodeFor(inst);
+		if (taskIndex == AndersNodeFactory::InvalidIndex)
+			return true;
+		NodeIndex objIndex = buf.createObjectNode(inst);
+		buf.constraints.emplace_back(AndersConstraint::ADDR_OF, taskIndex, objIndex);
+		buf.constraints.emplace_back(AndersConstraint::STORE, taskIndex, taskIndex);
+
+		const Function* taskEntry = cs.arg_size() >= 6 ? dyn_cast<Function>(cs.getArgument(5)->stripPointerCasts()) : nullptr;
+		if (taskEntry != nullptr && !taskEntry->isDeclaration() && taskEntry->arg_size() >= 2)
+		{
+			addReachableFunction(taskEntry);
+			const Argument* taskArg = &*std::next(taskEntry->arg_begin());
+			NodeIndex formalIndex = nodeFactory.getValueNodeFor(taskArg);
+			if (formalIndex != AndersNodeFactory::InvalidIndex)
+				buf.constraints.emplace_back(AndersConstraint::COPY, formalIndex, taskIndex);
+		}
+		return true;
+	}
+
+	if (lookupPrefix(noopPrefixes, name) && !lookupName(unmodeledPrefixedFuncs, name.c_str()))
+		return true;
+
 	return false;
 }
 
+// Count the pointers an unresolved external call makes point to anything, for -anders-report-unmodeled
+void Andersen::recordUnmodeledCall(const Function* f, unsigned numPollutedPointers)
+{
+	if (numPollutedPointers != 0)
+		unmodeledCalls[f->getName()] += numPollutedPointers;
+}
+
+void Andersen::reportUnmodeledCalls() const
+{
+	std::vector<std::pair<StringRef, unsigned>> sortedCalls;
+	for (auto const& entry: unmodeledCalls)
+		sortedCalls.push_back(std::make_pair(entry.getKey(), entry.getValue()));
+	std::sort(sortedCalls.begin(), sortedCalls.end(), [](const std::pair<StringRef, unsigned>& a, const std::pair<StringRef, unsigned>& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+
+	errs() << "External functions without model, by number of pointers made to point to anything:\n";
+	for (auto const& entry: sortedCalls)
+		errs() << "  " << entry.second << "\t" << entry.first << "\n";
+}
+
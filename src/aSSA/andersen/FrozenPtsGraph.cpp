@@ -0,0 +1,96 @@
+#include "FrozenPtsGraph.h"
+
+#include "llvm/ADT/Statistic.h"
+
+#include <algorithm>
+
+#define DEBUG_TYPE "andersen"
+
+using namespace llvm;
+
+STATISTIC(NumFrozenSets, "Number of distinct pts-to sets in the frozen Andersen results");
+STATISTIC(NumFrozenPointees, "Number of pointees of the distinct pts-to sets in the frozen Andersen results");
+
+void AndersFrozenPtsGraph::appendPointees(const AndersNodeFactory& nodeFactory, const AndersPtsSet& ptsSet, std::vector<AndersPointee>& out)
+{
+	for (auto obj: ptsSet)
+	{
+		if (obj == nodeFactory.getNullObjectNode())
+			continue;
+		const Value* val = nodeFactory.getValueForNode(obj);
+		if (val != nullptr)
+			out.push_back(std::make_pair(val, nodeFactory.getObjectOffset(obj)));
+	}
+}
+
+void AndersFrozenPtsGraph::build(const AndersNodeFactory& nodeFactory, const std::vector<AndersPtsSet>& ptsGraph)
+{
+	// The node order makes the set indices the same from one run to the next
+	std::vector<std::pair<const Value*, NodeIndex>> valueNodes;
+	nodeFactory.getValueNodes(valueNodes);
+	std::sort(valueNodes.begin(), valueNodes.end(), [](const std::pair<const Value*, NodeIndex>& a, const std::pair<const Value*, NodeIndex>& b) { return a.second < b.second; });
+
+	// The pts-to sets are hash-consed, so equal sets are found by their id
+	DenseMap<const void*, unsigned> setIndex;
+	setIndex[nullptr] = 0;
+	setOffsets.assign(2, 0);
+	pointers.reserve(valueNodes.size());
+	for (auto const& mapping: valueNodes)
+	{
+		if (mapping.second == nodeFactory.getUniversalPtrNode())
+			continue;
+
+		const AndersPtsSet& ptsSet = ptsGraph[nodeFactory.getMergeTarget(mapping.second)];
+		auto ins = setIndex.insert(std::make_pair(ptsSet.getId(), setOffsets.size() - 1));
+		if (ins.second)
+		{
+			appendPointees(nodeFactory, ptsSet, pointees);
+			setOffsets.push_back(pointees.size());
+		}
+		pointers.push_back(std::make_pair(mapping.first, ins.first->second));
+	}
+	pointees.shrink_to_fit();
+	setOffsets.shrink_to_fit();
+
+	pointerSets.reserve(pointers.size());
+	for (auto const& ptr: pointers)
+		pointerSets[ptr.first] = ptr.second;
+
+	nodeFactory.getAllocSites(allocSites);
+	objectSlots.assign(1, 0);
+	objectSlots.reserve(allocSites.size() + 1);
+	allocSiteIndex.reserve(allocSites.size());
+	for (unsigned i = 0, e = allocSites.size(); i < e; ++i)
+	{
+		objectSlots.push_back(objectSlots.back() + nodeFactory.getObjectSize(nodeFactory.getObjectNodeFor(allocSites[i])));
+		allocSiteIndex[allocSites[i]] = i;
+	}
+
+	NumFrozenSets += getNumSets();
+	NumFrozenPointees += pointees.size();
+}
+
+AndersPtsView AndersFrozenPtsGraph::getPointsToView(const Value* v) const
+{
+	auto itr = pointerSets.find(v);
+	if (itr == pointerSets.end())
+		return AndersPtsView();
+	return getSet(itr->second);
+}
+
+unsigned AndersFrozenPtsGraph::getNumFields(const Value* allocSite) const
+{
+	auto itr = allocSiteIndex.find(allocSite);
+	if (itr == allocSiteIndex.end())
+		return 1;
+	return objectSlots[itr->second + 1] - objectSlots[itr->second];
+}
+
+unsigned AndersFrozenPtsGraph::getObjectSlot(const Value* allocSite, unsigned field) const
+{
+	auto itr = allocSiteIndex.find(allocSite);
+	if (itr == allocSiteIndex.end())
+		return AndersNodeFactory::InvalidIndex;
+	unsigned numFields = objectSlots[itr->second + 1] - objectSlots[itr->second];
+	return objectSlots[itr->second] + std::min(field, numFields - 1);
+}
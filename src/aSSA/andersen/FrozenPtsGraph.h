@@ -0,0 +1,57 @@
+#ifndef ANDERSEN_FROZEN_PTS_GRAPH_H
+#define ANDERSEN_FROZEN_PTS_GRAPH_H
+
+#include "NodeFactory.h"
+#include "PtsSet.h"
+#include "PtsView.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Value.h"
+
+#include <utility>
+#include <vector>
+
+// The solution of the analysis once it is frozen (see Andersen::freeze()): everything the queries need, and nothing the solver does
+// Each distinct pts-to set is stored once, with its pointees already translated to values and fields, in one flat array with an offset per set. A pointer value maps to the index of its set, and an allocation site to the slots of its fields, which the reverse index is built on. The table never changes once built
+class AndersFrozenPtsGraph
+{
+private:
+	// The pointer values, in the order of their nodes, with the index of their set. The pointers the analysis knows nothing about are left out
+	std::vector<std::pair<const llvm::Value*, unsigned>> pointers;
+	llvm::DenseMap<const llvm::Value*, unsigned> pointerSets;
+	// Set s has the pointees pointees[setOffsets[s]] up to pointees[setOffsets[s + 1]]. Set 0 is the empty one
+	std::vector<unsigned> setOffsets;
+	std::vector<AndersPointee> pointees;
+
+	// The allocation sites, in the order of AndersNodeFactory::getAllocSites(). The fields of allocSites[i] have the slots objectSlots[i] up to objectSlots[i + 1]
+	std::vector<const llvm::Value*> allocSites;
+	std::vector<unsigned> objectSlots;
+	llvm::DenseMap<const llvm::Value*, unsigned> allocSiteIndex;
+public:
+	AndersFrozenPtsGraph() {}
+
+	// Freeze the pts-to sets of ptsGraph, which must be solved and indexed by the merge targets of nodeFactory
+	void build(const AndersNodeFactory& nodeFactory, const std::vector<AndersPtsSet>& ptsGraph);
+
+	// Append the pointees of ptsSet as Andersen::getPointsToView() gives them: the null object and the objects without value are left out
+	static void appendPointees(const AndersNodeFactory& nodeFactory, const AndersPtsSet& ptsSet, std::vector<AndersPointee>& out);
+
+	// The view of the pts-to set of v. It is not known if v is not a pointer the analysis knows about
+	AndersPtsView getPointsToView(const llvm::Value* v) const;
+
+	const std::vector<std::pair<const llvm::Value*, unsigned>>& getPointers() const { return pointers; }
+	AndersPtsView getSet(unsigned s) const
+	{
+		return AndersPtsView(pointees.data() + setOffsets[s], pointees.data() + setOffsets[s + 1]);
+	}
+	unsigned getNumSets() const { return setOffsets.size() - 1; }
+
+	const std::vector<const llvm::Value*>& getAllocSites() const { return allocSites; }
+	// 1 if allocSite is no allocation site, as AndersNodeFactory::getObjectSize()
+	unsigned getNumFields(const llvm::Value* allocSite) const;
+	// The slot of field of the object allocated at allocSite, with the fields beyond the last one collapsed into it. InvalidIndex if allocSite is no allocation site
+	unsigned getObjectSlot(const llvm::Value* allocSite, unsigned field) const;
+	unsigned getNumObjectSlots() const { return objectSlots.empty() ? 0 : objectSlots.back(); }
+};
+
+#endif
@@ -10,19 +10,20 @@
 using namespace llvm;
 
 const unsigned AndersNodeFactory::InvalidIndex = std::numeric_limits<unsigned int>::max();
+const unsigned AndersNodeFactory::UnknownOffset = std::numeric_limits<unsigned int>::max();
 
-AndersNodeFactory::AndersNodeFactory()
+AndersNodeFactory::AndersNodeFactory(): concurrentMergeTargets(nullptr), maxFields(1), numFieldsFrozen(false)
 {
 	// Note that we can't use std::vector::emplace_back() here because AndersNode's constructors are private hence std::vector cannot see it
 
 	// Node #0 is always the universal ptr: the ptr that we don't know anything about.
-	nodes.push_back(AndersNode(AndersNode::VALUE_NODE, 0));
+	addNode(AndersNode(AndersNode::VALUE_NODE, 0));
 	// Node #0 is always the universal obj: the obj that we don't know anything about.
-	nodes.push_back(AndersNode(AndersNode::OBJ_NODE, 1));
+	addNode(AndersNode(AndersNode::OBJ_NODE, 1));
 	// Node #2 always represents the null pointer.
-	nodes.push_back(AndersNode(AndersNode::VALUE_NODE, 2));
+	addNode(AndersNode(AndersNode::VALUE_NODE, 2));
 	// Node #3 is the object that null pointer points to
-	nodes.push_back(AndersNode(AndersNode::OBJ_NODE, 3));
+	addNode(AndersNode(AndersNode::OBJ_NODE, 3));
 
 	assert(nodes.size() == 4);
 }
@@ -31,7 +32,7 @@ NodeIndex AndersNodeFactory::createValueNode(const Value* val)
 {
 	//errs() << "inserting " << *val << "\n";
 	unsigned nextIdx = nodes.size();
-	nodes.push_back(AndersNode(AndersNode::VALUE_NODE, nextIdx, val));
+	addNode(AndersNode(AndersNode::VALUE_NODE, nextIdx, val));
 	if (val != nullptr)
 	{
 		assert(!valueNodeMap.count(val) && "Trying to insert two mappings to revValueNodeMap!");
@@ -41,23 +42,29 @@ NodeIndex AndersNodeFactory::createValueNode(const Value* val)
 	return nextIdx;
 }
 
-NodeIndex AndersNodeFactory::createObjectNode(const Value* val)
+NodeIndex AndersNodeFactory::createObjectNode(const Value* val, Type* ty)
 {
+	return createObjectNodeWithFields(getNumObjectFields(ty), val);
+}
+
+NodeIndex AndersNodeFactory::createObjectNodeWithFields(unsigned numFields, const Value* val)
+{
+	assert(numFields > 0 && "An object has at least one field!");
 	unsigned nextIdx = nodes.size();
-	nodes.push_back(AndersNode(AndersNode::OBJ_NODE, nextIdx, val));
+	for (unsigned i = 0; i < numFields; ++i)
+		addNode(AndersNode(AndersNode::OBJ_NODE, nextIdx + i, val, i, numFields));
 	if (val != nullptr)
 	{
 		assert(!objNodeMap.count(val) && "Trying to insert two mappings to revObjNodeMap!");
 		objNodeMap[val] = nextIdx;
 	}
-
 	return nextIdx;
 }
 
 NodeIndex AndersNodeFactory::createReturnNode(const llvm::Function* f)
 {
 	unsigned nextIdx = nodes.size();
-	nodes.push_back(AndersNode(AndersNode::VALUE_NODE, nextIdx, f));
+	addNode(AndersNode(AndersNode::VALUE_NODE, nextIdx, f));
 
 	assert(!returnMap.count(f) && "Trying to insert two mappings to returnMap!");
 	returnMap[f] = nextIdx;
@@ -68,7 +75,7 @@ NodeIndex AndersNodeFactory::createReturnNode(const llvm::Function* f)
 NodeIndex AndersNodeFactory::createVarargNode(const llvm::Function* f)
 {
 	unsigned nextIdx = nodes.size();
-	nodes.push_back(AndersNode(AndersNode::OBJ_NODE, nextIdx, f));
+	addNode(AndersNode(AndersNode::OBJ_NODE, nextIdx, f));
 
 	assert(!varargMap.count(f) && "Trying to insert two mappings to varargMap!");
 	varargMap[f] = nextIdx;
@@ -76,6 +83,66 @@ NodeIndex AndersNodeFactory::createVarargNode(const llvm::Function* f)
 	return nextIdx;
 }
 
+unsigned AndersNodeFactory::getNumFields(Type* ty) const
+{
+	auto itr = numFieldsMap.find(ty);
+	if (itr != numFieldsMap.end())
+		return itr->second;
+
+	unsigned ret = 1;
+	if (StructType* st = dyn_cast<StructType>(ty))
+	{
+		if (!st->isOpaque() && st->getNumElements() > 0)
+		{
+			ret = 0;
+			for (unsigned i = 0, e = st->getNumElements(); i != e; ++i)
+				ret += getNumFields(st->getElementType(i));
+		}
+	}
+	else if (ArrayType* at = dyn_cast<ArrayType>(ty))
+		ret = getNumFields(at->getElementType());
+
+	if (!numFieldsFrozen)
+		numFieldsMap[ty] = ret;
+	return ret;
+}
+
+unsigned AndersNodeFactory::getGEPOffset(const GEPOperator* gep) const
+{
+	if (!isFieldSensitive())
+		return 0;
+
+	// The first index steps over whole objects, which all are the same object to us. But if it steps over bytes of a non-aggregate type, we're looking at pointer arithmetic we cannot follow
+	Type* ty = gep->getSourceElementType();
+	if (!ty->isAggregateType())
+	{
+		const ConstantInt* ci = dyn_cast<ConstantInt>(gep->getOperand(1));
+		if (ty->isIntegerTy(8) && (ci == nullptr || !ci->isZero()))
+			return UnknownOffset;
+		return 0;
+	}
+
+	unsigned offset = 0;
+	for (unsigned i = 2, e = gep->getNumOperands(); i < e; ++i)
+	{
+		if (StructType* st = dyn_cast<StructType>(ty))
+		{
+			const ConstantInt* ci = dyn_cast<ConstantInt>(gep->getOperand(i));
+			if (ci == nullptr)
+				break;
+			unsigned fieldNo = ci->getZExtValue();
+			for (unsigned j = 0; j < fieldNo; ++j)
+				offset += getNumFields(st->getElementType(j));
+			ty = st->getElementType(fieldNo);
+		}
+		else if (ArrayType* at = dyn_cast<ArrayType>(ty))
+			ty = at->getElementType();
+		else
+			break;
+	}
+	return offset;
+}
+
 NodeIndex AndersNodeFactory::getValueNodeFor(const Value* val) const
 {
 	if (const Constant* c = dyn_cast<Constant>(val))
@@ -102,9 +169,14 @@ NodeIndex AndersNodeFactory::getValueNodeForConstant(const llvm::Constant* c) co
     {
 		switch (ce->getOpcode())
 		{
-			// Pointer to any field within a struct is treated as a pointer to the first field
+			// Pointer to any field within a struct is treated as a pointer to the first field, unless we've created a node for that field pointer (see Andersen::collectConstraintsForConstantGEPs())
 			case Instruction::GetElementPtr:
+			{
+				auto itr = valueNodeMap.find(c);
+				if (itr != valueNodeMap.end())
+					return itr->second;
 				return getValueNodeFor(c->getOperand(0));
+			}
 			case Instruction::IntToPtr:
 			case Instruction::PtrToInt:
 				return getUniversalPtrNode();
@@ -146,9 +218,15 @@ NodeIndex AndersNodeFactory::getObjectNodeForConstant(const llvm::Constant* c) c
 	{
 		switch (ce->getOpcode())
 		{
-			// Pointer to any field within a struct is treated as a pointer to the first field
+			// Pointer to any field within a struct is treated as a pointer to the first field if the analysis is field-insensitive
 			case Instruction::GetElementPtr:
-				return getObjectNodeForConstant(ce->getOperand(0));
+			{
+				NodeIndex baseObj = getObjectNodeForConstant(ce->getOperand(0));
+				unsigned offset = getGEPOffset(cast<GEPOperator>(ce));
+				if (baseObj == InvalidIndex || offset == UnknownOffset)
+					return baseObj;
+				return getFieldNode(baseObj, offset);
+			}
 			case Instruction::IntToPtr:
 			case Instruction::PtrToInt:
 				return getUniversalObjNode();
@@ -185,36 +263,61 @@ NodeIndex AndersNodeFactory::getVarargNodeFor(const llvm::Function* f) const
 
 void AndersNodeFactory::mergeNode(NodeIndex n0, NodeIndex n1)
 {
-	assert(n0 < nodes.size() && n1 < nodes.size());
-	nodes[n1].mergeTarget = n0;
+	if (concurrentMergeTargets)
+		concurrentMergeTargets->unite(n0, n1);
+	else
+		mergeTargets.unite(n0, n1);
+}
+
+void AndersNodeFactory::clearMerges()
+{
+	concurrentMergeTargets = nullptr;
+	mergeTargets = AndersUnionFind();
+	for (unsigned i = 0, e = nodes.size(); i < e; ++i)
+		mergeTargets.addNode();
 }
 
 NodeIndex AndersNodeFactory::getMergeTarget(NodeIndex n)
 {
-	assert(n < nodes.size());
-	NodeIndex ret = nodes[n].mergeTarget;
-	if (ret != n)
+	if (concurrentMergeTargets)
+		return concurrentMergeTargets->find(n);
+	return mergeTargets.find(n);
+}
+
+NodeIndex AndersNodeFactory::getMergeTarget(NodeIndex n) const
+{
+	if (concurrentMergeTargets)
+		return concurrentMergeTargets->find(n);
+	return mergeTargets.find(n);
+}
+
+void AndersNodeFactory::beginConcurrentMerges(AndersConcurrentUnionFind& merges)
+{
+	assert(!concurrentMergeTargets && merges.size() == nodes.size());
+	concurrentMergeTargets = &merges;
+	// A representative is only ever merged into as the first node, so it stays the representative of its set
+	for (NodeIndex i = 0, e = nodes.size(); i < e; ++i)
 	{
-		std::vector<NodeIndex> path(1, n);
-		while (ret != nodes[ret].mergeTarget)
-		{
-			path.push_back(ret);
-			ret = nodes[ret].mergeTarget;
-		}
-		for (auto idx: path)
-			nodes[idx].mergeTarget = ret;
+		NodeIndex rep = mergeTargets.find(i);
+		if (rep != i)
+			concurrentMergeTargets->unite(rep, i);
 	}
-	assert(ret < nodes.size());
-	return ret;
 }
 
-NodeIndex AndersNodeFactory::getMergeTarget(NodeIndex n) const
+void AndersNodeFactory::endConcurrentMerges()
 {
-	assert (n < nodes.size());
-	NodeIndex ret = nodes[n].mergeTarget;
-	while (ret != nodes[ret].mergeTarget)
-		ret = nodes[ret].mergeTarget;
-	return ret;
+	assert(concurrentMergeTargets);
+	AndersConcurrentUnionFind* merges = concurrentMergeTargets;
+	concurrentMergeTargets = nullptr;
+	mergeTargets = AndersUnionFind();
+	for (NodeIndex i = 0, e = nodes.size(); i < e; ++i)
+		mergeTargets.addNode();
+	for (NodeIndex i = 0, e = nodes.size(); i < e; ++i)
+	{
+		NodeIndex rep = merges->find(i);
+		if (rep != i)
+			mergeTargets.unite(rep, i);
+	}
 }
 
 void AndersNodeFactory::getAllocSites(std::vector<const llvm::Value*>& allocSites) const
@@ -225,6 +328,14 @@ void AndersNodeFactory::getAllocSites(std::vector<const llvm::Value*>& allocSite
 		allocSites.push_back(mapping.first);
 }
 
+void AndersNodeFactory::getValueNodes(std::vector<std::pair<const llvm::Value*, NodeIndex>>& valueNodes) const
+{
+	valueNodes.clear();
+	valueNodes.reserve(valueNodeMap.size());
+	for (auto const& mapping: valueNodeMap)
+		valueNodes.push_back(std::make_pair(mapping.first, mapping.second));
+}
+
 void AndersNodeFactory::dumpNode(NodeIndex idx) const
 {
 	const AndersNode& n = nodes.at(idx);
@@ -234,7 +345,10 @@ void AndersNodeFactory::dumpNode(NodeIndex idx) const
 		errs() << "[O ";
 	else
 		assert(false && "Wrong type number!");
-	errs() << "#" << n.idx << "]";
+	errs() << "#" << n.idx;
+	if (n.offset != 0)
+		errs() << " +" << n.offset;
+	errs() << "]";
 }
 
 void AndersNodeFactory::dumpNodeInfo() const
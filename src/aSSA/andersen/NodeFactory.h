@@ -1,12 +1,16 @@
 #ifndef ANDERSEN_NODE_FACTORY_H
 #define ANDERSEN_NODE_FACTORY_H
 
+#include "UnionFind.h"
+
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/ADT/DenseMap.h"
 
+#include <algorithm>
 #include <vector>
 
 // AndersNode class - This class is used to represent a node in the constraint graph.  Due to various optimizations, it is not always the case that there is always a mapping from a Node to a Value. (In particular, we add artificial Node's that represent the set of pointed-to variables shared for each location equivalent Node.
@@ -22,9 +26,11 @@ public:
 	};
 private:
 	AndersNodeType type;
-	NodeIndex idx, mergeTarget;
+	NodeIndex idx;
 	const llvm::Value* value;
-	AndersNode(AndersNodeType t, unsigned i, const llvm::Value* v = nullptr): type(t), idx(i), mergeTarget(i), value(v) {}
+	// For object nodes: the index of the field this node stands for, and the number of field nodes of its object. The field nodes of an object always have consecutive indices
+	unsigned offset, numFields;
+	AndersNode(AndersNodeType t, unsigned i, const llvm::Value* v = nullptr, unsigned o = 0, unsigned n = 1): type(t), idx(i), value(v), offset(o), numFields(n) {}
 public:
 	NodeIndex getIndex() const { return idx; }
 	const llvm::Value* getValue() const { return value; }
@@ -40,10 +46,16 @@ class AndersNodeFactory
 public:
 	// The largest unsigned int is reserved for invalid index
 	static const unsigned InvalidIndex;
+	// Field offset of a pointer arithmetic we cannot resolve to a field: it may point to any field of its object
+	static const unsigned UnknownOffset;
 private:
 
 	// The set of nodes 
 	std::vector<AndersNode> nodes;
+	// The merge target of each node
+	AndersUnionFind mergeTargets;
+	// The merge targets while the parallel solver runs, in place of mergeTargets (see beginConcurrentMerges()). Owned by the solver
+	AndersConcurrentUnionFind* concurrentMergeTargets;
 
 	// Some special indices
 	static const NodeIndex UniversalPtrIndex = 0;
@@ -64,14 +76,30 @@ private:
 	// varargMap - This map contains the entry used to represent all pointers passed through the varargs portion of a function call for a particular function.  An entry is not present in this map for functions that do not take variable arguments.
 	llvm::DenseMap<const llvm::Function*, NodeIndex> varargMap;
 
+	// The maximum number of field nodes per object. 1 means field-insensitive
+	unsigned maxFields;
+	// Memoize the number of fields of each type we've looked at
+	mutable llvm::DenseMap<llvm::Type*, unsigned> numFieldsMap;
+	// While set, getNumFields() leaves numFieldsMap alone, so that several threads may call the const methods at once
+	bool numFieldsFrozen;
+
+	void addNode(const AndersNode& node)
+	{
+		assert(!concurrentMergeTargets && "Cannot create a node during concurrent merges");
+		nodes.push_back(node);
+		mergeTargets.addNode();
+	}
 public:
 	AndersNodeFactory();
 
 	// Factory methods
 	NodeIndex createValueNode(const llvm::Value* val = nullptr);
-	NodeIndex createObjectNode(const llvm::Value* val = nullptr);
+	// Create one object node per field of type ty (up to the field limit) and return the node of the first field
+	NodeIndex createObjectNode(const llvm::Value* val = nullptr, llvm::Type* ty = nullptr);
 	NodeIndex createReturnNode(const llvm::Function* f);
 	NodeIndex createVarargNode(const llvm::Function* f);
+	// Create the nodes of an object that has numFields fields. Used to rebuild the nodes of a constraint dump, and to create the nodes reserved while collecting constraints in parallel
+	NodeIndex createObjectNodeWithFields(unsigned numFields, const llvm::Value* val = nullptr);
 
 	// Map lookup interfaces (return InvalidIndex if value not found)
 	NodeIndex getValueNodeFor(const llvm::Value* val) const;
@@ -83,8 +111,12 @@ public:
 
 	// Node merge interfaces
 	void mergeNode(NodeIndex n0, NodeIndex n1);	// Merge n1 into n0
+	void clearMerges();	// Make every node its own merge target again
 	NodeIndex getMergeTarget(NodeIndex n);
 	NodeIndex getMergeTarget(NodeIndex n) const;
+	// Until endConcurrentMerges(), the merge targets live in the lock-free union-find merges, which must have one node per node of the factory: getMergeTarget() may then run on several threads at once and still compress paths, the const version included. No node may be created meanwhile
+	void beginConcurrentMerges(AndersConcurrentUnionFind& merges);
+	void endConcurrentMerges();
 
 	// Pointer arithmetic
 	bool isObjectNode(NodeIndex i) const
@@ -97,6 +129,33 @@ public:
 		return n + offset;
 	}
 
+	// Field sensitivity
+	void setMaxFields(unsigned n) { maxFields = n > 0 ? n : 1; }
+	unsigned getMaxFields() const { return maxFields; }
+	bool isFieldSensitive() const { return maxFields > 1; }
+	// Return the number of fields of ty once nested structs are flattened and arrays are collapsed into their element
+	unsigned getNumFields(llvm::Type* ty) const;
+	// The number of field nodes createObjectNode() gives an object of type ty
+	unsigned getNumObjectFields(llvm::Type* ty) const
+	{
+		return ty != nullptr && isFieldSensitive() ? std::min(getNumFields(ty), maxFields) : 1;
+	}
+	void freezeNumFields(bool freeze) { numFieldsFrozen = freeze; }
+	// Return the field offset the gep adds to its pointer operand, in the same unit as getNumFields(). Return 0 if the analysis is field-insensitive
+	unsigned getGEPOffset(const llvm::GEPOperator* gep) const;
+	// Return the node of the field at offset from the object field node n. Offsets beyond the end of the object are collapsed into its last field. Any other node is returned as it is
+	NodeIndex getFieldNode(NodeIndex n, unsigned offset) const
+	{
+		const AndersNode& node = nodes.at(n);
+		if (node.type != AndersNode::OBJ_NODE || node.numFields == 1)
+			return n;
+		unsigned field = std::min(node.offset + offset, node.numFields - 1);
+		return n - node.offset + field;
+	}
+	// Return the field index of n within its object, and the number of field nodes of that object
+	unsigned getObjectOffset(NodeIndex n) const { return nodes.at(n).offset; }
+	unsigned getObjectSize(NodeIndex n) const { return nodes.at(n).numFields; }
+
 	// Special node getters
 	NodeIndex getUniversalPtrNode() const { return UniversalPtrIndex; }
 	NodeIndex getUniversalObjNode() const { return UniversalObjIndex; }
@@ -109,6 +168,8 @@ public:
 		return nodes.at(i).getValue();
 	}
 	void getAllocSites(std::vector<const llvm::Value*>&) const;
+	// Every value that has a value node, with that node
+	void getValueNodes(std::vector<std::pair<const llvm::Value*, NodeIndex>>&) const;
 
 	// Value remover
 	void removeNodeForValue(const llvm::Value* val)
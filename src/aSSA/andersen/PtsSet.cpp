@@ -0,0 +1,250 @@
+#include "PtsSet.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+
+using namespace llvm;
+
+namespace {
+
+typedef AndersBitSet BitSet;
+
+// The pool that owns every distinct non-empty points-to set. Interned bitsets are never modified or freed until the pool is released, so handles stay valid for the whole run
+// The parallel solver updates points-to sets from several threads, so the pool must be thread-safe without making them wait on each other:
+// - the table of interned sets is split into shards by hash, each with its own lock, which is only taken to intern a set the operation has built;
+// - the set operations are memoized in caches that each thread keeps for itself (see getOpCaches()), hence a memoized operation takes no lock at all.
+class AndersPtsSetPool
+{
+private:
+	struct Entry
+	{
+		BitSet bits;
+		size_t hash;
+
+		Entry(BitSet&& b, size_t h): bits(std::move(b)), hash(h) {}
+	};
+	struct EntryHash
+	{
+		size_t operator()(const Entry* e) const { return e->hash; }
+	};
+	struct EntryEqual
+	{
+		bool operator()(const Entry* lhs, const Entry* rhs) const { return lhs->hash == rhs->hash && lhs->bits == rhs->bits; }
+	};
+
+	struct Shard
+	{
+		std::mutex lock;
+		// std::deque never moves its elements, which lets us hand out pointers to them
+		std::deque<Entry> entries;
+		std::unordered_set<const Entry*, EntryHash, EntryEqual> table;
+	};
+	// A power of two, well above the number of threads the solver runs on
+	static const unsigned NumShards = 64;
+	Shard shards[NumShards];
+
+	// Bumped by clear(), so that the threads drop the memoized operations, which refer to the freed sets
+	std::atomic<unsigned> generation;
+public:
+	AndersPtsSetPool(): generation(0) {}
+
+	unsigned getGeneration() const { return generation.load(std::memory_order_acquire); }
+
+	const BitSet* intern(BitSet&& bv)
+	{
+		if (bv.empty())
+			return nullptr;
+
+		// The hash is the costly part, so it is computed before taking the lock
+		size_t hash = bv.hash();
+		// The low bits of the hash pick the bucket in the table of the shard, so the shard is picked with higher ones
+		Shard& shard = shards[(hash >> 20) & (NumShards - 1)];
+		std::lock_guard<std::mutex> guard(shard.lock);
+		shard.entries.emplace_back(std::move(bv), hash);
+		Entry& entry = shard.entries.back();
+		auto res = shard.table.insert(&entry);
+		if (!res.second)
+		{
+			// This set already exists. Drop the copy we've just made
+			shard.entries.pop_back();
+			return &(*res.first)->bits;
+		}
+		entry.bits.shrinkToFit();
+		return &entry.bits;
+	}
+
+	// Free every set. No other thread may use the pool meanwhile
+	void clear()
+	{
+		for (auto& shard: shards)
+		{
+			std::lock_guard<std::mutex> guard(shard.lock);
+			std::deque<Entry>().swap(shard.entries);
+			std::unordered_set<const Entry*, EntryHash, EntryEqual>().swap(shard.table);
+		}
+		generation.fetch_add(1, std::memory_order_release);
+	}
+};
+
+AndersPtsSetPool& getPool()
+{
+	static AndersPtsSetPool pool;
+	return pool;
+}
+
+// The memoized set operations of one thread. The union cache is keyed on the ordered pair of operands
+// A cache is cleared once it holds MaxCacheEntries operations rather than growing with the number of distinct operations of the whole run: the solver mostly repeats the operations of its last few visits, and the memo only saves time
+class AndersPtsSetOpCaches
+{
+private:
+	static const unsigned MaxCacheEntries = 1 << 16;
+
+	unsigned generation;
+	DenseMap<std::pair<const BitSet*, const BitSet*>, const BitSet*> unionCache;
+	DenseMap<std::pair<const BitSet*, unsigned>, const BitSet*> insertCache;
+	DenseMap<std::pair<const BitSet*, const BitSet*>, const BitSet*> diffCache;
+
+	template <typename Cache>
+	static void record(Cache& cache, const typename Cache::key_type& key, const BitSet* result)
+	{
+		// clear() keeps the buckets, so the cache does not reallocate them every time it fills up
+		if (cache.size() >= MaxCacheEntries)
+			cache.clear();
+		cache[key] = result;
+	}
+public:
+	AndersPtsSetOpCaches(): generation(0) {}
+
+	// Drop the operations on the sets of a pool that has been released since
+	void synchronize(unsigned poolGeneration)
+	{
+		if (generation == poolGeneration)
+			return;
+		generation = poolGeneration;
+		unionCache = DenseMap<std::pair<const BitSet*, const BitSet*>, const BitSet*>();
+		insertCache = DenseMap<std::pair<const BitSet*, unsigned>, const BitSet*>();
+		diffCache = DenseMap<std::pair<const BitSet*, const BitSet*>, const BitSet*>();
+	}
+
+	const BitSet* getUnion(AndersPtsSetPool& pool, const BitSet* lhs, const BitSet* rhs)
+	{
+		if (rhs < lhs)
+			std::swap(lhs, rhs);
+
+		auto key = std::make_pair(lhs, rhs);
+		auto itr = unionCache.find(key);
+		if (itr != unionCache.end())
+			return itr->second;
+
+		// Most unions do not change the set they are applied to, so try to answer without building a new one
+		const BitSet* ret;
+		if (lhs->contains(*rhs))
+			ret = lhs;
+		else if (rhs->contains(*lhs))
+			ret = rhs;
+		else
+			ret = pool.intern(BitSet::getUnion(*lhs, *rhs));
+		record(unionCache, key, ret);
+		return ret;
+	}
+
+	const BitSet* getDifference(AndersPtsSetPool& pool, const BitSet* lhs, const BitSet* rhs)
+	{
+		auto key = std::make_pair(lhs, rhs);
+		auto itr = diffCache.find(key);
+		if (itr != diffCache.end())
+			return itr->second;
+
+		const BitSet* ret;
+		if (!lhs->intersects(*rhs))
+			ret = lhs;
+		else if (rhs->contains(*lhs))
+			ret = nullptr;
+		else
+			ret = pool.intern(BitSet::getDifference(*lhs, *rhs));
+		record(diffCache, key, ret);
+		return ret;
+	}
+
+	const BitSet* getInsert(AndersPtsSetPool& pool, const BitSet* bv, unsigned idx)
+	{
+		auto key = std::make_pair(bv, idx);
+		auto itr = insertCache.find(key);
+		if (itr != insertCache.end())
+			return itr->second;
+
+		const BitSet* ret;
+		if (bv == nullptr)
+			ret = pool.intern(BitSet(std::vector<unsigned>(1, idx)));
+		else if (bv->test(idx))
+			ret = bv;
+		else
+			ret = pool.intern(bv->withElement(idx));
+		record(insertCache, key, ret);
+		return ret;
+	}
+};
+
+AndersPtsSetOpCaches& getOpCaches()
+{
+	static thread_local AndersPtsSetOpCaches caches;
+	caches.synchronize(getPool().getGeneration());
+	return caches;
+}
+
+}	// end of anonymous namespace
+
+const BitSet& AndersPtsSet::getEmptyBitSet()
+{
+	static const BitSet emptyBitSet;
+	return emptyBitSet;
+}
+
+void AndersPtsSet::releasePool()
+{
+	getPool().clear();
+}
+
+AndersPtsSet::AndersPtsSet(const SparseBitVector<>& bv): bitvec(getPool().intern(BitSet(bv))) {}
+
+bool AndersPtsSet::insert(unsigned idx)
+{
+	const BitSet* result = getOpCaches().getInsert(getPool(), bitvec, idx);
+	if (result == bitvec)
+		return false;
+	bitvec = result;
+	return true;
+}
+
+bool AndersPtsSet::unionWith(const AndersPtsSet& other)
+{
+	if (other.bitvec == nullptr || other.bitvec == bitvec)
+		return false;
+	if (bitvec == nullptr)
+	{
+		bitvec = other.bitvec;
+		return true;
+	}
+
+	const BitSet* result = getOpCaches().getUnion(getPool(), bitvec, other.bitvec);
+	if (result == bitvec)
+		return false;
+	bitvec = result;
+	return true;
+}
+
+AndersPtsSet AndersPtsSet::getDifference(const AndersPtsSet& other) const
+{
+	AndersPtsSet ret;
+	if (bitvec == nullptr || bitvec == other.bitvec)
+		return ret;
+	if (other.bitvec == nullptr)
+		return *this;
+
+	ret.bitvec = getOpCaches().getDifference(getPool(), bitvec, other.bitvec);
+	return ret;
+}
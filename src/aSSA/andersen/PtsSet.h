@@ -1,67 +1,75 @@
 #ifndef ANDERSEN_PTSSET_H
 #define ANDERSEN_PTSSET_H
 
+#include "BitSet.h"
+
 #include "llvm/ADT/SparseBitVector.h"
 
 // We move the points-to set representation here into a separate class
 // The intention is to let us try out different internal implementation of this data-structure (e.g. vectors/bitvecs/sets, ref-counted/non-refcounted) easily
+// Points-to sets are hash-consed: equal sets share one immutable bitset owned by a global pool (see PtsSet.cpp), and an AndersPtsSet is merely a handle to it. Equality test is therefore a pointer compare, and the results of the set operations are memoized
+// The bitsets switch between a sorted vector and a word array depending on their density (see BitSet.h)
 class AndersPtsSet
 {
 private:
-	llvm::SparseBitVector<> bitvec;
+	// The interned bitset. nullptr stands for the empty set
+	const AndersBitSet* bitvec;
+
+	static const AndersBitSet& getEmptyBitSet();
 public:
-	using iterator = llvm::SparseBitVector<>::iterator;
+	using iterator = AndersBitSet::iterator;
+
+	AndersPtsSet(): bitvec(nullptr) {}
+	// Intern the given bitvector. Prefer this over repeated insert() calls when building a large set from scratch
+	explicit AndersPtsSet(const llvm::SparseBitVector<>& bv);
 
 	// Return true if *this has idx as an element
-	// This function should be marked const, but we cannot do it because SparseBitVector::test() is not marked const. WHY???
-	bool has(unsigned idx)
-	{
-		return bitvec.test(idx);
-	}
 	bool has(unsigned idx) const
 	{
-		// Since llvm::SparseBitVector::test() does not have a const quantifier, we have to use this ugly workaround to implement has()
-		llvm::SparseBitVector<> idVec;
-		idVec.set(idx);
-		return bitvec.contains(idVec);
+		return bitvec != nullptr && bitvec->test(idx);
 	}
 
 	// Return true if the ptsset changes
-	bool insert(unsigned idx)
-	{
-		return bitvec.test_and_set(idx);
-	}
+	bool insert(unsigned idx);
 
 	// Return true if *this is a superset of other
 	bool contains(const AndersPtsSet& other) const
 	{
-		return bitvec.contains(other.bitvec);
+		if (bitvec == other.bitvec || other.bitvec == nullptr)
+			return true;
+		if (bitvec == nullptr)
+			return false;
+		return bitvec->contains(*other.bitvec);
 	}
 
 	// intersectWith: return true if *this and other share points-to elements
 	bool intersectWith(const AndersPtsSet& other) const
 	{
-		return bitvec.intersects(other.bitvec);
+		if (bitvec == nullptr || other.bitvec == nullptr)
+			return false;
+		if (bitvec == other.bitvec)
+			return true;
+		return bitvec->intersects(*other.bitvec);
 	}
 
 	// Return true if the ptsset changes
-	bool unionWith(const AndersPtsSet& other)
-	{
-		return bitvec |= other.bitvec;
-	}
+	bool unionWith(const AndersPtsSet& other);
+
+	// Return the elements of *this that are not in other
+	AndersPtsSet getDifference(const AndersPtsSet& other) const;
 
 	void clear()
 	{
-		bitvec.clear();
+		bitvec = nullptr;
 	}
 
 	unsigned getSize() const
 	{
-		return bitvec.count();		// NOT a constant time operation!
+		return bitvec == nullptr ? 0 : bitvec->count();
 	}
-	bool isEmpty() const		// Always prefer using this function to perform empty test 
+	bool isEmpty() const		// Always prefer using this function to perform empty test
 	{
-		return bitvec.empty();
+		return bitvec == nullptr;
 	}
 
 	bool operator==(const AndersPtsSet& other) const
@@ -69,8 +77,14 @@ public:
 		return bitvec == other.bitvec;
 	}
 
-	iterator begin() const { return bitvec.begin(); }
-	iterator end() const { return bitvec.end(); }
+	// The interned bitset stands for the set: equal sets have the same id
+	const void* getId() const { return bitvec; }
+
+	// Free every interned set and the memoized operations. No handle may be used afterwards (see Andersen::freeze())
+	static void releasePool();
+
+	iterator begin() const { return bitvec == nullptr ? getEmptyBitSet().begin() : bitvec->begin(); }
+	iterator end() const { return bitvec == nullptr ? getEmptyBitSet().end() : bitvec->end(); }
 };
 
 #endif
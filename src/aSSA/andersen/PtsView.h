@@ -0,0 +1,37 @@
+#ifndef ANDERSEN_PTS_VIEW_H
+#define ANDERSEN_PTS_VIEW_H
+
+#include "llvm/IR/Value.h"
+
+#include <utility>
+
+// A pointee as the second getPointsToSet() gives it: the value of the object, and the index of the field
+typedef std::pair<const llvm::Value*, unsigned> AndersPointee;
+
+// A read-only view of the solved pts-to set of a pointer (see Andersen::getPointsToView()): a range over the pointees of the set, which are translated from the object nodes once per distinct set rather than once per query. Copying a view copies two pointers
+// The solved sets never change, so a view stays valid as long as the analysis does. Pointers with equal pts-to sets get views with the same id, which lets the clients compute what they derive from a set only once
+class AndersPtsView
+{
+private:
+	const AndersPointee* first;
+	const AndersPointee* last;
+	bool known;
+public:
+	typedef const AndersPointee* iterator;
+
+	// The view of a pointer the analysis knows nothing about
+	AndersPtsView(): first(nullptr), last(nullptr), known(false) {}
+	AndersPtsView(const AndersPointee* b, const AndersPointee* e): first(b), last(e), known(true) {}
+
+	// False if the pointer may point to anything, which is when getPointsToSet() returns false. Such a view is empty
+	bool isKnown() const { return known; }
+	// Equal pts-to sets have the same id
+	const void* getId() const { return first == last ? nullptr : first; }
+
+	iterator begin() const { return first; }
+	iterator end() const { return last; }
+	bool empty() const { return first == last; }
+	unsigned size() const { return last - first; }
+};
+
+#endif
@@ -0,0 +1,456 @@
+#include "Andersen.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+using namespace llvm;
+
+cl::opt<bool> UseResultCache("anders-cache", cl::desc("Load the Andersen results from an on-disk cache, or save them there after solving"), cl::init(false));
+cl::opt<std::string> ResultCacheFile("anders-cache-file", cl::desc("Path of the Andersen result cache (default: <module>.anders)"), cl::init(""));
+cl::opt<bool> IncrementalSolve("anders-incremental", cl::desc("With -anders-cache, if the module has only gained constraints since it was cached, start from the cached solution and only propagate what the new constraints add to it"), cl::init(false));
+
+extern cl::opt<bool> EnableHVN;
+extern cl::opt<bool> EnableHU;
+extern cl::opt<bool> AutoOptimize;
+extern cl::opt<bool> OnTheFlyCalls;
+extern cl::opt<bool> ReachableOnly;
+
+// Layout of the cache file. Every field is a little-endian 32-bit word, so the file can be used right from its mapping:
+//   magic[2] version numNodes maxFields flags digest[4] numElements numConstraints keyBytes
+//   mergeTarget[numNodes]
+//   ptsBegin[numNodes + 1]		(the pts-to set of node i is ptsElems[ptsBegin[i] .. ptsBegin[i + 1]))
+//   ptsElems[numElements]
+// Only the representatives have a pts-to set. The node indices are only meaningful for the very same module and options, which is what the header checks
+// With -anders-incremental, the file goes on with what it takes to reuse the solution for a different version of the module:
+//   constraints[4 * numConstraints]		(type dest src offset, as collected, before any optimization)
+//   keyBegin[numNodes + 1]
+//   keyChars[keyBytes], padded to a whole word
+// The key of a node names it independently of its index (see getNodeKeys())
+namespace {
+
+const char CacheMagic[8] = {'A', 'N', 'D', 'E', 'R', 'S', 'P', 'T'};
+const uint32_t CacheVersion = 4;
+const size_t HeaderWords = 2 + 4 + 4 + 3;
+
+std::string getCachePath(const Module& M)
+{
+	if (!ResultCacheFile.empty())
+		return ResultCacheFile;
+	return M.getModuleIdentifier() + ".anders";
+}
+
+// The options that change the nodes or the solution
+uint32_t getOptionFlags()
+{
+	// -anders-auto-opt only picks HVN and HU in optimizeConstraints(), after the lookup: until then, only the choices of the command line are known. The rest of the choice depends on the constraints, which the digest covers
+	bool hvn = EnableHVN && (!AutoOptimize || EnableHVN.getNumOccurrences() > 0);
+	bool hu = EnableHU && (!AutoOptimize || EnableHU.getNumOccurrences() > 0);
+	// The incremental solver wires the indirect calls statically (see addConstraintForCall())
+	return (hvn ? 1 : 0) | (hu ? 2 : 0) | (OnTheFlyCalls && !IncrementalSolve ? 4 : 0) | (ReachableOnly ? 8 : 0) | (AutoOptimize ? 16 : 0);
+}
+
+void writeWord(raw_ostream& os, uint32_t word)
+{
+	char buf[4];
+	support::endian::write32le(buf, word);
+	os.write(buf, 4);
+}
+
+// Give every node a name that does not depend on the order of the nodes, so that two versions of a module can be matched. Globals are named after their symbol, arguments after their position, and instructions after their name, or their position in the function if they have none. The nodes without a value are named after the last node that has one. A key shared by several nodes is useless: those nodes get an empty key
+void getNodeKeys(const Module& M, const AndersNodeFactory& nodeFactory, std::vector<std::string>& keys)
+{
+	DenseMap<const Value*, std::string> localKeys;
+	for (auto const& f: M)
+	{
+		std::string prefix = ("@" + f.getName()).str();
+		unsigned argNo = 0;
+		for (auto const& arg: f.args())
+			localKeys[&arg] = prefix + "%arg" + std::to_string(argNo++);
+		unsigned instNo = 0;
+		for (const_inst_iterator itr = inst_begin(f), ite = inst_end(f); itr != ite; ++itr, ++instNo)
+		{
+			const Instruction* inst = &*itr;
+			if (inst->hasName())
+				localKeys[inst] = prefix + "%" + inst->getName().str();
+			else
+				localKeys[inst] = prefix + "/" + std::to_string(instNo);
+		}
+	}
+
+	auto getValueKey = [&localKeys](const Value* v) -> std::string
+	{
+		if (const GlobalValue* gv = dyn_cast<GlobalValue>(v))
+			return gv->hasName() ? ("@" + gv->getName()).str() : std::string();
+		auto itr = localKeys.find(v);
+		if (itr != localKeys.end())
+			return itr->second;
+		if (isa<Constant>(v))
+		{
+			std::string text;
+			raw_string_ostream os(text);
+			v->print(os);
+			return os.str();
+		}
+		return std::string();
+	};
+
+	unsigned numNodes = nodeFactory.getNumNodes();
+	keys.clear();
+	keys.resize(numNodes);
+	NodeIndex anchor = 0;
+	for (NodeIndex i = 0; i < numNodes; ++i)
+	{
+		const Value* v = nodeFactory.getValueForNode(i);
+		std::string valueKey = v == nullptr ? std::string() : getValueKey(v);
+		if (i < 4)
+			keys[i] = "#" + std::to_string(i);
+		else if (valueKey.empty())
+		{
+			if (!keys[anchor].empty())
+				keys[i] = keys[anchor] + "+" + std::to_string(i - anchor);
+			continue;
+		}
+		else if (nodeFactory.isObjectNode(i))
+		{
+			const Function* f = dyn_cast<Function>(v);
+			if (f != nullptr && nodeFactory.getVarargNodeFor(f) == i)
+				keys[i] = "va:" + valueKey;
+			else
+				keys[i] = "obj:" + valueKey + "#" + std::to_string(nodeFactory.getObjectOffset(i));
+		}
+		else
+		{
+			const Function* f = dyn_cast<Function>(v);
+			if (f != nullptr && nodeFactory.getReturnNodeFor(f) == i)
+				keys[i] = "ret:" + valueKey;
+			else
+				keys[i] = "val:" + valueKey;
+		}
+		anchor = i;
+	}
+
+	StringMap<unsigned> keyCount;
+	for (auto const& key: keys)
+	{
+		if (!key.empty())
+			++keyCount[key];
+	}
+	for (auto& key: keys)
+	{
+		if (!key.empty() && keyCount[key] > 1)
+			key.clear();
+	}
+}
+
+}	// end of anonymous namespace
+
+// The solution only depends on the collected constraints, the nodes and the indirect calls, which is what a constraint dump holds. Hashing them costs a fraction of printing the module, and the changes to the module that leave them alone keep the cache valid: the solution is the same for them
+void Andersen::computeInputDigest()
+{
+	std::string input;
+	raw_string_ostream os(input);
+	writeSolverInput(os);
+	os.flush();
+
+	MD5 hash;
+	hash.update(input);
+	MD5::MD5Result result;
+	hash.final(result);
+	inputDigest.assign(reinterpret_cast<const char*>(&result[0]), 16);
+}
+
+bool Andersen::loadCachedResults(const Module& M)
+{
+	if (!UseResultCache)
+		return false;
+
+	computeInputDigest();
+	if (IncrementalSolve)
+	{
+		// Keep the constraints as collected: they are what the next version of the module is compared against
+		collectedConstraints = constraints;
+		getNodeKeys(M, nodeFactory, nodeKeys);
+	}
+
+	std::string path = getCachePath(M);
+	// A missing cache is the normal case on the first run
+	if (!sys::fs::exists(path))
+		return false;
+
+	auto bufOrErr = MemoryBuffer::getFile(path, -1, false);
+	if (!bufOrErr)
+	{
+		errs() << "Cannot read the Andersen cache " << path << ": " << bufOrErr.getError().message() << '\n';
+		return false;
+	}
+
+	StringRef data = (*bufOrErr)->getBuffer();
+	const char* words = data.data();
+	auto getWord = [words](size_t i) -> uint32_t
+	{
+		return support::endian::read32le(words + 4 * i);
+	};
+
+	if (data.size() < 4 * HeaderWords || std::memcmp(words, CacheMagic, 8) != 0 || getWord(2) != CacheVersion || getWord(4) != nodeFactory.getMaxFields() || getWord(5) != getOptionFlags())
+	{
+		errs() << "The Andersen cache " << path << " does not match these options, solving again\n";
+		return false;
+	}
+
+	uint32_t numCachedNodes = getWord(3);
+	uint64_t numElements = getWord(10), numConstraints = getWord(11), keyBytes = getWord(12);
+	size_t mergeBase = HeaderWords, ptsBeginBase = mergeBase + numCachedNodes, ptsElemsBase = ptsBeginBase + numCachedNodes + 1;
+	size_t constraintBase = ptsElemsBase + numElements, keyBeginBase = constraintBase + 4 * numConstraints, keyCharsBase = keyBeginBase + numCachedNodes + 1;
+	size_t expectedSize = keyBytes == 0 ? 4 * constraintBase : 4 * keyCharsBase + alignTo(keyBytes, 4);
+	if (data.size() != expectedSize)
+	{
+		errs() << "The Andersen cache " << path << " is truncated, solving again\n";
+		return false;
+	}
+
+	// Check everything before touching the analysis state, so that a corrupted file leaves us with a clean fallback
+	for (NodeIndex i = 0; i < numCachedNodes; ++i)
+	{
+		NodeIndex rep = getWord(mergeBase + i);
+		uint32_t begin = getWord(ptsBeginBase + i), end = getWord(ptsBeginBase + i + 1);
+		if (rep >= numCachedNodes || getWord(mergeBase + rep) != rep || begin > end || end > numElements || (rep != i && begin != end))
+		{
+			errs() << "The Andersen cache " << path << " is corrupted, solving again\n";
+			return false;
+		}
+	}
+	for (uint64_t i = 0; i < numElements; ++i)
+	{
+		if (getWord(ptsElemsBase + i) >= numCachedNodes)
+		{
+			errs() << "The Andersen cache " << path << " is corrupted, solving again\n";
+			return false;
+		}
+	}
+
+	if (numCachedNodes != nodeFactory.getNumNodes() || std::memcmp(words + 24, inputDigest.data(), 16) != 0)
+	{
+		if (!IncrementalSolve || keyBytes == 0)
+		{
+			errs() << "The Andersen cache " << path << " does not match the constraints of this module, solving again\n";
+			return false;
+		}
+
+		// The cached solution is a subset of the new one only if none of the cached constraints is gone. Then the solver may start from it instead of from scratch
+		// Map the cached nodes to ours through their keys
+		StringMap<NodeIndex> keyMap;
+		for (NodeIndex i = 0, e = nodeKeys.size(); i < e; ++i)
+		{
+			if (!nodeKeys[i].empty())
+				keyMap[nodeKeys[i]] = i;
+		}
+		std::vector<NodeIndex> nodeMap(numCachedNodes, AndersNodeFactory::InvalidIndex);
+		for (NodeIndex i = 0; i < numCachedNodes; ++i)
+		{
+			uint32_t begin = getWord(keyBeginBase + i), end = getWord(keyBeginBase + i + 1);
+			if (begin >= end || end > keyBytes)
+				continue;
+			auto itr = keyMap.find(StringRef(words + 4 * keyCharsBase + begin, end - begin));
+			if (itr != keyMap.end())
+				nodeMap[i] = itr->second;
+		}
+
+		std::vector<AndersConstraint> sortedConstraints(collectedConstraints);
+		std::sort(sortedConstraints.begin(), sortedConstraints.end());
+		std::vector<AndersConstraint> cachedConstraints;
+		cachedConstraints.reserve(numConstraints);
+		for (uint64_t i = 0; i < numConstraints; ++i)
+		{
+			size_t base = constraintBase + 4 * i;
+			uint32_t type = getWord(base), dest = getWord(base + 1), src = getWord(base + 2);
+			if (type > AndersConstraint::GEP || dest >= numCachedNodes || src >= numCachedNodes || nodeMap[dest] == AndersNodeFactory::InvalidIndex || nodeMap[src] == AndersNodeFactory::InvalidIndex)
+			{
+				errs() << "Some constraints have been removed since the Andersen cache " << path << " was written, solving again\n";
+				return false;
+			}
+			AndersConstraint c(static_cast<AndersConstraint::ConstraintType>(type), nodeMap[dest], nodeMap[src], getWord(base + 3));
+			if (!std::binary_search(sortedConstraints.begin(), sortedConstraints.end(), c))
+			{
+				errs() << "Some constraints have been removed since the Andersen cache " << path << " was written, solving again\n";
+				return false;
+			}
+			cachedConstraints.push_back(c);
+		}
+		// The constraints the cached solution may not satisfy
+		std::vector<AndersConstraint> addedConstraints;
+		std::sort(cachedConstraints.begin(), cachedConstraints.end());
+		std::set_difference(sortedConstraints.begin(), sortedConstraints.end(), cachedConstraints.begin(), cachedConstraints.end(), std::back_inserter(addedConstraints));
+
+		// Every cached node starts from its cached solution, and the solver only propagates what the new constraints add to it. The node merges are not reused: the new constraints may tell apart the nodes that HVN or HU found equivalent
+		AndersPtsGraph seeds(nodeFactory.getNumNodes());
+		for (NodeIndex i = 0; i < numCachedNodes; ++i)
+		{
+			NodeIndex rep = getWord(mergeBase + i);
+			uint32_t begin = getWord(ptsBeginBase + rep), end = getWord(ptsBeginBase + rep + 1);
+			if (nodeMap[i] == AndersNodeFactory::InvalidIndex || begin == end)
+				continue;
+
+			SparseBitVector<> ptsSet;
+			for (uint32_t j = begin; j < end; ++j)
+			{
+				NodeIndex elem = nodeMap[getWord(ptsElemsBase + j)];
+				if (elem == AndersNodeFactory::InvalidIndex)
+				{
+					errs() << "Some objects have been removed since the Andersen cache " << path << " was written, solving again\n";
+					return false;
+				}
+				ptsSet.set(elem);
+			}
+			seeds[nodeMap[i]] = AndersPtsSet(ptsSet);
+		}
+
+		errs() << "Re-solving from the Andersen cache " << path << " (" << addedConstraints.size() << " new constraints)\n";
+		seedPtsGraph.swap(seeds);
+		newConstraints.swap(addedConstraints);
+		return false;
+	}
+
+	for (NodeIndex i = 0; i < numCachedNodes; ++i)
+	{
+		NodeIndex rep = getWord(mergeBase + i);
+		if (rep != i)
+			nodeFactory.mergeNode(rep, i);
+	}
+
+	ptsGraph.clear();
+	ptsGraph.resize(numCachedNodes);
+	for (NodeIndex i = 0; i < numCachedNodes; ++i)
+	{
+		uint32_t begin = getWord(ptsBeginBase + i), end = getWord(ptsBeginBase + i + 1);
+		if (begin == end)
+			continue;
+
+		SparseBitVector<> ptsSet;
+		for (uint32_t j = begin; j < end; ++j)
+			ptsSet.set(getWord(ptsElemsBase + j));
+		ptsGraph[i] = AndersPtsSet(ptsSet);
+	}
+
+	// The constraints are only needed for solving
+	constraints.clear();
+	collectedConstraints.clear();
+	return true;
+}
+
+void Andersen::saveCachedResults(const Module& M) const
+{
+	if (!UseResultCache)
+		return;
+
+	std::string path = getCachePath(M);
+	// Write to a temporary file first: another run may be reading the cache right now
+	int fd;
+	SmallString<128> tmpPath;
+	if (std::error_code ec = sys::fs::createUniqueFile(path + ".tmp%%%%%%", fd, tmpPath))
+	{
+		errs() << "Cannot write the Andersen cache " << path << ": " << ec.message() << '\n';
+		return;
+	}
+
+	{
+		raw_fd_ostream os(fd, true);
+
+		uint32_t numNodes = nodeFactory.getNumNodes();
+		uint32_t numElements = 0;
+		for (NodeIndex i = 0; i < numNodes; ++i)
+		{
+			if (nodeFactory.getMergeTarget(i) == i)
+				numElements += ptsGraph[i].getSize();
+		}
+		uint32_t keyBytes = 0;
+		if (IncrementalSolve)
+		{
+			for (auto const& key: nodeKeys)
+				keyBytes += key.size();
+		}
+
+		os.write(CacheMagic, 8);
+		writeWord(os, CacheVersion);
+		writeWord(os, numNodes);
+		writeWord(os, nodeFactory.getMaxFields());
+		writeWord(os, getOptionFlags());
+		os.write(inputDigest.data(), 16);
+		writeWord(os, numElements);
+		writeWord(os, keyBytes == 0 ? 0 : collectedConstraints.size());
+		writeWord(os, keyBytes);
+
+		for (NodeIndex i = 0; i < numNodes; ++i)
+			writeWord(os, nodeFactory.getMergeTarget(i));
+
+		uint32_t offset = 0;
+		for (NodeIndex i = 0; i < numNodes; ++i)
+		{
+			writeWord(os, offset);
+			if (nodeFactory.getMergeTarget(i) == i)
+				offset += ptsGraph[i].getSize();
+		}
+		writeWord(os, offset);
+
+		for (NodeIndex i = 0; i < numNodes; ++i)
+		{
+			if (nodeFactory.getMergeTarget(i) != i)
+				continue;
+			for (auto v: ptsGraph[i])
+				writeWord(os, v);
+		}
+
+		if (keyBytes != 0)
+		{
+			for (auto const& c: collectedConstraints)
+			{
+				writeWord(os, c.getType());
+				writeWord(os, c.getDest());
+				writeWord(os, c.getSrc());
+				writeWord(os, c.getOffset());
+			}
+
+			offset = 0;
+			for (auto const& key: nodeKeys)
+			{
+				writeWord(os, offset);
+				offset += key.size();
+			}
+			writeWord(os, offset);
+
+			for (auto const& key: nodeKeys)
+				os << key;
+			for (uint32_t i = keyBytes; i % 4 != 0; ++i)
+				os << '\0';
+		}
+
+		os.close();
+		if (os.has_error())
+		{
+			errs() << "Cannot write the Andersen cache " << path << '\n';
+			os.clear_error();
+			sys::fs::remove(tmpPath);
+			return;
+		}
+	}
+
+	if (std::error_code ec = sys::fs::rename(tmpPath, path))
+	{
+		errs() << "Cannot write the Andersen cache " << path << ": " << ec.message() << '\n';
+		sys::fs::remove(tmpPath);
+	}
+}
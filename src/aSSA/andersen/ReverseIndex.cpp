@@ -0,0 +1,82 @@
+#include "ReverseIndex.h"
+
+#include "llvm/ADT/Statistic.h"
+
+#define DEBUG_TYPE "andersen"
+
+using namespace llvm;
+
+STATISTIC(NumReverseClasses, "Number of pointer classes in the reverse pts-to index");
+STATISTIC(NumReverseEntries, "Number of (object, pointer class) entries in the reverse pts-to index");
+
+void AndersReverseIndex::build(const AndersFrozenPtsGraph& frozenGraph)
+{
+	// The frozen sets are in the order of the nodes, which makes the classes, and thus the answers, the same from one run to the next
+	// Number the sets that point to something in the order of their first pointer, and count their pointers
+	const std::vector<std::pair<const Value*, unsigned>>& pointers = frozenGraph.getPointers();
+	std::vector<unsigned> setClasses(frozenGraph.getNumSets(), AndersNodeFactory::InvalidIndex);
+	std::vector<unsigned> classSets;
+	classOffsets.assign(1, 0);
+	for (auto const& ptr: pointers)
+	{
+		if (frozenGraph.getSet(ptr.second).empty())
+			continue;
+
+		unsigned& cls = setClasses[ptr.second];
+		if (cls == AndersNodeFactory::InvalidIndex)
+		{
+			cls = classSets.size();
+			classSets.push_back(ptr.second);
+			classOffsets.push_back(0);
+		}
+		++classOffsets[cls + 1];
+	}
+	for (unsigned c = 1, e = classOffsets.size(); c < e; ++c)
+		classOffsets[c] += classOffsets[c - 1];
+
+	std::vector<unsigned> fillPos(classOffsets.begin(), classOffsets.end() - 1);
+	classPointers.resize(classOffsets.back());
+	for (auto const& ptr: pointers)
+	{
+		unsigned cls = setClasses[ptr.second];
+		if (cls != AndersNodeFactory::InvalidIndex)
+			classPointers[fillPos[cls]++] = ptr.first;
+	}
+
+	// Then the same counting sort for the objects: count the classes of each object slot, and list them in class order
+	unsigned numSlots = frozenGraph.getNumObjectSlots();
+	objOffsets.assign(numSlots + 1, 0);
+	for (auto s: classSets)
+	{
+		for (auto const& pointee: frozenGraph.getSet(s))
+		{
+			unsigned slot = frozenGraph.getObjectSlot(pointee.first, pointee.second);
+			if (slot != AndersNodeFactory::InvalidIndex)
+				++objOffsets[slot + 1];
+		}
+	}
+	for (unsigned o = 1; o <= numSlots; ++o)
+		objOffsets[o] += objOffsets[o - 1];
+
+	fillPos.assign(objOffsets.begin(), objOffsets.end() - 1);
+	objClasses.resize(objOffsets.back());
+	for (unsigned c = 0, e = classSets.size(); c < e; ++c)
+	{
+		for (auto const& pointee: frozenGraph.getSet(classSets[c]))
+		{
+			unsigned slot = frozenGraph.getObjectSlot(pointee.first, pointee.second);
+			if (slot != AndersNodeFactory::InvalidIndex)
+				objClasses[fillPos[slot]++] = c;
+		}
+	}
+
+	NumReverseClasses += classSets.size();
+	NumReverseEntries += objClasses.size();
+}
+
+AndersReverseIndex::PointerRange AndersReverseIndex::getPointersTo(unsigned obj) const
+{
+	if (obj >= getNumObjectSlots())
+		return PointerRange(iterator(this, 0, 0), iterator(this, 0, 0));
+	return PointerRange(iterator(this, objOffsets[obj], objOffsets[obj + 1]), iterator(this, objOffsets[obj + 1], objOffsets[obj + 1]));
+}
@@ -0,0 +1,102 @@
+#ifndef ANDERSEN_REVERSE_INDEX_H
+#define ANDERSEN_REVERSE_INDEX_H
+
+#include "FrozenPtsGraph.h"
+
+#include "llvm/IR/Value.h"
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+// The inverse of the frozen points-to graph: for every field of every object, the pointer values whose pts-to set has it (see Andersen::getReverseIndex())
+// Many pointers share one pts-to set, so the index has two levels: each object slot (see AndersFrozenPtsGraph::getObjectSlot()) lists the classes of pointers that point to it, one class per distinct set, and each class lists its pointer values. Both levels are flat arrays with an offset per entry, hence a query is two lookups and walking the answer
+// The index is built once from the frozen graph and never changes afterwards
+class AndersReverseIndex
+{
+private:
+	// The classes that point to object slot o are objClasses[objOffsets[o]] up to objClasses[objOffsets[o + 1]]
+	std::vector<unsigned> objOffsets;
+	std::vector<unsigned> objClasses;
+	// Likewise, the pointer values of class c. Every class has at least one
+	std::vector<unsigned> classOffsets;
+	std::vector<const llvm::Value*> classPointers;
+
+	unsigned getNumObjectSlots() const { return objOffsets.empty() ? 0 : objOffsets.size() - 1; }
+public:
+	// Walks the pointers of the classes objClasses[classPos] up to objClasses[classEnd]
+	class iterator
+	{
+	private:
+		const AndersReverseIndex* index;
+		unsigned classPos, classEnd;
+		// The position of the current pointer in classPointers. 0 at the end, so that all the end iterators compare equal
+		unsigned ptrPos;
+
+		void enterClass()
+		{
+			ptrPos = classPos < classEnd ? index->classOffsets[index->objClasses[classPos]] : 0;
+		}
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef const llvm::Value* value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const llvm::Value* const* pointer;
+		typedef const llvm::Value* reference;
+
+		iterator(const AndersReverseIndex* i, unsigned pos, unsigned end): index(i), classPos(pos), classEnd(end)
+		{
+			enterClass();
+		}
+
+		const llvm::Value* operator*() const { return index->classPointers[ptrPos]; }
+		iterator& operator++()
+		{
+			if (++ptrPos == index->classOffsets[index->objClasses[classPos] + 1])
+			{
+				++classPos;
+				enterClass();
+			}
+			return *this;
+		}
+		iterator operator++(int)
+		{
+			iterator ret = *this;
+			++*this;
+			return ret;
+		}
+		bool operator==(const iterator& other) const { return classPos == other.classPos && ptrPos == other.ptrPos; }
+		bool operator!=(const iterator& other) const { return !(*this == other); }
+	};
+
+	// The pointers to one object slot, in no particular order but always the same one. Each pointer is only there once
+	class PointerRange
+	{
+	private:
+		iterator first, last;
+	public:
+		PointerRange(iterator b, iterator e): first(b), last(e) {}
+
+		iterator begin() const { return first; }
+		iterator end() const { return last; }
+		bool empty() const { return first == last; }
+	};
+
+	AndersReverseIndex() {}
+
+	// Index the pts-to sets of frozenGraph
+	void build(const AndersFrozenPtsGraph& frozenGraph);
+
+	// The pointers whose pts-to set has object slot obj. Empty if obj is InvalidIndex
+	PointerRange getPointersTo(unsigned obj) const;
+	// The number of classes of pointers to obj, which is what building the answer to getPointersTo() costs on top of its size
+	unsigned getNumClassesTo(unsigned obj) const
+	{
+		return obj < getNumObjectSlots() ? objOffsets[obj + 1] - objOffsets[obj] : 0;
+	}
+
+	unsigned getNumClasses() const { return classOffsets.empty() ? 0 : classOffsets.size() - 1; }
+	unsigned getNumEntries() const { return objClasses.size(); }
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "UnificationSolver.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/Statistic.h"
+
+#define DEBUG_TYPE "andersen"
+
+using namespace llvm;
+
+STATISTIC(NumUnifications, "Number of class unifications of the unification solver");
+STATISTIC(NumUnificationRounds, "Number of rounds of indirect call resolution of the unification solver");
+
+AndersUnificationSolver::AndersUnificationSolver(AndersNodeFactory& n, const std::vector<AndersIndirectCall>& c, const std::vector<AndersCallTarget>& t): nodeFactory(n), calls(c), targets(t), numUnions(0)
+{
+	for (unsigned i = 0, e = nodeFactory.getNumNodes(); i < e; ++i)
+		addClass();
+}
+
+NodeIndex AndersUnificationSolver::addClass()
+{
+	NodeIndex idx = classes.addNode();
+	pointee.push_back(AndersNodeFactory::InvalidIndex);
+	nextMember.push_back(idx);
+	return idx;
+}
+
+NodeIndex AndersUnificationSolver::getPointee(NodeIndex n)
+{
+	NodeIndex rep = classes.find(n);
+	if (pointee[rep] == AndersNodeFactory::InvalidIndex)
+	{
+		// addClass() may move the vector, hence the temporary
+		NodeIndex newClass = addClass();
+		pointee[rep] = newClass;
+	}
+	return pointee[rep];
+}
+
+void AndersUnificationSolver::unify(NodeIndex n0, NodeIndex n1)
+{
+	// Unifying two classes unifies their pointees, which may unify their own pointees: a worklist keeps the recursion off the stack
+	pending.push_back(std::make_pair(n0, n1));
+	while (!pending.empty())
+	{
+		NodeIndex rep0 = classes.find(pending.back().first);
+		NodeIndex rep1 = classes.find(pending.back().second);
+		pending.pop_back();
+		if (rep0 == rep1)
+			continue;
+
+		++NumUnifications;
+		++numUnions;
+		classes.unite(rep0, rep1);
+		std::swap(nextMember[rep0], nextMember[rep1]);
+
+		NodeIndex pointee0 = pointee[rep0], pointee1 = pointee[rep1];
+		if (pointee0 == AndersNodeFactory::InvalidIndex)
+			pointee[rep0] = pointee1;
+		else if (pointee1 != AndersNodeFactory::InvalidIndex)
+			pending.push_back(std::make_pair(pointee0, pointee1));
+	}
+}
+
+void AndersUnificationSolver::addConstraint(const AndersConstraint& c)
+{
+	NodeIndex dest = c.getDest(), src = c.getSrc();
+	// Null is not a memory object anybody looks at: unifying with it would put all the pointers that may be null in the same class
+	if (src == nodeFactory.getNullPtrNode() || src == nodeFactory.getNullObjectNode())
+		return;
+
+	switch (c.getType())
+	{
+		case AndersConstraint::ADDR_OF:
+			unify(getPointee(dest), src);
+			break;
+		// The fields of an object are one class, so a gep points to the same class as its pointer
+		case AndersConstraint::COPY:
+		case AndersConstraint::GEP:
+			unify(getPointee(dest), getPointee(src));
+			break;
+		case AndersConstraint::LOAD:
+			unify(getPointee(dest), getPointee(getPointee(src)));
+			break;
+		case AndersConstraint::STORE:
+			unify(getPointee(getPointee(dest)), getPointee(src));
+			break;
+	}
+}
+
+void AndersUnificationSolver::wireCall(const AndersIndirectCall& call, const AndersCallTarget& target)
+{
+	// #arg mismatch
+	if (target.vararg == AndersNodeFactory::InvalidIndex && target.formals.size() != call.args.size())
+		return;
+
+	unsigned numArgs = std::min(target.formals.size(), call.args.size());
+	for (unsigned i = 0; i < numArgs; ++i)
+	{
+		if (target.formals[i] != AndersNodeFactory::InvalidIndex)
+			unify(getPointee(target.formals[i]), getPointee(call.args[i] != AndersNodeFactory::InvalidIndex ? call.args[i] : nodeFactory.getUniversalPtrNode()));
+	}
+
+	if (target.vararg != AndersNodeFactory::InvalidIndex)
+	{
+		for (unsigned i = numArgs, e = call.args.size(); i < e; ++i)
+		{
+			if (call.args[i] != AndersNodeFactory::InvalidIndex)
+				unify(getPointee(target.vararg), getPointee(call.args[i]));
+		}
+	}
+
+	if (call.ret != AndersNodeFactory::InvalidIndex)
+		unify(getPointee(call.ret), getPointee(target.ret != AndersNodeFactory::InvalidIndex ? target.ret : nodeFactory.getUniversalPtrNode()));
+}
+
+void AndersUnificationSolver::resolveIndirectCalls()
+{
+	if (calls.empty())
+		return;
+
+	DenseMap<NodeIndex, unsigned> targetMap;
+	for (unsigned i = 0, e = targets.size(); i < e; ++i)
+		targetMap[targets[i].obj] = i;
+	// The targets each call has been wired to. Index targets.size() stands for the universal object, whose call may go anywhere and return anything
+	const unsigned universalTarget = targets.size();
+	std::vector<SparseBitVector<>> resolved(calls.size());
+
+	// Wiring a call unifies classes, which may give the called pointers new pointees: go on until a round wires nothing
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		++NumUnificationRounds;
+
+		// The targets found in each class, so that the class that many called pointers share is only scanned once per round. A list gets stale when its class is unified during the round, but the next round sees the new members
+		DenseMap<NodeIndex, std::vector<unsigned>> classTargets;
+		for (unsigned i = 0, e = calls.size(); i < e; ++i)
+		{
+			NodeIndex funClass = pointee[classes.find(calls[i].funPtr)];
+			if (funClass == AndersNodeFactory::InvalidIndex)
+				continue;
+			funClass = classes.find(funClass);
+
+			auto ins = classTargets.insert(std::make_pair(funClass, std::vector<unsigned>()));
+			std::vector<unsigned>& found = ins.first->second;
+			if (ins.second)
+			{
+				NodeIndex member = funClass;
+				do
+				{
+					if (member == nodeFactory.getUniversalObjNode())
+						found.push_back(universalTarget);
+					else
+					{
+						auto itr = targetMap.find(member);
+						if (itr != targetMap.end())
+							found.push_back(itr->second);
+					}
+					member = nextMember[member];
+				} while (member != funClass);
+			}
+
+			for (auto t: found)
+			{
+				if (!resolved[i].test_and_set(t))
+					continue;
+				changed = true;
+				if (t != universalTarget)
+				{
+					wireCall(calls[i], targets[t]);
+					continue;
+				}
+
+				for (unsigned j = 0, je = targets.size(); j < je; ++j)
+				{
+					if (resolved[i].test_and_set(j))
+						wireCall(calls[i], targets[j]);
+				}
+				if (calls[i].ret != AndersNodeFactory::InvalidIndex)
+					unify(getPointee(calls[i].ret), getPointee(nodeFactory.getUniversalPtrNode()));
+			}
+		}
+	}
+}
+
+void AndersUnificationSolver::run(const std::vector<AndersConstraint>& constraints, const std::vector<AndersPtsSet>& seeds, std::vector<AndersPtsSet>& ptsGraph)
+{
+	unsigned numNodes = nodeFactory.getNumNodes();
+
+	// Start from the merges made so far, e.g. by HVN, and from the fields of each object being one class
+	for (NodeIndex n = 0; n < numNodes; ++n)
+	{
+		NodeIndex rep = nodeFactory.getMergeTarget(n);
+		if (rep != n)
+			unify(rep, n);
+		if (nodeFactory.isObjectNode(n) && nodeFactory.getObjectOffset(n) == 0)
+		{
+			for (unsigned i = 1, e = nodeFactory.getObjectSize(n); i < e; ++i)
+				unify(n, n + i);
+		}
+	}
+
+	for (auto const& c: constraints)
+		addConstraint(c);
+	for (NodeIndex n = 0, e = seeds.size(); n < e; ++n)
+	{
+		for (auto obj: seeds[n])
+			unify(getPointee(n), obj);
+	}
+	resolveIndirectCalls();
+
+	// The first node of each class represents it, and the others are merged into it
+	std::vector<NodeIndex> classRep(classes.size(), AndersNodeFactory::InvalidIndex);
+	for (NodeIndex n = 0; n < numNodes; ++n)
+	{
+		NodeIndex rep = classes.find(n);
+		if (classRep[rep] == AndersNodeFactory::InvalidIndex)
+			classRep[rep] = n;
+		else
+			nodeFactory.mergeNode(classRep[rep], n);
+	}
+
+	// The pts-to set of a class is made of the objects of the class it points to. Many classes point to the same one, so each set is only built once
+	ptsGraph.clear();
+	ptsGraph.resize(numNodes);
+	DenseMap<NodeIndex, AndersPtsSet> classPtsSets;
+	for (NodeIndex n = 0; n < numNodes; ++n)
+	{
+		NodeIndex rep = classes.find(n);
+		if (classRep[rep] != n || pointee[rep] == AndersNodeFactory::InvalidIndex)
+			continue;
+
+		NodeIndex pointeeClass = classes.find(pointee[rep]);
+		auto itr = classPtsSets.find(pointeeClass);
+		if (itr == classPtsSets.end())
+		{
+			SparseBitVector<> objs;
+			NodeIndex member = pointeeClass;
+			do
+			{
+				if (member < numNodes && nodeFactory.isObjectNode(member))
+					objs.set(member);
+				member = nextMember[member];
+			} while (member != pointeeClass);
+			itr = classPtsSets.insert(std::make_pair(pointeeClass, objs.empty() ? AndersPtsSet() : AndersPtsSet(objs))).first;
+		}
+		ptsGraph[nodeFactory.getMergeTarget(n)] = itr->second;
+	}
+}
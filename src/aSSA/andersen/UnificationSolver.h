@@ -0,0 +1,52 @@
+#ifndef ANDERSEN_UNIFICATION_SOLVER_H
+#define ANDERSEN_UNIFICATION_SOLVER_H
+
+#include "Constraint.h"
+#include "NodeFactory.h"
+#include "PtsSet.h"
+#include "UnionFind.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A unification-based (Steensgaard) solver for the Andersen constraints, for the modules the inclusion solvers are too slow on (-anders-solver=unification)
+// Every constraint unifies two classes of nodes instead of adding an inclusion edge, so that all the nodes of a class point to the same class. Each constraint is looked at once, and the unifications run in near-linear time in the number of nodes. The fields of an object are unified with each other, which makes a gep a plain copy
+// The solution is a superset of the inclusion-based one: the classes become node merges in the node factory, and the pts-to set of a class is the set of object nodes of the class it points to
+class AndersUnificationSolver
+{
+private:
+	AndersNodeFactory& nodeFactory;
+	const std::vector<AndersIndirectCall>& calls;
+	const std::vector<AndersCallTarget>& targets;
+
+	// The classes of nodes. The indices past the nodes of the node factory stand for the pointees of the classes that do not point to any node yet
+	AndersUnionFind classes;
+	// The class each class points to, or InvalidIndex. Only the entries of the representatives are meaningful
+	std::vector<NodeIndex> pointee;
+	// The members of each class, as a circular list. Splicing two lists is what unifies their members
+	std::vector<NodeIndex> nextMember;
+	// The pairs of classes that still have to be unified
+	std::vector<std::pair<NodeIndex, NodeIndex>> pending;
+	uint64_t numUnions;
+
+	NodeIndex addClass();
+	// Return the class n points to, giving it a new one if it has none
+	NodeIndex getPointee(NodeIndex n);
+	// Unify the classes of n0 and n1, then their pointees, and so on
+	void unify(NodeIndex n0, NodeIndex n1);
+	void addConstraint(const AndersConstraint& c);
+	// The constraints of a direct call from call to target. This mirrors IndirectCallResolver::wireCall()
+	void wireCall(const AndersIndirectCall& call, const AndersCallTarget& target);
+	// Wire the indirect calls to the functions their called pointers point to, until no call gets a new target
+	void resolveIndirectCalls();
+public:
+	AndersUnificationSolver(AndersNodeFactory& n, const std::vector<AndersIndirectCall>& c, const std::vector<AndersCallTarget>& t);
+
+	// Solve the constraints, seeds being lower bounds of the pts-to sets as in Andersen::solveConstraints(). Then merge the nodes of each class in the node factory and fill ptsGraph
+	void run(const std::vector<AndersConstraint>& constraints, const std::vector<AndersPtsSet>& seeds, std::vector<AndersPtsSet>& ptsGraph);
+
+	uint64_t getNumUnions() const { return numUnions; }
+};
+
+#endif
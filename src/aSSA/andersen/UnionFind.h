@@ -0,0 +1,181 @@
+#ifndef ANDERSEN_UNION_FIND_H
+#define ANDERSEN_UNION_FIND_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+typedef unsigned NodeIndex;
+
+// The merge targets of the nodes: a union-find with union by rank and path halving, which never allocates besides growing with the nodes
+// The clients of the node factory choose which node represents a merged set (see AndersNodeFactory::mergeNode()), which is not necessarily the root that union by rank picks. So each root also records the representative of its set
+class AndersUnionFind
+{
+private:
+	std::vector<NodeIndex> parent;
+	// Upper bound of the height of the tree of each root. It fits in a byte since it never exceeds log2 of the number of nodes
+	std::vector<uint8_t> rank;
+	// The representative of the set of each root
+	std::vector<NodeIndex> rep;
+
+	NodeIndex findRoot(NodeIndex n)
+	{
+		// Path halving: point every other node on the path to its grandparent as we go
+		while (parent[n] != n)
+		{
+			parent[n] = parent[parent[n]];
+			n = parent[n];
+		}
+		return n;
+	}
+	// Without path halving, the const lookup may run concurrently with other const lookups. Union by rank keeps the trees O(log n) high anyway
+	NodeIndex findRoot(NodeIndex n) const
+	{
+		while (parent[n] != n)
+			n = parent[n];
+		return n;
+	}
+public:
+	NodeIndex addNode()
+	{
+		NodeIndex idx = parent.size();
+		parent.push_back(idx);
+		rank.push_back(0);
+		rep.push_back(idx);
+		return idx;
+	}
+
+	unsigned size() const { return parent.size(); }
+
+	// Merge the set of n1 into the set of n0. The representative of n0 represents the merged set
+	void unite(NodeIndex n0, NodeIndex n1)
+	{
+		assert(n0 < parent.size() && n1 < parent.size());
+		NodeIndex r0 = findRoot(n0), r1 = findRoot(n1);
+		if (r0 == r1)
+			return;
+
+		NodeIndex setRep = rep[r0];
+		if (rank[r0] < rank[r1])
+			std::swap(r0, r1);
+		parent[r1] = r0;
+		if (rank[r0] == rank[r1])
+			++rank[r0];
+		rep[r0] = setRep;
+	}
+
+	NodeIndex find(NodeIndex n)
+	{
+		assert(n < parent.size());
+		return rep[findRoot(n)];
+	}
+	NodeIndex find(NodeIndex n) const
+	{
+		assert(n < parent.size());
+		return rep[findRoot(n)];
+	}
+};
+
+// A lock-free union-find, which the parallel solver uses so that its threads may compress paths as they look nodes up (see AndersNodeFactory::beginConcurrentMerges())
+// The parent and the rank of a node are packed into one atomic word, so that linking a root under another one is a single compare-and-swap. Path halving is a compare-and-swap too, and losing it to another thread is harmless: whatever the other thread wrote is a node higher on the same path
+// As in AndersUnionFind, each root also records the representative of its set. The sets are always right, but while several threads merge the same sets, find() may return another member of the merged set than the one unite() has picked to represent it
+class AndersConcurrentUnionFind
+{
+private:
+	std::unique_ptr<std::atomic<uint64_t>[]> words;
+	std::unique_ptr<std::atomic<NodeIndex>[]> reps;
+	unsigned numNodes;
+
+	static uint64_t makeWord(NodeIndex parent, unsigned rank) { return (static_cast<uint64_t>(rank) << 32) | parent; }
+	static NodeIndex getParent(uint64_t word) { return static_cast<NodeIndex>(word); }
+	static unsigned getRank(uint64_t word) { return static_cast<unsigned>(word >> 32); }
+
+	NodeIndex findRoot(NodeIndex n) const
+	{
+		assert(n < numNodes);
+		while (true)
+		{
+			uint64_t word = words[n].load(std::memory_order_acquire);
+			NodeIndex p = getParent(word);
+			if (p == n)
+				return n;
+
+			NodeIndex grandParent = getParent(words[p].load(std::memory_order_acquire));
+			if (grandParent != p)
+				words[n].compare_exchange_weak(word, makeWord(grandParent, getRank(word)), std::memory_order_release, std::memory_order_relaxed);
+			n = grandParent;
+		}
+	}
+public:
+	explicit AndersConcurrentUnionFind(unsigned n): words(new std::atomic<uint64_t>[n]), reps(new std::atomic<NodeIndex>[n]), numNodes(n)
+	{
+		for (NodeIndex i = 0; i < n; ++i)
+		{
+			words[i].store(makeWord(i, 0), std::memory_order_relaxed);
+			reps[i].store(i, std::memory_order_relaxed);
+		}
+	}
+
+	unsigned size() const { return numNodes; }
+
+	// find() only writes to the atomic words, so it may run on a const union-find from several threads at once
+	NodeIndex find(NodeIndex n) const
+	{
+		return reps[findRoot(n)].load(std::memory_order_acquire);
+	}
+
+	// The answer may be stale as soon as it is returned if other threads are merging a and b, but a true is final
+	bool inSameSet(NodeIndex a, NodeIndex b) const
+	{
+		while (true)
+		{
+			a = findRoot(a);
+			b = findRoot(b);
+			if (a == b)
+				return true;
+			// a may have been linked under b after we found it
+			if (getParent(words[a].load(std::memory_order_acquire)) == a)
+				return false;
+		}
+	}
+
+	// Merge the set of n1 into the set of n0. The representative of n0 represents the merged set, and is returned
+	NodeIndex unite(NodeIndex n0, NodeIndex n1)
+	{
+		while (true)
+		{
+			NodeIndex a = findRoot(n0), b = findRoot(n1);
+			NodeIndex setRep = reps[a].load(std::memory_order_acquire);
+			if (a == b)
+				return setRep;
+
+			uint64_t wordA = words[a].load(std::memory_order_acquire);
+			uint64_t wordB = words[b].load(std::memory_order_acquire);
+			if (getParent(wordA) != a || getParent(wordB) != b)
+				// Another thread has linked one of them in the meantime
+				continue;
+
+			// Link the root of lower (rank, index) under the other one. Ranks only grow, so the parent of a node always stays greater than the node in that order, and two threads can never link two roots under each other
+			unsigned rankA = getRank(wordA), rankB = getRank(wordB);
+			if (rankA < rankB || (rankA == rankB && a < b))
+			{
+				std::swap(a, b);
+				std::swap(wordA, wordB);
+				std::swap(rankA, rankB);
+			}
+			if (!words[b].compare_exchange_strong(wordB, makeWord(a, rankB), std::memory_order_acq_rel))
+				continue;
+
+			// The rank is only a heuristic: if another thread has changed a already, keep its word
+			if (rankA == rankB)
+				words[a].compare_exchange_strong(wordA, makeWord(a, rankA + 1), std::memory_order_acq_rel);
+			reps[a].store(setRep, std::memory_order_release);
+			return setRep;
+		}
+	}
+};
+
+#endif
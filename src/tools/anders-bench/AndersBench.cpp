@@ -0,0 +1,137 @@
+// anders-bench - Replay an Andersen constraint dump (opt -parcoach -anders-export-cons=<file>) with each combination of the offline optimizations (-enable-hvn, -enable-hu) and of the online cycle detections (-enable-hcd, -enable-lcd), and report the time, the node visits and the peak memory of each run
+// Every run happens in a process of its own, so that the peak memory of a run is not hidden by the one of the runs before it
+
+#include "andersen/Andersen.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+extern cl::opt<bool> EnableHVN;
+extern cl::opt<bool> EnableHU;
+extern cl::opt<bool> EnableHCD;
+extern cl::opt<bool> EnableLCD;
+
+static cl::opt<std::string> InputFile(cl::Positional, cl::desc("<constraint dump>"), cl::Required);
+static cl::opt<bool> OnlyGivenOptions("only-given", cl::desc("Only run with the optimizations given on the command line instead of every combination"), cl::init(false));
+static cl::opt<std::string> PrintPtsFile("print-pts", cl::desc("With -only-given, write the solution to this file, one \"node: pointees\" line per node (see compare-solvers.sh)"), cl::init(""));
+
+namespace {
+
+// Peak resident set size of this process, in KB
+long getPeakMemory()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+double getSecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The exit code of a run that was not worth doing
+const int SkippedRun = 2;
+
+// Load the dump, then optimize and solve it with the current options. Return the exit code of the run
+int runOnce()
+{
+	auto loadStart = std::chrono::steady_clock::now();
+	std::unique_ptr<Andersen> anders = Andersen::importConstraints(InputFile);
+	if (!anders)
+		return 1;
+	double loadTime = getSecondsSince(loadStart);
+	// HVN and HU have already run, or not, before the constraints were dumped
+	if (anders->hasOptimizedConstraints() && (EnableHVN || EnableHU))
+		return SkippedRun;
+
+	auto optimizeStart = std::chrono::steady_clock::now();
+	anders->optimizeConstraints();
+	double optimizeTime = getSecondsSince(optimizeStart);
+
+	auto solveStart = std::chrono::steady_clock::now();
+	anders->solveConstraints();
+	double solveTime = getSecondsSince(solveStart);
+
+	outs() << format("%3d %3d %3d %3d %10.3f %10.3f %10.3f %12llu %12ld\n", EnableHVN ? 1 : 0, EnableHU ? 1 : 0, EnableHCD ? 1 : 0, EnableLCD ? 1 : 0, loadTime, optimizeTime, solveTime, static_cast<unsigned long long>(anders->getNumNodeVisits()), getPeakMemory());
+	outs().flush();
+
+	if (!PrintPtsFile.empty())
+	{
+		std::error_code ec;
+		raw_fd_ostream os(PrintPtsFile, ec, sys::fs::F_Text);
+		if (ec)
+		{
+			errs() << "Cannot write " << PrintPtsFile << ": " << ec.message() << '\n';
+			return 1;
+		}
+		anders->printPtsGraph(os);
+	}
+	return 0;
+}
+
+}	// end of anonymous namespace
+
+int main(int argc, char** argv)
+{
+	cl::ParseCommandLineOptions(argc, argv, "Andersen solver benchmark\n");
+
+	outs() << "hvn  hu hcd lcd    load(s) optimize(s)   solve(s)       visits    peak(KB)\n";
+	outs().flush();
+	if (OnlyGivenOptions)
+	{
+		int ret = runOnce();
+		if (ret == SkippedRun)
+			errs() << "The constraints of " << InputFile << " are already optimized: drop -enable-hvn and -enable-hu\n";
+		return ret;
+	}
+
+	int ret = 0;
+	bool skipped = false;
+	for (unsigned mask = 0; mask < 16; ++mask)
+	{
+		EnableHVN = (mask & 8) != 0;
+		EnableHU = (mask & 4) != 0;
+		EnableHCD = (mask & 2) != 0;
+		EnableLCD = (mask & 1) != 0;
+
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			errs() << "Cannot fork: " << std::strerror(errno) << '\n';
+			return 1;
+		}
+		if (pid == 0)
+			_exit(runOnce());
+
+		int status;
+		bool exited = waitpid(pid, &status, 0) >= 0 && WIFEXITED(status);
+		if (exited && WEXITSTATUS(status) == SkippedRun)
+			skipped = true;
+		else if (!exited || WEXITSTATUS(status) != 0)
+		{
+			errs() << "The run with hvn=" << EnableHVN << " hu=" << EnableHU << " hcd=" << EnableHCD << " lcd=" << EnableLCD << " failed\n";
+			ret = 1;
+		}
+	}
+	if (skipped)
+		errs() << "The constraints of " << InputFile << " are already optimized: the runs with HVN or HU were skipped\n";
+	return ret;
+}
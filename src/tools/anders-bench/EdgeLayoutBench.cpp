@@ -0,0 +1,80 @@
+// edge-layout-bench - Compare the two layouts of the constraint graph edges: a std::map from node to std::set of successors, as before, and a node-indexed vector of SparseBitVectors, as ConstraintGraph has now
+// Random copy edges are added to both layouts, then every edge is visited node by node several times, as the solver does. The targets of an edge are close to its source, like the nodes of a function
+// Build: c++ -O2 $(llvm-config --cxxflags) EdgeLayoutBench.cpp -o edge-layout-bench $(llvm-config --ldflags --libs support --system-libs)
+
+#include "llvm/ADT/SparseBitVector.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+long getMilliSecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+}	// end of anonymous namespace
+
+// edge-layout-bench [<nodes> <edges> <scans>]
+int main(int argc, char** argv)
+{
+	unsigned numNodes = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	unsigned numEdges = argc > 2 ? std::atoi(argv[2]) : 4000000;
+	unsigned numScans = argc > 3 ? std::atoi(argv[3]) : 5;
+
+	std::mt19937 rng(1);
+	std::vector<std::pair<unsigned, unsigned>> edges;
+	edges.reserve(numEdges);
+	for (unsigned i = 0; i < numEdges; ++i)
+	{
+		unsigned src = rng() % numNodes;
+		edges.emplace_back(src, (src + rng() % 2000) % numNodes);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::map<unsigned, std::set<unsigned>> mapGraph;
+	for (auto& edge: edges)
+		mapGraph[edge.first].insert(edge.second);
+	long mapBuild = getMilliSecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	unsigned long mapSum = 0;
+	for (unsigned r = 0; r < numScans; ++r)
+		for (unsigned i = 0; i < numNodes; ++i)
+		{
+			auto itr = mapGraph.find(i);
+			if (itr != mapGraph.end())
+				for (auto dst: itr->second)
+					mapSum += dst;
+		}
+	long mapScan = getMilliSecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<SparseBitVector<>> vectorGraph(numNodes);
+	for (auto& edge: edges)
+		vectorGraph[edge.first].test_and_set(edge.second);
+	long vectorBuild = getMilliSecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	unsigned long vectorSum = 0;
+	for (unsigned r = 0; r < numScans; ++r)
+		for (unsigned i = 0; i < numNodes; ++i)
+			for (auto dst: vectorGraph[i])
+				vectorSum += dst;
+	long vectorScan = getMilliSecondsSince(start);
+
+	if (mapSum != vectorSum)
+	{
+		std::fprintf(stderr, "The two layouts do not hold the same edges\n");
+		return 1;
+	}
+	std::printf("map<set>:                build %ld ms, %u full edge scans %ld ms\n", mapBuild, numScans, mapScan);
+	std::printf("vector<SparseBitVector>: build %ld ms, %u full edge scans %ld ms\n", vectorBuild, numScans, vectorScan);
+	return 0;
+}
@@ -0,0 +1,61 @@
+// module-bench - Run the Andersen analysis on a module and report its time and the peak memory of the process
+// It only uses the constructor of Andersen, which every revision has, so that bench-revisions.sh can build it against the sources of any revision and compare them on the same module
+
+#include "andersen/Andersen.h"
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+
+#include <sys/resource.h>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFile(cl::Positional, cl::desc("<module>"), cl::Required);
+
+namespace {
+
+// Peak resident set size of this process, in KB
+long getPeakMemory()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+}	// end of anonymous namespace
+
+int main(int argc, char** argv)
+{
+	cl::ParseCommandLineOptions(argc, argv, "Andersen analysis benchmark on a module\n");
+
+	LLVMContext context;
+	SMDiagnostic err;
+	std::unique_ptr<Module> module = parseIRFile(InputFile, err, context);
+	if (!module)
+	{
+		err.print(argv[0], errs());
+		return 1;
+	}
+	long modulePeak = getPeakMemory();
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		Andersen anders(*module);
+	}
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	outs() << format("analysis %.3f s, peak %ld KB, of which %ld KB before the analysis\n", time, getPeakMemory(), modulePeak);
+	return 0;
+}
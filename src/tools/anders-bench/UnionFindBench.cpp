@@ -0,0 +1,103 @@
+// union-find-bench - Compare AndersUnionFind with the lock-free AndersConcurrentUnionFind the parallel solver uses
+// - merges: random merges of nearby nodes, with a lookup after each one, on one thread;
+// - lookups: every node looked up several times on T threads after the merges, as the parallel steps of the solver do. AndersUnionFind can only do it with its const find(), which does not compress paths, while the concurrent one compresses them as it goes
+// Build: c++ -O2 -std=c++11 -I../../aSSA UnionFindBench.cpp -o union-find-bench -lpthread
+
+#include "andersen/UnionFind.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+long getMilliSecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Func>
+void runOnThreads(unsigned numThreads, Func fn)
+{
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < numThreads; ++t)
+		workers.emplace_back(fn, t);
+	for (auto& worker: workers)
+		worker.join();
+}
+
+}	// end of anonymous namespace
+
+// union-find-bench [<nodes> <merges> <lookup rounds> <threads>]
+int main(int argc, char** argv)
+{
+	unsigned numNodes = argc > 1 ? std::atoi(argv[1]) : 4000000;
+	unsigned numMerges = argc > 2 ? std::atoi(argv[2]) : 3000000;
+	unsigned numRounds = argc > 3 ? std::atoi(argv[3]) : 5;
+	unsigned numThreads = argc > 4 ? std::atoi(argv[4]) : 4;
+
+	std::mt19937 rng(1);
+	std::vector<std::pair<NodeIndex, NodeIndex>> merges;
+	for (unsigned i = 0; i < numMerges; ++i)
+	{
+		NodeIndex a = rng() % numNodes;
+		merges.emplace_back(a, (a + 1 + rng() % 64) % numNodes);
+	}
+
+	AndersUnionFind seqUF;
+	for (unsigned i = 0; i < numNodes; ++i)
+		seqUF.addNode();
+	AndersConcurrentUnionFind concUF(numNodes);
+
+	unsigned long seqSum = 0, concSum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (auto const& merge: merges)
+	{
+		seqUF.unite(merge.first, merge.second);
+		seqSum += seqUF.find(merge.second);
+	}
+	long seqMerge = getMilliSecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	for (auto const& merge: merges)
+	{
+		concUF.unite(merge.first, merge.second);
+		concSum += concUF.find(merge.second);
+	}
+	long concMerge = getMilliSecondsSince(start);
+
+	const AndersUnionFind& constSeqUF = seqUF;
+	std::vector<unsigned long> seqSums(numThreads, 0), concSums(numThreads, 0);
+	start = std::chrono::steady_clock::now();
+	runOnThreads(numThreads, [&](unsigned tid)
+	{
+		for (unsigned r = 0; r < numRounds; ++r)
+			for (NodeIndex i = tid; i < numNodes; i += numThreads)
+				seqSums[tid] += constSeqUF.find(i);
+	});
+	long seqLookup = getMilliSecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	runOnThreads(numThreads, [&](unsigned tid)
+	{
+		for (unsigned r = 0; r < numRounds; ++r)
+			for (NodeIndex i = tid; i < numNodes; i += numThreads)
+				concSums[tid] += concUF.find(i);
+	});
+	long concLookup = getMilliSecondsSince(start);
+
+	for (unsigned t = 0; t < numThreads; ++t)
+	{
+		seqSum += seqSums[t];
+		concSum += concSums[t];
+	}
+	if (seqSum != concSum)
+	{
+		std::fprintf(stderr, "The two union-finds do not pick the same representatives\n");
+		return 1;
+	}
+	std::printf("AndersUnionFind:           merges %ld ms, lookups on %u threads %ld ms\n", seqMerge, numThreads, seqLookup);
+	std::printf("AndersConcurrentUnionFind: merges %ld ms, lookups on %u threads %ld ms\n", concMerge, numThreads, concLookup);
+	return 0;
+}
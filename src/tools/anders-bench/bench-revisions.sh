@@ -0,0 +1,46 @@
+#!/bin/sh
+# Compare the Andersen analysis of several revisions on the same module (see README)
+#
+#   bench-revisions.sh <module> <revision>... [-- <analysis options>]
+#
+# ModuleBench.cpp is built against the andersen/ sources of each git revision, "." being the working tree, and run on the module with the given options. A revision that does not know an option fails to run
+# LLVM_CONFIG and CXX pick the toolchain, and ANDERS_BENCH_CXXFLAGS adds compiler flags. ANDERS_BENCH_PREPARE, if set, is a shell command run in the andersen/ directory of each revision before the build, e.g. to port the sources to another LLVM
+
+set -e
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 <module> <revision>... [-- <analysis options>]" >&2
+	exit 1
+fi
+
+here=$(cd "$(dirname "$0")" && pwd)
+repo=$(cd "$here/../../.." && pwd)
+LLVM_CONFIG=${LLVM_CONFIG:-llvm-config}
+CXX=${CXX:-c++}
+
+module=$1
+shift
+revisions=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+	revisions="$revisions $1"
+	shift
+done
+[ "$1" = "--" ] && shift
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+for rev in $revisions; do
+	dir="$work/$rev"
+	mkdir -p "$dir/andersen"
+	if [ "$rev" = "." ]; then
+		cp "$repo"/src/aSSA/andersen/* "$dir/andersen"
+	else
+		git -C "$repo" archive "$rev" src/aSSA/andersen | tar -x -C "$dir" --strip-components=2
+	fi
+	if [ -n "$ANDERS_BENCH_PREPARE" ]; then
+		(cd "$dir/andersen" && sh -c "$ANDERS_BENCH_PREPARE")
+	fi
+	$CXX -O2 -DNDEBUG $($LLVM_CONFIG --cxxflags) $ANDERS_BENCH_CXXFLAGS -I"$dir" "$here/ModuleBench.cpp" "$dir"/andersen/*.cpp -o "$dir/module-bench" $($LLVM_CONFIG --ldflags --libs core analysis support irreader --system-libs) -lpthread
+	echo "$rev: $("$dir/module-bench" "$module" "$@")"
+done
@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+# Compare two pts-to outputs, as anders-pts or anders-bench -print-pts print them: one "<pointer> -> <pointees>" or "<node>: <pointees>" line per pointer
+#
+#   compare-pts.py <reference> <other> [-superset]
+#
+# Exit with 1 and print the first differences if the outputs differ. With -superset, <other> may point to more than <reference>, as long as it points to everything <reference> points to: this checks that an over-approximation is sound
+
+import sys
+
+
+def load(path):
+    pts = {}
+    for line in open(path):
+        line = line.rstrip('\n')
+        if not line:
+            continue
+        if ' ->' in line:
+            key, _, values = line.partition(' ->')
+        else:
+            key, _, values = line.partition(':')
+        pts[key.strip()] = set(values.split())
+    return pts
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit('usage: compare-pts.py <reference> <other> [-superset]')
+    superset = '-superset' in sys.argv[3:]
+    ref, other = load(sys.argv[1]), load(sys.argv[2])
+    errors = []
+    for key in sorted(set(ref) | set(other)):
+        if key not in other or key not in ref:
+            errors.append('%s: only in %s' % (key, sys.argv[1] if key in ref else sys.argv[2]))
+            continue
+        missing = ref[key] - other[key]
+        extra = other[key] - ref[key]
+        if missing:
+            errors.append('%s: misses %s' % (key, ' '.join(sorted(missing))))
+        elif extra and not superset:
+            errors.append('%s: also points to %s' % (key, ' '.join(sorted(extra))))
+    for error in errors[:10]:
+        print(error)
+    if errors:
+        print('%d pointers differ' % len(errors))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
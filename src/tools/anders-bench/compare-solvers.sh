@@ -0,0 +1,77 @@
+#!/bin/sh
+# Check that the wave solver reaches the same solution as the worklist solver (see README)
+#
+#   compare-solvers.sh <dump>...
+#   compare-solvers.sh -random <count> [<first seed>]
+#
+# Each dump is solved by both solvers, without cycle detection, with HCD and with LCD, and the two solutions of each setting are compared with compare-pts.py. With -random, <count> small dumps are generated by gen-dump.py instead, with a reference solution computed naively that the worklist solver must match as well
+# ANDERS_BENCH is the anders-bench binary (default: anders-bench in the PATH)
+
+set -e
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 <dump>... | -random <count> [<first seed>]" >&2
+	exit 1
+fi
+
+here=$(cd "$(dirname "$0")" && pwd)
+ANDERS_BENCH=${ANDERS_BENCH:-anders-bench}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+
+# solve <dump> <output> <options>...
+solve()
+{
+	dump=$1
+	out=$2
+	shift 2
+	"$ANDERS_BENCH" "$dump" -only-given -print-pts="$out" "$@" > /dev/null
+}
+
+# check <name> <dump> [<reference>]: compare the solvers on the dump, and report the differences under name
+check()
+{
+	name=$1
+	dump=$2
+	status=ok
+	for opts in "" "-enable-hcd" "-enable-lcd"; do
+		solve "$dump" "$work/worklist" -anders-solver=worklist $opts
+		solve "$dump" "$work/wave" -anders-solver=wave $opts
+		if ! python3 "$here/compare-pts.py" "$work/worklist" "$work/wave" > "$work/diff"; then
+			echo "$name: the wave solver differs from the worklist solver with options '$opts':"
+			cat "$work/diff"
+			status=failed
+		fi
+	done
+	if [ $# -gt 2 ]; then
+		solve "$dump" "$work/worklist" -anders-solver=worklist
+		if ! python3 "$here/compare-pts.py" "$3" "$work/worklist" > "$work/diff"; then
+			echo "$name: the worklist solver differs from the naive solution:"
+			cat "$work/diff"
+			status=failed
+		fi
+	fi
+	[ $status = ok ] || failed=$((failed + 1))
+}
+
+if [ "$1" = "-random" ]; then
+	count=$2
+	seed=${3:-1}
+	last=$((seed + count))
+	while [ $seed -lt $last ]; do
+		python3 "$here/gen-dump.py" 40 20 150 $seed "$work/dump" "$work/reference"
+		check "gen-dump.py 40 20 150 $seed" "$work/dump" "$work/reference"
+		seed=$((seed + 1))
+	done
+	total=$count
+else
+	total=$#
+	for dump in "$@"; do
+		check "$dump" "$dump"
+	done
+fi
+
+echo "$((total - failed)) of $total dumps agree"
+[ $failed -eq 0 ]
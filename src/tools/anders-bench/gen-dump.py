@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+# Generate a random Andersen constraint dump in the format of -anders-export-cons (see ConstraintDump.cpp), for anders-bench and compare-solvers.sh
+#
+#   gen-dump.py <value nodes> <object nodes> <constraints> <seed> <dump> [<reference>]
+#
+# The dump has copy, load, store, address-of and gep constraints between random nodes, objects of up to 3 fields, a few functions and the indirect calls to them. With <reference>, the least solution is also computed naively and written there, one "node: pointees" line per node as anders-bench -print-pts prints it. The naive solver is slow, so keep the dump small then
+
+import random
+import struct
+import sys
+
+INVALID = 0xFFFFFFFF
+UNKNOWN_OFFSET = 0xFFFFFFFF
+ADDR_OF, COPY, LOAD, STORE, GEP = 0, 1, 2, 3, 4
+
+
+def generate(num_values, num_objects, num_constraints, seed):
+    rng = random.Random(seed)
+    # The universal pointer and object, then the null pointer and object, as AndersNodeFactory creates them
+    nodes = [('v', 1, 0), ('o', 1, 0), ('v', 1, 0), ('o', 1, 0)]
+    values, objects = [], []
+    for _ in range(num_values):
+        values.append(len(nodes))
+        nodes.append(('v', 1, 0))
+    for _ in range(num_objects):
+        num_fields = rng.choice([1, 1, 1, 2, 3])
+        base = len(nodes)
+        for k in range(num_fields):
+            nodes.append(('o', num_fields, k))
+            objects.append(base + k)
+
+    # The functions the indirect calls may reach: an object node, its formals, maybe a vararg node and a return node
+    targets = []
+    for _ in range(rng.randint(0, 3)):
+        obj = len(nodes)
+        nodes.append(('o', 1, 0))
+        objects.append(obj)
+        formals = []
+        for _ in range(rng.randint(0, 3)):
+            if rng.random() < 0.8:
+                formals.append(len(nodes))
+                values.append(len(nodes))
+                nodes.append(('v', 1, 0))
+            else:
+                formals.append(INVALID)
+        vararg = INVALID
+        if rng.random() < 0.3:
+            vararg = len(nodes)
+            nodes.append(('o', 1, 0))
+        ret = INVALID
+        if rng.random() < 0.7:
+            ret = len(nodes)
+            values.append(ret)
+            nodes.append(('v', 1, 0))
+        targets.append((obj, formals, vararg, ret))
+
+    constraints = [(ADDR_OF, 0, 1, 0), (ADDR_OF, 2, 3, 0)]
+    for _ in range(num_constraints):
+        kind = rng.choice([ADDR_OF, ADDR_OF, COPY, COPY, LOAD, STORE, GEP])
+        if kind == ADDR_OF:
+            constraints.append((ADDR_OF, rng.choice(values), rng.choice(objects + [1]), 0))
+        elif kind == GEP:
+            constraints.append((GEP, rng.choice(values), rng.choice(values), rng.choice([0, 1, 2, UNKNOWN_OFFSET])))
+        else:
+            constraints.append((kind, rng.choice(values), rng.choice(values), 0))
+    for target in targets:
+        if rng.random() < 0.8:
+            constraints.append((ADDR_OF, rng.choice(values), target[0], 0))
+    if rng.random() < 0.2:
+        constraints.append((COPY, rng.choice(values), 0, 0))
+
+    calls = []
+    for _ in range(rng.randint(0, 4) if targets else 0):
+        fun_ptr = rng.choice(values)
+        args = [rng.choice(values) if rng.random() < 0.8 else INVALID for _ in range(rng.randint(0, 4))]
+        ret = rng.choice(values) if rng.random() < 0.6 else INVALID
+        calls.append((fun_ptr, ret, args))
+    return nodes, constraints, calls, targets
+
+
+def write_dump(path, nodes, constraints, calls, targets):
+    out = [b'ANDERSCS', struct.pack('<7I', 1, 0, 32, len(nodes), len(constraints), len(calls), len(targets))]
+    for i, (kind, num_fields, offset) in enumerate(nodes):
+        out.append(struct.pack('<3I', num_fields << 1 if kind == 'o' else 0, offset if kind == 'o' else 0, i))
+    for c in constraints:
+        out.append(struct.pack('<4I', *c))
+    for fun_ptr, ret, args in calls:
+        out.append(struct.pack('<3I', fun_ptr, ret, len(args)) + b''.join(struct.pack('<I', a) for a in args))
+    for obj, formals, vararg, ret in targets:
+        out.append(struct.pack('<4I', obj, vararg, ret, len(formals)) + b''.join(struct.pack('<I', f) for f in formals))
+    with open(path, 'wb') as f:
+        f.write(b''.join(out))
+
+
+# Apply every constraint and every call until nothing changes
+def solve(nodes, constraints, calls, targets):
+    pts = [set() for _ in nodes]
+
+    def get_field(obj, k):
+        kind, num_fields, offset = nodes[obj]
+        if kind != 'o' or num_fields == 1:
+            return obj
+        return obj - offset + min(offset + k, num_fields - 1)
+
+    target_index = dict((t[0], i) for i, t in enumerate(targets))
+    changed = [True]
+
+    def add(dst, objs):
+        if not objs <= pts[dst]:
+            pts[dst] |= objs
+            changed[0] = True
+
+    while changed[0]:
+        changed[0] = False
+        for kind, dst, src, offset in constraints:
+            if kind == ADDR_OF:
+                add(dst, {src})
+            elif kind == COPY:
+                add(dst, set(pts[src]))
+            elif kind == LOAD:
+                for obj in list(pts[src]):
+                    add(dst, set(pts[obj]))
+            elif kind == STORE:
+                for obj in list(pts[dst]):
+                    add(obj, set(pts[src]))
+            else:
+                fields = set()
+                for obj in pts[src]:
+                    node_kind, num_fields, obj_offset = nodes[obj]
+                    if offset == UNKNOWN_OFFSET:
+                        base = obj - obj_offset if node_kind == 'o' else obj
+                        fields |= set(range(base, base + (num_fields if node_kind == 'o' else 1)))
+                    else:
+                        fields.add(get_field(obj, offset))
+                add(dst, fields)
+        for fun_ptr, ret, args in calls:
+            reached = set()
+            for obj in list(pts[fun_ptr]):
+                if obj == 1:
+                    reached |= set(range(len(targets)))
+                    if ret != INVALID:
+                        add(ret, set(pts[0]))
+                elif obj in target_index:
+                    reached.add(target_index[obj])
+            for t in reached:
+                obj, formals, vararg, target_ret = targets[t]
+                if vararg == INVALID and len(formals) != len(args):
+                    continue
+                num_args = min(len(formals), len(args))
+                for i in range(num_args):
+                    if formals[i] != INVALID:
+                        add(formals[i], set(pts[args[i] if args[i] != INVALID else 0]))
+                if vararg != INVALID:
+                    for arg in args[num_args:]:
+                        if arg != INVALID:
+                            add(vararg, set(pts[arg]))
+                if ret != INVALID:
+                    add(ret, set(pts[target_ret if target_ret != INVALID else 0]))
+    return pts
+
+
+def main():
+    if len(sys.argv) not in (6, 7):
+        sys.stderr.write('usage: gen-dump.py <value nodes> <object nodes> <constraints> <seed> <dump> [<reference>]\n')
+        return 1
+    nodes, constraints, calls, targets = generate(int(sys.argv[1]), int(sys.argv[2]), int(sys.argv[3]), int(sys.argv[4]))
+    write_dump(sys.argv[5], nodes, constraints, calls, targets)
+    if len(sys.argv) == 7:
+        with open(sys.argv[6], 'w') as f:
+            for i, objs in enumerate(solve(nodes, constraints, calls, targets)):
+                f.write('%d:%s\n' % (i, ''.join(' %d' % o for o in sorted(objs))))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+# Generate the synthetic modules the Andersen benchmarks run on (see README). The output is textual IR that LLVM 3.9 reads, and it only depends on the arguments
+#
+#   gen-module.py random <functions> <statements per function> <seed>
+#     Pointer-heavy functions that copy, load and store pointers, take fields of a struct, allocate on the heap, call each other directly and through a table of function pointers, and call MPI and unknown external functions. main calls every function
+#   gen-module.py tables <entries>
+#     A dispatch table of function pointers, a table of pointers to globals and a pointer-free table, each with that many entries, as in the lookup tables of physics codes
+
+import random
+import sys
+
+
+def gen_random(num_functions, num_statements, seed):
+    rng = random.Random(seed)
+    out = []
+    out.append('%struct.S = type { i32*, i32*, %struct.S* }')
+    out.append('@g = global i32 0')
+    out.append('@gs = global %struct.S zeroinitializer')
+    out.append('@gp = global i32* @g')
+    out.append('@ext = external global i32*')
+    num_handlers = max(1, num_functions // 8)
+    out.append('@handlers = global [%d x i32* (i32*, %%struct.S*)*] [%s]' % (num_handlers, ', '.join('i32* (i32*, %%struct.S*)* @f%d' % rng.randrange(num_functions) for _ in range(num_handlers))))
+    out.append('declare i8* @malloc(i64)')
+    out.append('declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)')
+    out.append('declare i8* @unknown_ext(i8*)')
+    out.append('declare i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)')
+    out.append('declare i32 @MPI_Comm_rank(i32, i32*)')
+
+    for f in range(num_functions):
+        out.append('define i32* @f%d(i32* %%a, %%struct.S* %%s) {' % f)
+        out.append('entry:')
+        ptrs = ['%a', '@g']
+        slots = ['@gp']
+        structs = ['%s', '@gs']
+        counter = [0]
+
+        def fresh():
+            counter[0] += 1
+            return '%%v%d' % counter[0]
+
+        for _ in range(num_statements):
+            kind = rng.randrange(10)
+            if kind == 0:
+                v = fresh()
+                out.append('  %s = alloca i32*' % v)
+                out.append('  store i32* %s, i32** %s' % (rng.choice(ptrs), v))
+                slots.append(v)
+            elif kind == 1:
+                v = fresh()
+                out.append('  %s = load i32*, i32** %s' % (v, rng.choice(slots)))
+                ptrs.append(v)
+            elif kind == 2:
+                out.append('  store i32* %s, i32** %s' % (rng.choice(ptrs), rng.choice(slots)))
+            elif kind == 3:
+                v = fresh()
+                out.append('  %s = getelementptr %%struct.S, %%struct.S* %s, i32 0, i32 %d' % (v, rng.choice(structs), rng.randrange(2)))
+                slots.append(v)
+            elif kind == 4:
+                m, v = fresh(), fresh()
+                out.append('  %s = call i8* @malloc(i64 24)' % m)
+                out.append('  %s = bitcast i8* %s to %%struct.S*' % (v, m))
+                structs.append(v)
+            elif kind == 5:
+                v, n = fresh(), fresh()
+                out.append('  %s = getelementptr %%struct.S, %%struct.S* %s, i32 0, i32 2' % (v, rng.choice(structs)))
+                out.append('  %s = load %%struct.S*, %%struct.S** %s' % (n, v))
+                structs.append(n)
+            elif kind == 6:
+                v = fresh()
+                out.append('  %s = call i32* @f%d(i32* %s, %%struct.S* %s)' % (v, rng.randrange(num_functions), rng.choice(ptrs), rng.choice(structs)))
+                ptrs.append(v)
+            elif kind == 7:
+                h, fp, v = fresh(), fresh(), fresh()
+                out.append('  %s = getelementptr [%d x i32* (i32*, %%struct.S*)*], [%d x i32* (i32*, %%struct.S*)*]* @handlers, i64 0, i64 %d' % (h, num_handlers, num_handlers, rng.randrange(num_handlers)))
+                out.append('  %s = load i32* (i32*, %%struct.S*)*, i32* (i32*, %%struct.S*)** %s' % (fp, h))
+                out.append('  %s = call i32* %s(i32* %s, %%struct.S* %s)' % (v, fp, rng.choice(ptrs), rng.choice(structs)))
+                ptrs.append(v)
+            elif kind == 8:
+                d, s = fresh(), fresh()
+                out.append('  %s = bitcast %%struct.S* %s to i8*' % (d, rng.choice(structs)))
+                out.append('  %s = bitcast %%struct.S* %s to i8*' % (s, rng.choice(structs)))
+                out.append('  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %s, i8* %s, i64 24, i32 8, i1 false)' % (d, s))
+            else:
+                b, r = fresh(), fresh()
+                out.append('  %s = bitcast i32* %s to i8*' % (b, rng.choice(ptrs)))
+                if rng.randrange(4) == 0:
+                    out.append('  %s = call i8* @unknown_ext(i8* %s)' % (r, b))
+                else:
+                    out.append('  %s = call i32 @MPI_Send(i8* %s, i32 1, i32 0, i32 0, i32 0, i32 0)' % (r, b))
+                    out.append('  %s = call i32 @MPI_Comm_rank(i32 0, i32* %s)' % (fresh(), rng.choice(ptrs)))
+        out.append('  ret i32* %s' % rng.choice(ptrs))
+        out.append('}')
+
+    out.append('define i32 @main() {')
+    out.append('entry:')
+    for f in range(num_functions):
+        out.append('  %%r%d = call i32* @f%d(i32* @g, %%struct.S* @gs)' % (f, f))
+    out.append('  ret i32 0')
+    out.append('}')
+    return out
+
+
+def gen_tables(num_entries):
+    out = []
+    out.append('%E = type { double, double, void (i8*)* }')
+    out.append('%P = type { double, i32 }')
+    num_handlers, num_objects = 16, 64
+    for h in range(num_handlers):
+        out.append('define void @h%d(i8* %%p) {' % h)
+        out.append('entry:')
+        out.append('  ret void')
+        out.append('}')
+    for o in range(num_objects):
+        out.append('@o%d = global i32 %d' % (o, o))
+    out.append('@dispatch = constant [%d x %%E] [%s]' % (num_entries, ','.join('%%E { double %d.0, double 1.0, void (i8*)* @h%d }' % (i, i % num_handlers) for i in range(num_entries))))
+    out.append('@table = constant [%d x %%P] [%s]' % (num_entries, ','.join('%%P { double %d.0, i32 %d }' % (i, i) for i in range(num_entries))))
+    out.append('@ptrs = constant [%d x i32*] [%s]' % (num_entries, ','.join('i32* @o%d' % (i % num_objects) for i in range(num_entries))))
+    out.append('define i32 @main() {')
+    out.append('entry:')
+    out.append('  %%f = getelementptr [%d x %%E], [%d x %%E]* @dispatch, i64 0, i64 5, i32 2' % (num_entries, num_entries))
+    out.append('  %fp = load void (i8*)*, void (i8*)** %f')
+    out.append('  call void %fp(i8* null)')
+    out.append('  %%q = getelementptr [%d x i32*], [%d x i32*]* @ptrs, i64 0, i64 7' % (num_entries, num_entries))
+    out.append('  %p = load i32*, i32** %q')
+    out.append('  %%r = getelementptr [%d x %%P], [%d x %%P]* @table, i64 0, i64 7, i32 1' % (num_entries, num_entries))
+    out.append('  ret i32 0')
+    out.append('}')
+    return out
+
+
+def main():
+    if len(sys.argv) == 5 and sys.argv[1] == 'random':
+        lines = gen_random(int(sys.argv[2]), int(sys.argv[3]), int(sys.argv[4]))
+    elif len(sys.argv) == 3 and sys.argv[1] == 'tables':
+        lines = gen_tables(int(sys.argv[2]))
+    else:
+        sys.stderr.write('usage: gen-module.py random <functions> <statements> <seed> | tables <entries>\n')
+        return 1
+    sys.stdout.write('\n'.join(lines) + '\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,160 @@
+// anders-pts - Run the Andersen analysis on a module and print the points-to set of every named pointer, in a form that does not depend on node numbering, for the tests under tests/Andersen
+// Every option of the analysis (-anders-*, -enable-hvn, ...) can be given on the command line. A line reads "<pointer> -> <pointees>", where a value is @name for a global and function:%name for a local, followed by +field for the fields other than the first one. The pointees are sorted, and "?" stands for a pointer the analysis knows nothing about
+
+#include "andersen/Andersen.h"
+
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFile(cl::Positional, cl::desc("<module>"), cl::Required);
+static cl::opt<bool> PrintReverseIndex("reverse", cl::desc("Also print, for every field of every allocation site, the pointers that may point to it"), cl::init(false));
+
+namespace {
+
+std::string getValueName(const Value* v)
+{
+	if (isa<GlobalValue>(v))
+		return ("@" + v->getName()).str();
+
+	const Function* f = nullptr;
+	if (const Argument* arg = dyn_cast<Argument>(v))
+		f = arg->getParent();
+	else if (const Instruction* inst = dyn_cast<Instruction>(v))
+		f = inst->getParent()->getParent();
+	std::string name = f != nullptr ? f->getName().str() + ":" : std::string();
+	if (v->hasName())
+		return name + "%" + v->getName().str();
+	return name + "<unnamed>";
+}
+
+std::string getPointeeName(const Value* v, unsigned field)
+{
+	std::string name = getValueName(v);
+	if (field != 0)
+		name += "+" + std::to_string(field);
+	return name;
+}
+
+void printSorted(std::vector<std::string>& names)
+{
+	std::sort(names.begin(), names.end());
+	for (auto const& name: names)
+		outs() << " " << name;
+	outs() << "\n";
+}
+
+// Print the pts-to set of v, and check that every form of the query agrees. Return false if they do not
+bool printPointsTo(const Andersen& anders, const Value* v)
+{
+	std::vector<std::pair<const Value*, unsigned>> pointees;
+	std::vector<const Value*> values;
+	bool known = anders.getPointsToSet(v, pointees);
+	AndersPtsView view = anders.getPointsToView(v);
+	if (view.isKnown() != known || anders.getPointsToSet(v, values) != known)
+	{
+		errs() << "The queries disagree on whether the pts-to set of " << getValueName(v) << " is known\n";
+		return false;
+	}
+
+	outs() << getValueName(v) << " ->";
+	if (!known)
+	{
+		outs() << " ?\n";
+		return true;
+	}
+
+	std::vector<std::pair<const Value*, unsigned>> viewPointees(view.begin(), view.end());
+	if (viewPointees != pointees)
+	{
+		errs() << "The view of the pts-to set of " << getValueName(v) << " differs from the set\n";
+		return false;
+	}
+
+	std::vector<std::string> names;
+	for (auto const& pointee: pointees)
+		names.push_back(getPointeeName(pointee.first, pointee.second));
+	printSorted(names);
+	return true;
+}
+
+}	// end of anonymous namespace
+
+int main(int argc, char** argv)
+{
+	llvm_shutdown_obj shutdown;
+	cl::ParseCommandLineOptions(argc, argv, "Print the Andersen points-to sets of a module\n");
+
+	LLVMContext context;
+	SMDiagnostic err;
+	std::unique_ptr<Module> module = parseIRFile(InputFile, err, context);
+	if (!module)
+	{
+		err.print(argv[0], errs());
+		return 1;
+	}
+
+	Andersen anders(*module);
+
+	bool consistent = true;
+	for (auto const& f: *module)
+	{
+		for (auto const& arg: f.args())
+		{
+			if (arg.hasName() && arg.getType()->isPointerTy())
+				consistent &= printPointsTo(anders, &arg);
+		}
+		for (auto const& inst: instructions(f))
+		{
+			if (inst.hasName() && inst.getType()->isPointerTy())
+				consistent &= printPointsTo(anders, &inst);
+		}
+	}
+
+	if (PrintReverseIndex)
+	{
+		std::vector<const Value*> allocSites;
+		anders.getAllAllocationSites(allocSites);
+		std::vector<std::pair<std::string, std::vector<std::string>>> entries;
+		for (auto site: allocSites)
+		{
+			for (unsigned field = 0, e = anders.getNumFields(site); field < e; ++field)
+			{
+				std::vector<std::string> names;
+				for (auto ptr: anders.getPointersTo(site, field))
+				{
+					// The index must agree with the forward query
+					std::vector<std::pair<const Value*, unsigned>> pointees;
+					anders.getPointsToSet(ptr, pointees);
+					if (std::find(pointees.begin(), pointees.end(), std::make_pair(site, field)) == pointees.end())
+					{
+						errs() << "The reverse index has " << getValueName(ptr) << " point to " << getPointeeName(site, field) << ", but its pts-to set does not\n";
+						consistent = false;
+					}
+					if (ptr->hasName())
+						names.push_back(getValueName(ptr));
+				}
+				entries.push_back(std::make_pair(getPointeeName(site, field), names));
+			}
+		}
+		std::sort(entries.begin(), entries.end());
+		for (auto& entry: entries)
+		{
+			outs() << entry.first << " <-";
+			printSorted(entry.second);
+		}
+	}
+
+	return consistent ? 0 : 1;
+}
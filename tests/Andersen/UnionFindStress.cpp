@@ -0,0 +1,135 @@
+// Stress test of AndersConcurrentUnionFind against AndersUnionFind
+// - On one thread, the same random merges must give the same representative to every node in both union-finds.
+// - On several threads merging and looking up at once, every merge must hold as soon as unite() returns, and the final sets must be those of the same merges done on one thread. Each set must then be represented by one of its members
+
+#include "andersen/UnionFind.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+typedef std::pair<NodeIndex, NodeIndex> Merge;
+
+bool failed = false;
+
+void fail(const char* what, NodeIndex n)
+{
+	std::fprintf(stderr, "FAIL: %s (node %u)\n", what, n);
+	failed = true;
+}
+
+std::vector<Merge> getRandomMerges(unsigned numNodes, unsigned numMerges, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::vector<Merge> merges;
+	for (unsigned i = 0; i < numMerges; ++i)
+	{
+		NodeIndex a = rng() % numNodes;
+		// Mostly merge nearby nodes, so that the sets grow slowly and the trees get deep
+		NodeIndex b = (rng() % 4 == 0) ? rng() % numNodes : (a + 1 + rng() % 16) % numNodes;
+		merges.push_back(Merge(a, b));
+	}
+	return merges;
+}
+
+AndersUnionFind getReference(unsigned numNodes, const std::vector<std::vector<Merge>>& merges)
+{
+	AndersUnionFind ref;
+	for (unsigned i = 0; i < numNodes; ++i)
+		ref.addNode();
+	for (auto const& threadMerges: merges)
+		for (auto const& merge: threadMerges)
+			ref.unite(merge.first, merge.second);
+	return ref;
+}
+
+void testSequential(unsigned numNodes, unsigned numMerges)
+{
+	std::vector<std::vector<Merge>> merges(1, getRandomMerges(numNodes, numMerges, 1));
+	AndersUnionFind ref = getReference(numNodes, merges);
+	AndersConcurrentUnionFind uf(numNodes);
+	for (auto const& merge: merges[0])
+		uf.unite(merge.first, merge.second);
+	for (NodeIndex i = 0; i < numNodes; ++i)
+	{
+		if (uf.find(i) != ref.find(i))
+			fail("sequential merges pick another representative", i);
+	}
+}
+
+void testConcurrent(unsigned numNodes, unsigned numMerges, unsigned numThreads, unsigned seed)
+{
+	std::vector<std::vector<Merge>> merges;
+	for (unsigned t = 0; t < numThreads; ++t)
+		merges.push_back(getRandomMerges(numNodes, numMerges, seed + t));
+
+	AndersConcurrentUnionFind uf(numNodes);
+	std::vector<unsigned> lostMerges(numThreads, 0);
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < numThreads; ++t)
+	{
+		workers.emplace_back([&, t]()
+		{
+			std::mt19937 rng(t);
+			auto const& threadMerges = merges[t];
+			for (size_t i = 0, e = threadMerges.size(); i < e; ++i)
+			{
+				uf.unite(threadMerges[i].first, threadMerges[i].second);
+				// Look up an earlier merge of this thread while the other threads go on merging: it must still hold
+				const Merge& old = threadMerges[rng() % (i + 1)];
+				if (!uf.inSameSet(old.first, old.second))
+					++lostMerges[t];
+				uf.find(rng() % numNodes);
+			}
+		});
+	}
+	for (auto& worker: workers)
+		worker.join();
+
+	for (unsigned t = 0; t < numThreads; ++t)
+	{
+		if (lostMerges[t] != 0)
+		{
+			std::fprintf(stderr, "FAIL: thread %u saw %u of its merges undone while the other threads merged\n", t, lostMerges[t]);
+			failed = true;
+		}
+	}
+
+	// The partitions must be the same, whatever the representatives
+	AndersUnionFind ref = getReference(numNodes, merges);
+	std::unordered_map<NodeIndex, NodeIndex> refToConcurrent, concurrentToRef;
+	for (NodeIndex i = 0; i < numNodes; ++i)
+	{
+		NodeIndex rep = uf.find(i), refRep = ref.find(i);
+		if (!refToConcurrent.insert(std::make_pair(refRep, rep)).second && refToConcurrent[refRep] != rep)
+			fail("two nodes of the same set have different representatives", i);
+		if (!concurrentToRef.insert(std::make_pair(rep, refRep)).second && concurrentToRef[rep] != refRep)
+			fail("two nodes of different sets have the same representative", i);
+		if (uf.find(rep) != rep || !uf.inSameSet(i, rep))
+			fail("the representative is not a member of the set", i);
+	}
+}
+
+}	// end of anonymous namespace
+
+// anders-union-find-stress [<nodes> <merges per thread> <threads>]
+int main(int argc, char** argv)
+{
+	unsigned numNodes = argc > 1 ? std::atoi(argv[1]) : 100000;
+	unsigned numMerges = argc > 2 ? std::atoi(argv[2]) : 50000;
+	unsigned numThreads = argc > 3 ? std::atoi(argv[3]) : 8;
+
+	testSequential(numNodes, numMerges * numThreads);
+	for (unsigned round = 0; round < 4; ++round)
+		testConcurrent(numNodes, numMerges, numThreads, 100 + round * numThreads);
+
+	if (failed)
+		return 1;
+	std::printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,40 @@
+; Copy, load, store, address-of, heap allocation and direct calls, solved by the sequential and by the parallel solver, which must reach the same fixed point
+; RUN: anders-pts %s | FileCheck %s
+; RUN: anders-pts %s -anders-threads=4 | FileCheck %s
+
+@g = global i32 0
+@h = global i32 0
+@gp = global i32* @g
+
+declare i8* @malloc(i64)
+
+define i32* @id(i32* %x) {
+entry:
+  ret i32* %x
+}
+
+define i32 @main() {
+entry:
+  %a = alloca i32*
+  %b = alloca i32*
+  store i32* @g, i32** %a
+  %l = load i32*, i32** %a
+  %c = call i32* @id(i32* @h)
+  store i32* %c, i32** %b
+  %m = call i8* @malloc(i64 4)
+  %mi = bitcast i8* %m to i32*
+  store i32* %mi, i32** %a
+  %l2 = load i32*, i32** %a
+  %gl = load i32*, i32** @gp
+  ret i32 0
+}
+
+; CHECK: id:%x -> @h{{$}}
+; CHECK: main:%a -> main:%a{{$}}
+; CHECK: main:%b -> main:%b{{$}}
+; CHECK: main:%l -> @g main:%m{{$}}
+; CHECK: main:%c -> @h{{$}}
+; CHECK: main:%m -> main:%m{{$}}
+; CHECK: main:%mi -> main:%m{{$}}
+; CHECK: main:%l2 -> @g main:%m{{$}}
+; CHECK: main:%gl -> @g{{$}}
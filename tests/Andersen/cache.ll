@@ -0,0 +1,27 @@
+; The result cache is keyed by the constraints of the module: a change that leaves them alone reuses the cached solution, and a change to them solves again
+; RUN: rm -f %t.cache
+; RUN: anders-pts -anders-cache -anders-cache-file=%t.cache %s > %t.first
+; RUN: sed 's/add i32 %n, 1/mul i32 %n, 7/' %s > %t.arith.ll
+; RUN: anders-pts -anders-cache -anders-cache-file=%t.cache %t.arith.ll > %t.out 2> %t.err
+; RUN: cmp %t.first %t.out
+; RUN: FileCheck %s --check-prefix=HIT --allow-empty < %t.err
+; RUN: sed 's/store i32\* @h, i32\*\* %b/store i32* @g, i32** %b/' %s > %t.ptr.ll
+; RUN: anders-pts -anders-cache -anders-cache-file=%t.cache %t.ptr.ll 2>&1 | FileCheck %s --check-prefix=MISS
+
+@g = global i32 0
+@h = global i32 0
+
+define i32 @main(i32 %n) {
+entry:
+  %a = alloca i32*
+  %b = alloca i32*
+  store i32* @g, i32** %a
+  store i32* @h, i32** %b
+  %x = add i32 %n, 1
+  %l = load i32*, i32** %b
+  ret i32 %x
+}
+
+; HIT-NOT: solving again
+; MISS: does not match the constraints of this module, solving again
+; MISS: main:%l -> @g{{$}}
@@ -0,0 +1,42 @@
+; The demand-driven queries must give the solution of the whole program, also once a query runs out of budget and the whole program is solved. Only the functions reachable from main are collected, and the indirect calls are wired statically: the reference is the full solve of the same constraints
+; RUN: anders-pts -anders-demand %s > %t.demand
+; RUN: anders-pts -anders-reachable-only -anders-otf-calls=false %s > %t.full
+; RUN: cmp %t.full %t.demand
+; RUN: FileCheck %s < %t.demand
+; RUN: anders-pts -anders-demand -anders-demand-budget=1 %s > %t.budget 2> %t.err
+; RUN: cmp %t.full %t.budget
+; RUN: FileCheck %s --check-prefix=BUDGET < %t.err
+
+@g = global i32 0
+@h = global i32 0
+@fp = global i32* (i32*)* @cb
+
+define i32* @cb(i32* %x) {
+entry:
+  ret i32* %x
+}
+
+define i32* @unused(i32* %y) {
+entry:
+  %z = getelementptr i32, i32* %y, i64 1
+  ret i32* %z
+}
+
+define i32 @main() {
+entry:
+  %a = alloca i32*
+  store i32* @g, i32** %a
+  %p = load i32*, i32** %a
+  %f = load i32* (i32*)*, i32* (i32*)** @fp
+  %r = call i32* %f(i32* %p)
+  %q = call i32* @cb(i32* @h)
+  ret i32 0
+}
+
+; CHECK: cb:%x -> @g @h{{$}}
+; CHECK: unused:%y ->{{$}}
+; CHECK: unused:%z -> ?{{$}}
+; CHECK: main:%p -> @g{{$}}
+; CHECK: main:%f -> @cb{{$}}
+; CHECK: main:%q -> @g @h{{$}}
+; BUDGET: out of budget, solving the whole program
@@ -0,0 +1,56 @@
+; The fields of a struct are told apart with -anders-field-sensitive, and the fields past -anders-max-fields share the node of the last one
+; RUN: anders-pts %s | FileCheck %s --check-prefix=INSENSITIVE
+; RUN: anders-pts %s -anders-field-sensitive | FileCheck %s --check-prefix=SENSITIVE
+; RUN: anders-pts %s -anders-field-sensitive -anders-max-fields=2 | FileCheck %s --check-prefix=MAX2
+
+%struct.S = type { i32*, i32*, %struct.S* }
+
+@g = global i32 0
+@h = global i32 0
+
+define i32 @main() {
+entry:
+  %s = alloca %struct.S
+  %f0 = getelementptr %struct.S, %struct.S* %s, i32 0, i32 0
+  %f1 = getelementptr %struct.S, %struct.S* %s, i32 0, i32 1
+  %f2 = getelementptr %struct.S, %struct.S* %s, i32 0, i32 2
+  store i32* @g, i32** %f0
+  store i32* @h, i32** %f1
+  store %struct.S* %s, %struct.S** %f2
+  %l0 = load i32*, i32** %f0
+  %l1 = load i32*, i32** %f1
+  %n = load %struct.S*, %struct.S** %f2
+  %nf1 = getelementptr %struct.S, %struct.S* %n, i32 0, i32 1
+  %ln1 = load i32*, i32** %nf1
+  ret i32 0
+}
+
+; INSENSITIVE: main:%s -> main:%s{{$}}
+; INSENSITIVE: main:%f0 -> main:%s{{$}}
+; INSENSITIVE: main:%f1 -> main:%s{{$}}
+; INSENSITIVE: main:%f2 -> main:%s{{$}}
+; INSENSITIVE: main:%l0 -> @g @h main:%s{{$}}
+; INSENSITIVE: main:%l1 -> @g @h main:%s{{$}}
+; INSENSITIVE: main:%n -> @g @h main:%s{{$}}
+; INSENSITIVE: main:%nf1 -> @g @h main:%s{{$}}
+; INSENSITIVE: main:%ln1 -> @g @h main:%s{{$}}
+
+; SENSITIVE: main:%s -> main:%s{{$}}
+; SENSITIVE: main:%f0 -> main:%s{{$}}
+; SENSITIVE: main:%f1 -> main:%s+1{{$}}
+; SENSITIVE: main:%f2 -> main:%s+2{{$}}
+; SENSITIVE: main:%l0 -> @g{{$}}
+; SENSITIVE: main:%l1 -> @h{{$}}
+; SENSITIVE: main:%n -> main:%s{{$}}
+; SENSITIVE: main:%nf1 -> main:%s+1{{$}}
+; SENSITIVE: main:%ln1 -> @h{{$}}
+
+; MAX2: main:%s -> main:%s{{$}}
+; MAX2: main:%f0 -> main:%s{{$}}
+; MAX2: main:%f1 -> main:%s+1{{$}}
+; MAX2: main:%f2 -> main:%s+1{{$}}
+; MAX2: main:%l0 -> @g{{$}}
+; MAX2: main:%l1 -> @h main:%s{{$}}
+; MAX2: main:%n -> @h main:%s{{$}}
+; MAX2: main:%nf1 -> @h main:%s+1{{$}}
+; MAX2: main:%ln1 -> @h main:%s{{$}}
@@ -0,0 +1,9 @@
+; HVN and HU must keep every pts-to set sound: the solution with them may only point to more than the one without them. Their cycle detection walks a graph it inserts into, and this module is large enough to rehash it
+; RUN: python3 %S/../../src/tools/anders-bench/gen-module.py random 30 200 1 > %t.ll
+; RUN: anders-pts %t.ll > %t.ref
+; RUN: anders-pts -enable-hvn %t.ll > %t.opt
+; RUN: python3 %S/../../src/tools/anders-bench/compare-pts.py %t.ref %t.opt -superset
+; RUN: anders-pts -enable-hu %t.ll > %t.opt
+; RUN: python3 %S/../../src/tools/anders-bench/compare-pts.py %t.ref %t.opt -superset
+; RUN: anders-pts -enable-hvn -enable-hu %t.ll > %t.opt
+; RUN: python3 %S/../../src/tools/anders-bench/compare-pts.py %t.ref %t.opt -superset
@@ -0,0 +1,59 @@
+; An incremental solve starts from the cached solution and only propagates what the new constraints add: it must reach the solution of a solve from scratch. The ";NEW " lines are the constraints added to the cached version of the module
+; RUN: rm -f %t.cache
+; RUN: anders-pts -anders-cache -anders-incremental -anders-cache-file=%t.cache %s > %t.old
+; RUN: sed 's/^;NEW //' %s > %t.new.ll
+; RUN: anders-pts %t.new.ll > %t.scratch
+; RUN: cp %t.cache %t.cache.old
+; RUN: anders-pts -anders-cache -anders-incremental -anders-cache-file=%t.cache %t.new.ll > %t.inc 2> %t.err
+; RUN: cmp %t.scratch %t.inc
+; RUN: FileCheck %s --check-prefix=DELTA < %t.err
+; RUN: FileCheck %s < %t.inc
+; RUN: cp %t.cache.old %t.cache
+; RUN: anders-pts -anders-cache -anders-incremental -anders-cache-file=%t.cache -anders-solver=wave %t.new.ll > %t.inc
+; RUN: cmp %t.scratch %t.inc
+; RUN: cp %t.cache.old %t.cache
+; RUN: anders-pts -anders-cache -anders-incremental -anders-cache-file=%t.cache -anders-threads=3 -enable-lcd %t.new.ll > %t.inc
+; RUN: cmp %t.scratch %t.inc
+; RUN: cp %t.cache.old %t.cache
+; RUN: anders-pts -anders-cache -anders-incremental -anders-cache-file=%t.cache -enable-hcd %t.new.ll > %t.inc
+; RUN: cmp %t.scratch %t.inc
+
+%struct.S = type { i32*, i32* }
+
+@g = global i32 0
+@h = global i32 0
+@k = global i32 0
+@s = global %struct.S zeroinitializer
+
+define void @chain(i32** %src, i32** %dst) {
+entry:
+  %v = load i32*, i32** %src
+  store i32* %v, i32** %dst
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %a = alloca i32*
+  %b = alloca i32*
+  %c = alloca i32*
+  %pa = alloca i32**
+  store i32* @g, i32** %a
+  store i32** %a, i32*** %pa
+  call void @chain(i32** %a, i32** %b)
+  %lb = load i32*, i32** %b
+  call void @chain(i32** %b, i32** %c)
+  %lc = load i32*, i32** %c
+  %f1 = getelementptr %struct.S, %struct.S* @s, i32 0, i32 1
+  store i32* @k, i32** %f1
+;NEW   %q = load i32**, i32*** %pa
+;NEW   store i32* @h, i32** %q
+;NEW   %f0 = getelementptr %struct.S, %struct.S* @s, i32 0, i32 0
+;NEW   store i32* %lc, i32** %f0
+  ret i32 0
+}
+
+; DELTA: Re-solving from the Andersen cache {{.*}} new constraints)
+; DELTA-NOT: solving again
+; CHECK: main:%lb -> @g @h{{$}}
+; CHECK: main:%lc -> @g @h{{$}}
@@ -0,0 +1,38 @@
+; By default, an indirect call may go to every address-taken function that takes as many arguments, and returns anything. With -anders-otf-calls, the solver only wires the functions the called pointer points to
+; RUN: anders-pts %s | FileCheck %s --check-prefix=STATIC
+; RUN: anders-pts -anders-otf-calls %s | FileCheck %s --check-prefix=OTF
+; RUN: anders-pts -anders-otf-calls -anders-threads=3 %s | FileCheck %s --check-prefix=OTF
+; RUN: anders-pts -anders-otf-calls -anders-solver=wave %s | FileCheck %s --check-prefix=OTF
+
+@g = global i32 0
+@h = global i32 0
+@table = global [2 x i32* (i32*)*] [i32* (i32*)* @first, i32* (i32*)* @second]
+
+define i32* @first(i32* %x) {
+entry:
+  ret i32* %x
+}
+
+define i32* @second(i32* %y) {
+entry:
+  ret i32* @h
+}
+
+define i32 @main() {
+entry:
+  %fp = alloca i32* (i32*)*
+  store i32* (i32*)* @first, i32* (i32*)** %fp
+  %f = load i32* (i32*)*, i32* (i32*)** %fp
+  %r = call i32* %f(i32* @g)
+  ret i32 0
+}
+
+; STATIC: first:%x -> @g{{$}}
+; STATIC: second:%y -> @g{{$}}
+; STATIC: main:%f -> @first{{$}}
+; STATIC: main:%r ->{{$}}
+
+; OTF: first:%x -> @g{{$}}
+; OTF: second:%y ->{{$}}
+; OTF: main:%f -> @first{{$}}
+; OTF: main:%r -> @g{{$}}
@@ -0,0 +1,10 @@
+; The parallel solver must reach the same solution as the sequential one, with and without the online cycle detections. The module is large enough for the rounds to run on several threads
+; RUN: python3 %S/../../src/tools/anders-bench/gen-module.py random 60 80 7 > %t.ll
+; RUN: anders-pts %t.ll > %t.seq
+; RUN: anders-pts -anders-threads=4 %t.ll > %t.par
+; RUN: cmp %t.seq %t.par
+; RUN: anders-pts -anders-threads=3 -enable-lcd %t.ll > %t.par
+; RUN: cmp %t.seq %t.par
+; RUN: anders-pts -enable-hcd %t.ll > %t.seq
+; RUN: anders-pts -anders-threads=4 -enable-hcd -enable-lcd %t.ll > %t.par
+; RUN: cmp %t.seq %t.par
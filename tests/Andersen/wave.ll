@@ -0,0 +1,9 @@
+; The wave solver must reach the solution of the worklist solver, on a generated module and on random constraint dumps, whose solution is also computed naively (see compare-solvers.sh)
+; RUN: python3 %S/../../src/tools/anders-bench/gen-module.py random 60 80 7 > %t.ll
+; RUN: anders-pts %t.ll > %t.worklist
+; RUN: anders-pts -anders-solver=wave %t.ll > %t.wave
+; RUN: cmp %t.worklist %t.wave
+; RUN: anders-pts -anders-otf-calls -enable-hcd -enable-lcd %t.ll > %t.worklist
+; RUN: anders-pts -anders-otf-calls -enable-hcd -enable-lcd -anders-solver=wave %t.ll > %t.wave
+; RUN: cmp %t.worklist %t.wave
+; RUN: ANDERS_BENCH=anders-bench sh %S/../../src/tools/anders-bench/compare-solvers.sh -random 20
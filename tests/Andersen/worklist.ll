@@ -0,0 +1,14 @@
+; Every worklist order must reach the same solution, with and without the online cycle detections that make the topological order stale
+; RUN: python3 %S/../../src/tools/anders-bench/gen-module.py random 40 80 3 > %t.ll
+; RUN: anders-pts %t.ll > %t.fifo
+; RUN: anders-pts -anders-worklist=lrf %t.ll > %t.other
+; RUN: cmp %t.fifo %t.other
+; RUN: anders-pts -anders-worklist=topo %t.ll > %t.other
+; RUN: cmp %t.fifo %t.other
+; RUN: anders-pts -anders-worklist=topo -enable-lcd %t.ll > %t.other
+; RUN: cmp %t.fifo %t.other
+; RUN: anders-pts -enable-hcd %t.ll > %t.fifo
+; RUN: anders-pts -anders-worklist=topo -enable-hcd -enable-lcd %t.ll > %t.other
+; RUN: cmp %t.fifo %t.other
+; RUN: anders-pts -anders-worklist=lrf -enable-hcd -enable-lcd %t.ll > %t.other
+; RUN: cmp %t.fifo %t.other